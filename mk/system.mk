@@ -58,7 +58,7 @@ DEV_OBJS := $(filter-out $(DEV_OUT)/rtc.o, $(DEV_OBJS))
 endif
 deps := $(DEV_OBJS:%.o=%.o.d)
 
-OBJS_EXT += system.o
+OBJS_EXT += system.o snapshot.o
 OBJS_EXT += dtc/libfdt/fdt.o dtc/libfdt/fdt_ro.o dtc/libfdt/fdt_rw.o dtc/libfdt/fdt_wip.o
 
 # Memory Layout Configuration
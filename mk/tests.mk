@@ -17,6 +17,9 @@ $(eval $(call test-framework,map,test-map.o mt19937.o,$(OUT)/map.o,))
 # Path test: tests path utility functions
 $(eval $(call test-framework,path,test-path.o,$(OUT)/utils.o,))
 
+# Memory test: snapshots guest RAM and restores it, per backing
+$(eval $(call test-framework,memory,test-memory.o,$(OUT)/io.o $(OUT)/log.o,))
+
 # Test Runners
 
 # Cache test uses file comparison (input -> output -> compare with expected)
@@ -25,10 +28,11 @@ $(eval $(call run-test-compare,cache,cache-new cache-put cache-get cache-replace
 # Map and path tests use simple exit code checking
 $(eval $(call run-test-simple,map))
 $(eval $(call run-test-simple,path))
+$(eval $(call run-test-simple,memory))
 
 # Main Test Target
 
-tests: run-test-cache run-test-map run-test-path
+tests: run-test-cache run-test-map run-test-path run-test-memory
 
 # Integration Tests (run emulator with test programs)
 
@@ -86,8 +90,37 @@ EXPECTED_mmu = Store page fault test passed!
 mmu-test: $(BIN)
 	$(call check-test, , tests/system/mmu/vm.elf, vm.elf, tail -n 1,$(EXPECTED_mmu))
 
+EXPECTED_copy_prop = Copy propagation test passed!
+copy-prop-test: $(BIN)
+	$(call check-test, , tests/copy-prop/copy-prop.elf, copy-prop.elf, tail -n 1,$(EXPECTED_copy_prop))
+
+# The replayed run reads neither stdin nor the host clock, so it has to print
+# what the recorded run echoed from stdin and read from the clock.
+EXPECTED_replay = rv32emu replay
+replay-test: $(BIN)
+	$(Q)true; \
+	$(PRINTF) "Running replay.elf ... "; \
+	TEST_DIR="$$(mktemp -d)"; \
+	trap '$(RM) -r "$$TEST_DIR"' 0; \
+	if (echo "$(EXPECTED_replay)" | $(BIN) -R "$$TEST_DIR/log" \
+	        tests/replay/replay.elf > "$$TEST_DIR/record") && \
+	   ($(BIN) -P "$$TEST_DIR/log" tests/replay/replay.elf \
+	        < /dev/null > "$$TEST_DIR/replay") && \
+	   [ "$$($(LOG_FILTER) "$$TEST_DIR/replay" | head -n 1)" = "$(EXPECTED_replay)" ] && \
+	   cmp -s "$$TEST_DIR/record" "$$TEST_DIR/replay"; then \
+	    $(call notice, [OK]); \
+	else \
+	    $(PRINTF) "Failed.\n"; \
+	    exit 1; \
+	fi
+
+# Tiered T2C compilation must not be slower than the quick pipeline alone
+t2c-tier-test: $(BIN)
+	$(Q)tests/t2c-tier.sh
+
 .PHONY: tests run-test-cache run-test-map run-test-path
 .PHONY: check $(CHECK_TARGETS) misalign misalign-in-blk-emu mmu-test
+.PHONY: copy-prop-test replay-test t2c-tier-test
 
 endif # _MK_TESTS_INCLUDED
 
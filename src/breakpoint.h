@@ -15,6 +15,21 @@ typedef struct {
 
 typedef map_t breakpoint_map_t;
 
+/* Like the triggers of a hardware debug module, each watchpoint covers one
+ * aligned word, and a handful of them are available.
+ */
+#define N_WATCHPOINTS 4
+
+enum {
+    WATCH_READ = 1 << 0,
+    WATCH_WRITE = 1 << 1,
+};
+
+typedef struct {
+    riscv_word_t addr; /* aligned to the word */
+    uint8_t access;    /* WATCH_READ and/or WATCH_WRITE */
+} watchpoint_t;
+
 breakpoint_map_t breakpoint_map_new();
 bool breakpoint_map_insert(breakpoint_map_t map, riscv_word_t addr);
 breakpoint_t *breakpoint_map_find(breakpoint_map_t map, riscv_word_t addr);
@@ -260,6 +260,8 @@ static inline uint8_t ilog2(uint32_t x)
 #define ATOMIC_STORE(ptr, val, order) __atomic_store_n(ptr, val, order)
 #define ATOMIC_FETCH_ADD(ptr, val, order) __atomic_fetch_add(ptr, val, order)
 #define ATOMIC_FETCH_SUB(ptr, val, order) __atomic_fetch_sub(ptr, val, order)
+#define ATOMIC_FETCH_OR(ptr, val, order) __atomic_fetch_or(ptr, val, order)
+#define ATOMIC_FETCH_AND(ptr, val, order) __atomic_fetch_and(ptr, val, order)
 #define ATOMIC_EXCHANGE(ptr, val, order) __atomic_exchange_n(ptr, val, order)
 #define ATOMIC_COMPARE_EXCHANGE_WEAK(ptr, expected, desired, succ, fail) \
     __atomic_compare_exchange_n(ptr, expected, desired, 1, succ, fail)
@@ -286,6 +288,10 @@ static inline uint8_t ilog2(uint32_t x)
     atomic_fetch_add_explicit((_Atomic __typeof__(*(ptr)) *) (ptr), val, order)
 #define ATOMIC_FETCH_SUB(ptr, val, order) \
     atomic_fetch_sub_explicit((_Atomic __typeof__(*(ptr)) *) (ptr), val, order)
+#define ATOMIC_FETCH_OR(ptr, val, order) \
+    atomic_fetch_or_explicit((_Atomic __typeof__(*(ptr)) *) (ptr), val, order)
+#define ATOMIC_FETCH_AND(ptr, val, order) \
+    atomic_fetch_and_explicit((_Atomic __typeof__(*(ptr)) *) (ptr), val, order)
 #define ATOMIC_EXCHANGE(ptr, val, order) \
     atomic_exchange_explicit((_Atomic __typeof__(*(ptr)) *) (ptr), val, order)
 #define ATOMIC_COMPARE_EXCHANGE_WEAK(ptr, expected, desired, succ, fail) \
@@ -318,6 +324,9 @@ static inline uint8_t ilog2(uint32_t x)
     ((*(ptr) += (val)) - (val)) /* return old value */
 #define ATOMIC_FETCH_SUB(ptr, val, order) \
     ((*(ptr) -= (val)) + (val)) /* return old value */
+/* ATOMIC_FETCH_OR/AND return the new value, like ATOMIC_EXCHANGE below */
+#define ATOMIC_FETCH_OR(ptr, val, order) (*(ptr) |= (val))
+#define ATOMIC_FETCH_AND(ptr, val, order) (*(ptr) &= (val))
 /* ATOMIC_EXCHANGE cannot return old value without statement expressions.
  * This returns NEW value - callers must not rely on return value. */
 #define ATOMIC_EXCHANGE(ptr, val, order) (*(ptr) = (val))
@@ -5,6 +5,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "decode.h"
 #include "riscv_private.h"
@@ -1973,11 +1974,10 @@ static inline bool op_unimp(rv_insn_t *ir UNUSED, uint32_t insn UNUSED)
 /* RV32 decode handler type */
 typedef bool (*decode_t)(rv_insn_t *ir, uint32_t insn);
 
-/* decode RISC-V instruction */
-bool rv_decode(rv_insn_t *ir, uint32_t insn)
+/* walk the opcode maps for an instruction that missed the decode cache */
+static bool rv_decode_insn(rv_insn_t *ir, uint32_t insn)
 {
     bool ret;
-    assert(ir);
     decode_t op;
 
 #define OP_UNIMP op_unimp
@@ -2050,3 +2050,51 @@ end:
 #undef OP_UNIMP
 #undef OP
 }
+
+/* Decoding is a pure function of the instruction word, so the results are
+ * memoized in a direct-mapped cache keyed by the word itself. The cache never
+ * needs invalidation: re-translating code after block_map_clear(), a code
+ * cache flush or SFENCE.VMA hits here instead of walking the opcode maps
+ * again. Only the fields written by the decoder, which precede imm2 in
+ * rv_insn_t, are cached.
+ */
+#define DECODE_CACHE_BITS 12
+#define DECODE_CACHE_SIZE (1 << DECODE_CACHE_BITS)
+#define DECODE_FIELDS_SIZE offsetof(rv_insn_t, imm2)
+
+typedef struct {
+    uint32_t insn; /**< instruction word, 0 (never legal) marks a free slot */
+    uint8_t fields[DECODE_FIELDS_SIZE]; /**< decoded prefix of rv_insn_t */
+} decode_cache_entry_t;
+
+static decode_cache_entry_t decode_cache[DECODE_CACHE_SIZE];
+
+/* decode RISC-V instruction */
+bool rv_decode(rv_insn_t *ir, uint32_t insn)
+{
+    assert(ir);
+
+#if RV32_HAS(EXT_C)
+    /* the upper half of a compressed instruction is not part of it */
+    if (is_compressed(insn))
+        insn &= 0x0000FFFF;
+#endif
+
+    decode_cache_entry_t *entry =
+        &decode_cache[(insn * 0x9E3779B1U) >> (32 - DECODE_CACHE_BITS)];
+    if (likely(entry->insn == insn && insn)) {
+        memcpy(ir, entry->fields, DECODE_FIELDS_SIZE);
+        return true;
+    }
+
+    /* start from clean fields so that cached results do not depend on
+     * whatever the IR held before
+     */
+    memset(ir, 0, DECODE_FIELDS_SIZE);
+    if (!rv_decode_insn(ir, insn))
+        return false;
+
+    entry->insn = insn;
+    memcpy(entry->fields, ir, DECODE_FIELDS_SIZE);
+    return true;
+}
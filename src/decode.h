@@ -76,6 +76,10 @@ enum op_field {
     _(fence, 1, 4, 0, ENC(rs1, rd))                    \
     _(ecall, 1, 4, 1, ENC(rs1, rd))                    \
     _(ebreak, 1, 4, 1, ENC(rs1, rd))                   \
+    /* Guest libc routine run on the host */           \
+    IIF(RV32_HAS(SYSTEM))(,                            \
+        _(libcall, 1, 4, 0, ENC(rs1, rd))              \
+    )                                                  \
     /* RISC-V Privileged Instruction */                \
     _(wfi, 0, 4, 0, ENC(rs1, rd))                      \
     _(uret, 0, 4, 0, ENC(rs1, rd))                     \
@@ -252,7 +256,8 @@ enum op_field {
     _(fuse9)           \
     _(fuse10)          \
     _(fuse11)          \
-    _(fuse12)
+    _(fuse12)          \
+    _(fuse13)
 
 /* Fusion pattern descriptions:
  * fuse1:  Multiple LUI              - Batch upper immediate loads
@@ -267,6 +272,7 @@ enum op_field {
  * fuse10: LUI + SW                  - Absolute/PC-relative store
  * fuse11: LW + ADDI (post-inc)      - Load with pointer increment
  * fuse12: ADDI + BNE                - Loop counter decrement-branch
+ * fuse13: SLLI + ADD                - Scaled index address computation
  */
 
 /* clang-format off */
@@ -426,12 +432,33 @@ typedef struct rv_insn {
     uint8_t rm;
 #endif
 
+    /* Guest instructions retired from the entry of the enclosing block up to
+     * and including this IR. It fits the padding before imm2, which is why
+     * block_translate() caps a block at UINT16_MAX instructions.
+     */
+    uint16_t insn_ofs;
+
     /* fuse operation */
     int32_t imm2;
-    opcode_fuse_t *fuse;
-
     uint32_t pc;
 
+    /* Cycles charged by the timing model from the entry of the enclosing block
+     * up to and including this IR. Within a block the interpreter carries the
+     * counts of the block entry, and adds this offset and insn_ofs only where
+     * the counts are observed or the block is left.
+     */
+    uint32_t cycle_ofs;
+
+    /* Cold per-instruction payloads. A fused instruction never terminates a
+     * block with an indirect jump, and an indirect jump is never fused, so the
+     * fuse array and the branch history table share one slot. Use
+     * insn_is_indirect_branch() to tell which one is live.
+     */
+    union {
+        opcode_fuse_t *fuse;
+        branch_history_table_t *branch_table;
+    };
+
     /* Tail-call optimization (TCO) allows a C function to replace a function
      * call to another function or itself, followed by a simple return of the
      * function's result, with a direct jump to the target function. This
@@ -443,13 +470,23 @@ typedef struct rv_insn {
      * invocation of the next instruction emulation without the need to compute
      * the jump address. By utilizing these two members, all instruction
      * emulations can be rewritten into a self-recursive version, enabling the
-     * compiler to leverage TCO.
+     * compiler to leverage TCO. Since the IRs of a block are contiguous, a
+     * non-NULL @next is always the adjacent entry, and the interpreter
+     * dispatches to ir + 1 without loading it.
+     *
+     * With the computed-goto engine, @impl is instead the address of the
+     * handler label inside the threaded dispatch function.
      */
     struct rv_insn *next;
+#if RV32_HAS(COMPUTED_GOTO)
+    const void *impl;
+#else
     PRESERVE_NONE bool (*impl)(riscv_t *,
                                const struct rv_insn *,
                                uint64_t,
+                               uint64_t,
                                uint32_t);
+#endif
 
     /* Two pointers, 'branch_taken' and 'branch_untaken', are employed to
      * avoid the overhead associated with aggressive memory copying. Instead
@@ -459,8 +496,110 @@ typedef struct rv_insn {
      * need for additional copying.
      */
     struct rv_insn *branch_taken, *branch_untaken;
-    branch_history_table_t *branch_table;
 } rv_insn_t;
 
+/* The IRs of a block are stored in one contiguous, cache-line aligned array,
+ * so the interpreter walks them sequentially. Keep the hot part of each entry
+ * within a single cache line.
+ */
+_Static_assert(sizeof(rv_insn_t) <= 64, "rv_insn_t must fit in a cache line");
+
+static inline bool insn_is_indirect_branch(uint8_t opcode)
+{
+    switch (opcode) {
+    case rv_insn_jalr:
+#if RV32_HAS(EXT_C)
+    case rv_insn_cjalr:
+    case rv_insn_cjr:
+#endif
+        return true;
+    default:
+        return false;
+    }
+}
+
+enum {
+    INSN_ACCESS_LOAD = 1,
+    INSN_ACCESS_STORE = 2,
+};
+
+/* classify the memory accesses performed by a decoded instruction */
+static inline int insn_mem_access(uint8_t opcode)
+{
+    switch (opcode) {
+    case rv_insn_lb:
+    case rv_insn_lh:
+    case rv_insn_lw:
+    case rv_insn_lbu:
+    case rv_insn_lhu:
+#if RV32_HAS(EXT_A)
+    case rv_insn_lrw:
+#endif
+#if RV32_HAS(EXT_F)
+    case rv_insn_flw:
+#endif
+#if RV32_HAS(EXT_C)
+    case rv_insn_clw:
+    case rv_insn_clwsp:
+#endif
+#if RV32_HAS(EXT_C) && RV32_HAS(EXT_F)
+    case rv_insn_cflw:
+    case rv_insn_cflwsp:
+#endif
+        return INSN_ACCESS_LOAD;
+    case rv_insn_sb:
+    case rv_insn_sh:
+    case rv_insn_sw:
+#if RV32_HAS(EXT_A)
+    case rv_insn_scw:
+#endif
+#if RV32_HAS(EXT_F)
+    case rv_insn_fsw:
+#endif
+#if RV32_HAS(EXT_C)
+    case rv_insn_csw:
+    case rv_insn_cswsp:
+#endif
+#if RV32_HAS(EXT_C) && RV32_HAS(EXT_F)
+    case rv_insn_cfsw:
+    case rv_insn_cfswsp:
+#endif
+        return INSN_ACCESS_STORE;
+#if RV32_HAS(EXT_A)
+    case rv_insn_amoswapw:
+    case rv_insn_amoaddw:
+    case rv_insn_amoxorw:
+    case rv_insn_amoandw:
+    case rv_insn_amoorw:
+    case rv_insn_amominw:
+    case rv_insn_amomaxw:
+    case rv_insn_amominuw:
+    case rv_insn_amomaxuw:
+        return INSN_ACCESS_LOAD | INSN_ACCESS_STORE;
+#endif
+    default:
+        return 0;
+    }
+}
+
+static inline bool insn_is_cond_branch(uint8_t opcode)
+{
+    switch (opcode) {
+    case rv_insn_beq:
+    case rv_insn_bne:
+    case rv_insn_blt:
+    case rv_insn_bge:
+    case rv_insn_bltu:
+    case rv_insn_bgeu:
+#if RV32_HAS(EXT_C)
+    case rv_insn_cbeqz:
+    case rv_insn_cbnez:
+#endif
+        return true;
+    default:
+        return false;
+    }
+}
+
 /* decode the RISC-V instruction */
 bool rv_decode(rv_insn_t *ir, const uint32_t insn);
@@ -25,7 +25,9 @@ static uint64_t now_nsec;
 uint64_t rtc_get_now_nsec(rtc_t *rtc)
 {
     struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
+    if (!replay_playing(rtc->replay))
+        clock_gettime(CLOCK_REALTIME, &ts);
+    replay_input(rtc->replay, REPLAY_rtc, &ts, sizeof(ts));
     return (uint64_t) (ts.tv_sec * 1e9) + ts.tv_nsec + rtc->clock_offset;
 }
 
@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include "replay.h"
+
 /* Check: https://github.com/torvalds/linux/blob/v6.1/drivers/rtc/rtc-goldfish.c
  */
 
@@ -37,6 +39,8 @@ typedef struct {
     /* Ensure the clock always progresses so RTC_SET_TIME ioctl can set any
      * arbitrary time */
     uint64_t clock_offset;
+
+    replay_t *replay; /* host clock log, or NULL */
 } rtc_t;
 
 #define IRQ_RTC_SHIFT 2
@@ -64,15 +64,18 @@ void u8250_check_ready(u8250_state_t *uart)
     if (uart->in_ready)
         return;
 
+    bool ready = false;
+    /* a replayed run takes the recorded outcome instead of polling */
+    if (!replay_playing(uart->replay)) {
 #if defined(__EMSCRIPTEN__)
-    if (input_buf_size)
-        uart->in_ready = true;
+        ready = input_buf_size;
 #else
-    struct pollfd pfd = {uart->in_fd, POLLIN, 0};
-    poll(&pfd, 1, 0);
-    if (pfd.revents & POLLIN)
-        uart->in_ready = true;
+        struct pollfd pfd = {uart->in_fd, POLLIN, 0};
+        poll(&pfd, 1, 0);
+        ready = pfd.revents & POLLIN;
 #endif
+    }
+    uart->in_ready = replay_poll(uart->replay, REPLAY_uart_poll, ready);
 }
 
 static void u8250_handle_out(u8250_state_t *uart, uint8_t value)
@@ -88,20 +91,24 @@ static uint8_t u8250_handle_in(u8250_state_t *uart)
     if (!uart->in_ready)
         return value;
 
+    const bool playing = replay_playing(uart->replay);
+    if (!playing) {
 #if defined(__EMSCRIPTEN__)
-    value = (uint8_t) input_buf[input_buf_start];
-    input_buf_start++;
-    if (--input_buf_size == 0)
-        input_buf_start = 0;
+        value = (uint8_t) input_buf[input_buf_start];
+        input_buf_start++;
+        if (--input_buf_size == 0)
+            input_buf_start = 0;
 #else
-    if (read(uart->in_fd, &value, 1) < 0)
-        rv_log_error("Failed to read UART input: %s", strerror(errno));
+        if (read(uart->in_fd, &value, 1) < 0)
+            rv_log_error("Failed to read UART input: %s", strerror(errno));
 #endif
+    }
+    replay_input(uart->replay, REPLAY_uart_in, &value, sizeof(value));
     uart->in_ready = false;
 
     if (value == 1) { /* start of heading (Ctrl-a) */
         u8250_check_ready(uart);
-        if (getchar() == 120) { /* keyboard x */
+        if (!playing && getchar() == 120) { /* keyboard x */
             rv_log_info("RISC-V emulator is destroyed");
             exit(EXIT_SUCCESS);
         }
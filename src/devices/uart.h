@@ -8,6 +8,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "replay.h"
+
 #define IRQ_UART_SHIFT 1
 #define IRQ_UART_BIT (1 << IRQ_UART_SHIFT)
 
@@ -30,6 +32,7 @@ typedef struct {
     uint8_t mcr;       /* other output signals, loopback mode (ignored) */
     int in_fd, out_fd; /* I/O handling */
     bool in_ready;
+    replay_t *replay; /* input log, or NULL */
 } u8250_state_t;
 
 /* update UART status */
@@ -230,6 +230,26 @@ const char *elf_find_symbol(elf_t *e, uint32_t addr)
     return map_at_end(e->symbols, &it) ? NULL : map_iter_value(&it, char *);
 }
 
+void elf_get_functions(elf_t *e, map_t funcs)
+{
+    /* get the symbol table */
+    const struct Elf32_Shdr *shdr = get_section_header(e, ".symtab");
+    if (!shdr)
+        return;
+
+    /* find symbol table range */
+    const struct Elf32_Sym *sym =
+        (const struct Elf32_Sym *) (e->raw_data + shdr->sh_offset);
+    const struct Elf32_Sym *end =
+        (const struct Elf32_Sym *) (e->raw_data + shdr->sh_offset +
+                                    shdr->sh_size);
+
+    for (; sym < end; ++sym) {
+        if (ELF_ST_TYPE(sym->st_info) == STT_FUNC && sym->st_size)
+            map_insert(funcs, &sym->st_value, &sym->st_size);
+    }
+}
+
 bool elf_get_data_section_range(elf_t *e, uint32_t *start, uint32_t *end)
 {
     const struct Elf32_Shdr *shdr = get_section_header(e, ".data");
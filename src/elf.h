@@ -137,6 +137,11 @@ const struct Elf32_Sym *elf_get_symbol(elf_t *e, const char *name);
 /* Find symbol from a specified ELF file */
 const char *elf_find_symbol(elf_t *e, uint32_t addr);
 
+/* Collect the entry address and size of each sized function symbol, keyed by
+ * the entry address, into the map @funcs
+ */
+void elf_get_functions(elf_t *e, map_t funcs);
+
 /* get the range of .data section from the ELF file */
 bool elf_get_data_section_range(elf_t *e, uint32_t *start, uint32_t *end);
 
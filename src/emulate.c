@@ -234,32 +234,99 @@ static inline void check_tohost_write(riscv_t *rv,
             if (unlikely(insn_is_misaligned(PC))))                           \
     {                                                                        \
         rv->compressed = compress;                                           \
-        rv->csr_cycle = cycle;                                               \
+        RVOP_SYNC_COUNTERS(rv);                                              \
         rv->PC = PC;                                                         \
         SET_CAUSE_AND_TVAL_THEN_TRAP(rv, type##_MISALIGNED,                  \
                                      IIF(IO)(addr, mask_or_pc));             \
         return false;                                                        \
     }
 
+#if RV32_HAS(SYSTEM)
+/* Timer ticks after @cycle cycles. The timer runs at the timebase of the
+ * device tree, which is one tick per cycle unless a core clock is given.
+ */
+static inline uint64_t cycle_to_timer(const riscv_t *rv, uint64_t cycle)
+{
+    const uint32_t mhz = PRIV(rv)->clock_mhz;
+    if (!mhz || mhz == TIMEBASE_MHZ)
+        return cycle;
+    return cycle / mhz * TIMEBASE_MHZ + cycle % mhz * TIMEBASE_MHZ / mhz;
+}
+
+/* first cycle at which the timer has advanced by @ticks */
+static inline uint64_t timer_to_cycle(const riscv_t *rv, uint64_t ticks)
+{
+    const uint32_t mhz = PRIV(rv)->clock_mhz;
+    if (!mhz || mhz == TIMEBASE_MHZ)
+        return ticks;
+    const uint64_t q = ticks / TIMEBASE_MHZ, r = ticks % TIMEBASE_MHZ;
+    if (q > (UINT64_MAX - mhz) / mhz)
+        return UINT64_MAX;
+    return q * mhz + (r * mhz + TIMEBASE_MHZ - 1) / TIMEBASE_MHZ;
+}
+#endif
+
 /* FIXME: use more precise methods for updating time, e.g., RTC */
 #if RV32_HAS(Zicsr)
 static inline void update_time(riscv_t *rv)
 {
 #if !RV32_HAS(SYSTEM)
-    struct timeval tv;
+    /* the time of a core clock is in microseconds, as the host time is */
+    if (PRIV(rv)->clock_mhz) {
+        rv->timer = rv->csr_cycle / PRIV(rv)->clock_mhz;
+    } else {
+        struct timeval tv;
 
-    rv_gettimeofday(&tv);
-    rv->timer = (uint64_t) tv.tv_sec * 1e6 + (uint32_t) tv.tv_usec;
+        /* a replayed run sees the recorded clock */
+        if (!replay_playing(rv->replay))
+            rv_gettimeofday(&tv);
+        replay_input(rv->replay, REPLAY_time, &tv, sizeof(tv));
+        rv->timer = (uint64_t) tv.tv_sec * 1e6 + (uint32_t) tv.tv_usec;
+    }
 #else
     /* SYSTEM mode: derive timer from cycle counter.
      * Timer is computed on-demand rather than incremented per-instruction.
      */
-    rv->timer = rv->csr_cycle + rv->timer_offset;
+    rv->timer = cycle_to_timer(rv, rv->csr_cycle) + rv->timer_offset;
 #endif
     rv->csr_time[0] = rv->timer & 0xFFFFFFFF;
     rv->csr_time[1] = rv->timer >> 32;
 }
 
+/* get a pointer to a Zihpm CSR, bringing the counters up to date first */
+static uint32_t *csr_get_pmu_ptr(riscv_t *rv, uint32_t csr)
+{
+    if (csr == CSR_MCOUNTINHIBIT)
+        return &rv->csr_mcountinhibit;
+    if (csr >= CSR_MHPMEVENT3 && csr <= CSR_MHPMEVENT31)
+        return &rv->csr_mhpmevent[csr - CSR_MHPMEVENT3 + PMU_HPM_FIRST];
+
+    /* mhpmcounter and hpmcounter share the layout of their low and high
+     * halves, so only the counter index and bit 7 matter
+     */
+    const uint32_t idx = csr & 0x1F;
+    if ((csr & ~0x9F) != (CSR_MHPMCOUNTER3 & ~0x1F) &&
+        (csr & ~0x9F) != (CSR_HPMCOUNTER3 & ~0x1F))
+        return NULL;
+    if (idx < PMU_HPM_FIRST)
+        return NULL;
+
+    rv_pmu_sync(rv);
+    uint32_t *counter = (uint32_t *) &rv->csr_mhpmcounter[idx];
+    return (csr & 0x80) ? &counter[1] : counter;
+}
+
+static inline bool csr_is_pmu(uint32_t csr)
+{
+    csr &= 0xFFF;
+    return csr == CSR_MCOUNTINHIBIT ||
+           (csr >= CSR_MHPMEVENT3 && csr <= CSR_MHPMEVENT31) ||
+           (csr >= CSR_MHPMCOUNTER3 && csr <= CSR_MHPMCOUNTER31) ||
+           (csr >= CSR_MHPMCOUNTER3H && csr <= CSR_MHPMCOUNTER31H) ||
+           (csr >= CSR_HPMCOUNTER3 && csr <= CSR_HPMCOUNTER31) ||
+           (csr >= CSR_HPMCOUNTER3H && csr <= CSR_HPMCOUNTER31H);
+}
+
 /* get a pointer to a CSR */
 static uint32_t *csr_get_ptr(riscv_t *rv, uint32_t csr)
 {
@@ -302,9 +369,9 @@ static uint32_t *csr_get_ptr(riscv_t *rv, uint32_t csr)
         update_time(rv);
         return &rv->csr_time[1];
     case CSR_INSTRET: /* Number of Instructions Retired Counter */
-        return (uint32_t *) (&rv->csr_cycle);
+        return (uint32_t *) (&rv->csr_instret);
     case CSR_INSTRETH: /* Upper 32 bits of instructions retired */
-        return &((uint32_t *) &rv->csr_cycle)[1];
+        return &((uint32_t *) &rv->csr_instret)[1];
 #if RV32_HAS(EXT_F)
     case CSR_FFLAGS:
         return (uint32_t *) (&rv->csr_fcsr);
@@ -332,25 +399,7 @@ static uint32_t *csr_get_ptr(riscv_t *rv, uint32_t csr)
     case CSR_SATP:
         return (uint32_t *) (&rv->csr_satp);
     default:
-        return NULL;
-    }
-}
-
-/* Sync cycle counter for cycle/time CSR reads.
- * TIME CSRs need cycle synced so update_time() derives correct timer.
- */
-static inline void csr_sync_cycle(riscv_t *rv, uint32_t csr, uint64_t cycle)
-{
-    switch (csr & 0xFFF) {
-    case CSR_CYCLE:
-    case CSR_CYCLEH:
-    case CSR_INSTRET:
-    case CSR_INSTRETH:
-    case CSR_TIME:
-    case CSR_TIMEH:
-        if (rv->csr_cycle != cycle)
-            rv->csr_cycle = cycle;
-        break;
+        return csr_get_pmu_ptr(rv, csr & 0xFFF);
     }
 }
 
@@ -361,12 +410,8 @@ static inline void csr_sync_cycle(riscv_t *rv, uint32_t csr, uint64_t cycle)
  * If rd == x0, then the instruction shall not read the CSR and shall not cause
  * any of the side effects that might occur on a CSR read.
  */
-static uint32_t csr_csrrw(riscv_t *rv,
-                          uint32_t csr,
-                          uint32_t val,
-                          uint64_t cycle)
+static uint32_t csr_csrrw(riscv_t *rv, uint32_t csr, uint32_t val)
 {
-    csr_sync_cycle(rv, csr, cycle);
     uint32_t *c = csr_get_ptr(rv, csr);
     if (!c)
         return 0;
@@ -381,6 +426,8 @@ static uint32_t csr_csrrw(riscv_t *rv,
     uint32_t old_satp = *c;
 #endif
     *c = val;
+    if (csr_is_pmu(csr))
+        rv_pmu_rebase(rv);
 
 #if RV32_HAS(SYSTEM)
     /* Flush TLB when SATP actually changes: address space changed */
@@ -405,12 +452,8 @@ static uint32_t csr_csrrw(riscv_t *rv,
 }
 
 /* perform csrrs (atomic read and set) */
-static uint32_t csr_csrrs(riscv_t *rv,
-                          uint32_t csr,
-                          uint32_t val,
-                          uint64_t cycle)
+static uint32_t csr_csrrs(riscv_t *rv, uint32_t csr, uint32_t val)
 {
-    csr_sync_cycle(rv, csr, cycle);
     uint32_t *c = csr_get_ptr(rv, csr);
     if (!c)
         return 0;
@@ -425,6 +468,8 @@ static uint32_t csr_csrrs(riscv_t *rv,
     uint32_t old_satp = *c;
 #endif
     *c |= val;
+    if (csr_is_pmu(csr))
+        rv_pmu_rebase(rv);
 
 #if RV32_HAS(SYSTEM)
     /* Flush TLB when SATP actually changes */
@@ -439,12 +484,8 @@ static uint32_t csr_csrrs(riscv_t *rv,
  * Read old value of CSR, zero-extend to XLEN bits, write to rd.
  * Read value from rs1, use as bit mask to clear bits in CSR.
  */
-static uint32_t csr_csrrc(riscv_t *rv,
-                          uint32_t csr,
-                          uint32_t val,
-                          uint64_t cycle)
+static uint32_t csr_csrrc(riscv_t *rv, uint32_t csr, uint32_t val)
 {
-    csr_sync_cycle(rv, csr, cycle);
     uint32_t *c = csr_get_ptr(rv, csr);
     if (!c)
         return 0;
@@ -459,6 +500,8 @@ static uint32_t csr_csrrc(riscv_t *rv,
     uint32_t old_satp = *c;
 #endif
     *c &= ~val;
+    if (csr_is_pmu(csr))
+        rv_pmu_rebase(rv);
 
 #if RV32_HAS(SYSTEM)
     /* Flush TLB when SATP actually changes */
@@ -513,6 +556,7 @@ static block_t *block_alloc(riscv_t *rv)
 #endif
 #if RV32_HAS(JIT)
     block->translatable = true;
+    block->invalidated = false;
     block->hot = false;
     block->hot2 = false;
     block->has_loops = false;
@@ -523,7 +567,11 @@ static block_t *block_alloc(riscv_t *rv)
     block->compiled = false;
     block->is_compiling = false;
     block->should_free = false;
+    block->requeued = false;
+    block->recompiled = false;
     block->llvm_engine = NULL;
+    block->llvm_engine_quick = NULL;
+    block->t2c_profile = NULL;
 #endif
 #endif
     return block;
@@ -629,12 +677,14 @@ enum {
 #undef _
 };
 
-#if RV32_HAS(GDBSTUB)
-#define RVOP_NO_NEXT(ir) \
-    (!ir->next | rv->debug_mode IIF(RV32_HAS(SYSTEM))(| rv->is_trapped, ))
-#else
-#define RVOP_NO_NEXT(ir) (!ir->next IIF(RV32_HAS(SYSTEM))(| rv->is_trapped, ))
-#endif
+/* Stop at the end of the block, or after an instruction that trapped or hit a
+ * GDB watchpoint. Only handlers for which insn_may_trap() holds, which covers
+ * every memory access, look at rv->is_trapped and rv->debug_stop, for the
+ * rest the check folds away.
+ */
+#define RVOP_NO_NEXT(ir, may_trap)                                         \
+    (!(ir)->next IIF(RV32_HAS(SYSTEM))(| ((may_trap) && rv->is_trapped), ) \
+         IIF(RV32_HAS(GDBSTUB))(| ((may_trap) && rv->debug_stop), ))
 
 /* record whether the branch is taken or not during emulation */
 static bool is_branch_taken = false;
@@ -650,13 +700,19 @@ static bool has_loops = false;
 #if RV32_HAS(SYSTEM_MMIO)
 extern void emu_update_uart_interrupts(riscv_t *rv);
 extern void emu_update_rtc_interrupts(riscv_t *rv);
-static uint32_t peripheral_update_ctr = 64;
+
+/* Interval, in guest cycles, between two polls of the host-backed
+ * peripherals (UART input readiness and RTC alarm).
+ */
+#define PERIPHERAL_POLL_CYCLES 256
 #endif
 
 /* Interpreter-based execution path.
- * Block-level cycle counting: cycle is pre-incremented at block entry,
- * so per-instruction cycle++ is removed. Timer is derived from cycle at
- * interrupt check points (rv_check_interrupt) rather than per-instruction.
+ * Block-level cycle counting: handlers carry the cycle and retired instruction
+ * counts of the block entry and rely on the precomputed ir->cycle_ofs and
+ * ir->insn_ofs, so no per-instruction cycle++ is needed. Timer is derived from
+ * cycle at interrupt check points (rv_check_interrupt) rather than
+ * per-instruction.
  */
 #if RV32_HAS(SYSTEM)
 #define RVOP_SYNC_PC(rv, PC) \
@@ -669,6 +725,13 @@ static uint32_t peripheral_update_ctr = 64;
     } while (0)
 #endif
 
+/* publish the counts reached after the current IR */
+#define RVOP_SYNC_COUNTERS(rv)                      \
+    do {                                            \
+        (rv)->csr_cycle = cycle + ir->cycle_ofs;    \
+        (rv)->csr_instret = instret + ir->insn_ofs; \
+    } while (0)
+
 FORCE_INLINE bool insn_is_branch(uint8_t opcode)
 {
     switch (opcode) {
@@ -681,30 +744,258 @@ FORCE_INLINE bool insn_is_branch(uint8_t opcode)
     return false;
 }
 
+/* Whether the handler of an instruction can raise a trap, request that the
+ * block map be cleared, or have an interrupted access retried. These are the
+ * instructions touching memory, CSRs or the privilege state; everything else
+ * skips the need_handle_signal, need_clear_block_map and is_trapped checks.
+ */
+FORCE_INLINE bool insn_may_trap(uint8_t opcode)
+{
+    switch (opcode) {
+    case rv_insn_lb:
+    case rv_insn_lh:
+    case rv_insn_lw:
+    case rv_insn_lbu:
+    case rv_insn_lhu:
+    case rv_insn_sb:
+    case rv_insn_sh:
+    case rv_insn_sw:
+    case rv_insn_ecall:
+    case rv_insn_ebreak:
+#if RV32_HAS(SYSTEM)
+    case rv_insn_sret:
+#endif
+    case rv_insn_mret:
+    case rv_insn_sfencevma:
+#if RV32_HAS(Zifencei)
+    case rv_insn_fencei:
+#endif
+#if RV32_HAS(Zicsr)
+    case rv_insn_csrrw:
+    case rv_insn_csrrs:
+    case rv_insn_csrrc:
+    case rv_insn_csrrwi:
+    case rv_insn_csrrsi:
+    case rv_insn_csrrci:
+#endif
+#if RV32_HAS(EXT_A)
+    case rv_insn_lrw:
+    case rv_insn_scw:
+    case rv_insn_amoswapw:
+    case rv_insn_amoaddw:
+    case rv_insn_amoxorw:
+    case rv_insn_amoandw:
+    case rv_insn_amoorw:
+    case rv_insn_amominw:
+    case rv_insn_amomaxw:
+    case rv_insn_amominuw:
+    case rv_insn_amomaxuw:
+#endif
+#if RV32_HAS(EXT_F)
+    case rv_insn_flw:
+    case rv_insn_fsw:
+#endif
+#if RV32_HAS(EXT_C)
+    case rv_insn_clw:
+    case rv_insn_csw:
+    case rv_insn_clwsp:
+    case rv_insn_cswsp:
+    case rv_insn_cebreak:
+#if RV32_HAS(EXT_F)
+    case rv_insn_cflwsp:
+    case rv_insn_cfswsp:
+    case rv_insn_cflw:
+    case rv_insn_cfsw:
+#endif
+#endif
+    case rv_insn_fuse3:
+    case rv_insn_fuse4:
+    case rv_insn_fuse6:
+    case rv_insn_fuse9:
+    case rv_insn_fuse10:
+    case rv_insn_fuse11:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Execute shift operation from fused instruction data.
+ * This avoids the unsafe cast from opcode_fuse_t* to rv_insn_t*.
+ */
+static inline void fuse_shift_exec(riscv_t *rv, const opcode_fuse_t *f)
+{
+    switch (f->opcode) {
+    case rv_insn_slli:
+        rv->X[f->rd] = rv->X[f->rs1] << (f->imm & 0x1f);
+        break;
+    case rv_insn_srli:
+        rv->X[f->rd] = rv->X[f->rs1] >> (f->imm & 0x1f);
+        break;
+    case rv_insn_srai:
+        rv->X[f->rd] = ((int32_t) rv->X[f->rs1]) >> (f->imm & 0x1f);
+        break;
+    default:
+        __UNREACHABLE;
+        break;
+    }
+}
+
+#if !RV32_HAS(SYSTEM)
+/* Run the guest libc routine func (libcall_*) on the host */
+static inline void libcall_exec(riscv_t *rv, uint32_t func)
+{
+    switch (func) {
+#define _(name)               \
+    case libcall_##name:      \
+        rv->io.on_##name(rv); \
+        break;
+        LIBCALL_LIST
+#undef _
+    default:
+        __UNREACHABLE;
+        break;
+    }
+}
+#endif
+
+/* Dispatch engines
+ *
+ * Every handler below is written once and expanded into one of two engines:
+ *
+ * - Tail-call (default): each handler is a PRESERVE_NONE function and hands
+ *   over to the next IR with a tail call through ir->impl. This relies on the
+ *   compiler turning those calls into jumps; where it does not, every guest
+ *   instruction costs a real call and a growing host stack.
+ * - Computed goto (COMPUTED_GOTO): each handler is a label inside the single
+ *   function threaded_dispatch(), ir->impl holds the label address, and
+ *   RVOP_JUMP is an indirect goto. The transfer is a jump regardless of the
+ *   compiler's sibling-call optimization.
+ *
+ * Handlers transfer control only through RVOP_NEXT(), which continues with
+ * the following IR of the same block, and RVOP_JUMP(target), which leaves the
+ * block for @target. In the computed-goto engine, nextop and end_op are
+ * declared as local labels so that each handler keeps its own copies.
+ *
+ * Cycles are accounted per block: @cycle holds the count at the entry of the
+ * current block, and cycle + ir->cycle_ofs is the count after the current IR.
+ * RVOP_JUMP folds the offset into @cycle when crossing into the next block,
+ * and every place that publishes the count to rv->csr_cycle adds it as well.
+ * @instret follows ir->insn_ofs the same way for rv->csr_instret.
+ *
+ * While a PMU counter selects a per-block event, RVOP_JUMP returns to
+ * rv_step() instead, which charges the events of every block it runs.
+ */
+#define RVOP_PMU_EXIT()                   \
+    do {                                  \
+        if (unlikely(rv->pmu_detailed)) { \
+            RVOP_SYNC_COUNTERS(rv);       \
+            rv->PC = PC;                  \
+            return true;                  \
+        }                                 \
+    } while (0)
+
+#if RV32_HAS(COMPUTED_GOTO)
+#define RVOP_HANDLER(inst) do_##inst:
+#define RVOP_LOCAL_LABELS __label__ nextop, end_op;
+#define RVOP_NEXT()     \
+    do {                \
+        ir++;           \
+        goto *ir->impl; \
+    } while (0)
+#define RVOP_JUMP(target)                        \
+    do {                                         \
+        const rv_insn_t *jump_target = (target); \
+        RVOP_PMU_EXIT();                         \
+        cycle += ir->cycle_ofs;                  \
+        instret += ir->insn_ofs;                 \
+        ir = jump_target;                        \
+        goto *ir->impl;                          \
+    } while (0)
+
+/* label addresses of threaded_dispatch(), indexed by opcode */
+static const void *const *dispatch_table;
+
+#if RV32_HAS(GDBSTUB)
+/* label address of the GDB breakpoint handler, published the same way */
+static const void *const *debug_break_label;
+#define DEBUG_BREAK_IMPL (*debug_break_label)
+#endif
+
+static bool threaded_dispatch(riscv_t *rv,
+                              const rv_insn_t *ir,
+                              uint64_t cycle,
+                              uint64_t instret,
+                              uint32_t PC)
+{
+    /* clang-format off */
+    static const void *const labels[] = {
+        /* RV32 instructions */
+#define _(inst, can_branch, insn_len, translatable, reg_mask) [rv_insn_##inst] = &&do_##inst,
+        RV_INSN_LIST
+#undef _
+        /* Macro operation fusion instructions */
+#define _(inst) [rv_insn_##inst] = &&do_##inst,
+        FUSE_INSN_LIST
+#undef _
+    };
+    /* clang-format on */
+
+    /* Label addresses only exist inside this function, so a call without an
+     * IR publishes them for block translation.
+     */
+    if (unlikely(!ir)) {
+        dispatch_table = labels;
+#if RV32_HAS(GDBSTUB)
+        static const void *const debug_break = &&do_debug_break;
+        debug_break_label = &debug_break;
+#endif
+        return true;
+    }
+    goto *ir->impl;
+
+    /* The handlers below, up to the end of the fused instructions, form the
+     * body of threaded_dispatch().
+     */
+#else
+#define RVOP_HANDLER(inst)                                                \
+    static PRESERVE_NONE bool do_##inst(riscv_t *rv, const rv_insn_t *ir, \
+                                        uint64_t cycle, uint64_t instret, \
+                                        uint32_t PC)
+#define RVOP_LOCAL_LABELS
+#define RVOP_NEXT() \
+    MUST_TAIL return (ir + 1)->impl(rv, ir + 1, cycle, instret, PC)
+#define RVOP_JUMP(target)                                                    \
+    do {                                                                     \
+        RVOP_PMU_EXIT();                                                     \
+        MUST_TAIL return (target)->impl(rv, (target), cycle + ir->cycle_ofs, \
+                                        instret + ir->insn_ofs, PC);         \
+    } while (0)
+#endif
+
 #define RVOP(inst, code)                                                       \
-    static PRESERVE_NONE bool do_##inst(riscv_t *rv, const rv_insn_t *ir,      \
-                                        uint64_t cycle, uint32_t PC)           \
+    RVOP_HANDLER(inst)                                                         \
     {                                                                          \
+        RVOP_LOCAL_LABELS                                                      \
         RVOP_SYNC_PC(rv, PC);                                                  \
-        cycle++;                                                               \
         code;                                                                  \
         IIF(RV32_HAS(SYSTEM))(                                                 \
-            if (need_handle_signal) {                                          \
+            if (insn_may_trap(rv_insn_##inst) && need_handle_signal) {         \
                 need_handle_signal = false;                                    \
                 return true;                                                   \
             }, ) nextop : PC += __rv_insn_##inst##_len;                        \
         IIF(RV32_HAS(SYSTEM))(IIF(RV32_HAS(JIT))(                              \
-                                  , if (unlikely(need_clear_block_map)) {      \
+                                  , if (insn_may_trap(rv_insn_##inst) &&       \
+                                        unlikely(need_clear_block_map)) {      \
+                                      RVOP_SYNC_COUNTERS(rv);                  \
+                                      rv->PC = PC;                             \
                                       block_map_clear(rv);                     \
                                       need_clear_block_map = false;            \
-                                      rv->csr_cycle = cycle;                   \
-                                      rv->PC = PC;                             \
                                       return false;                            \
                                   }), );                                       \
-        if (unlikely(RVOP_NO_NEXT(ir)))                                        \
+        if (unlikely(RVOP_NO_NEXT(ir, insn_may_trap(rv_insn_##inst))))         \
             goto end_op;                                                       \
-        const rv_insn_t *next = ir->next;                                      \
-        MUST_TAIL return next->impl(rv, next, cycle, PC);                      \
+        RVOP_NEXT();                                                           \
     end_op:                                                                    \
         IIF(RV32_HAS(BLOCK_CHAINING))(                                         \
             {                                                                  \
@@ -717,20 +1008,19 @@ FORCE_INLINE bool insn_is_branch(uint8_t opcode)
                     struct rv_insn *taken = ir->branch_taken;                  \
                     if (taken) {                                               \
                         IIF(RV32_HAS(SYSTEM))(                                 \
-                            if (!rv->is_trapped) {                             \
+                            if (!insn_may_trap(rv_insn_##inst) ||              \
+                                !rv->is_trapped) {                             \
                                 last_pc = PC;                                  \
-                                MUST_TAIL return taken->impl(rv, taken, cycle, \
-                                                             PC);              \
+                                RVOP_JUMP(taken);                              \
                             },                                                 \
                             {                                                  \
                                 last_pc = PC;                                  \
-                                MUST_TAIL return taken->impl(rv, taken, cycle, \
-                                                             PC);              \
+                                RVOP_JUMP(taken);                              \
                             });                                                \
                     }                                                          \
                 }                                                              \
             }, );                                                              \
-        rv->csr_cycle = cycle;                                                 \
+        RVOP_SYNC_COUNTERS(rv);                                                \
         rv->PC = PC;                                                           \
         return true;                                                           \
     }
@@ -738,79 +1028,59 @@ FORCE_INLINE bool insn_is_branch(uint8_t opcode)
 #include "rv32_template.c"
 #undef RVOP
 
-/* Helper for fused instruction tail: continue to next or stop.
+/* Tail of a fused instruction: continue to the next IR or stop.
  * Matches RVOP macro signal handling and block map clearing logic.
  * Note: RVOP returns without saving cycle/PC on signal handling, so we do too.
  */
-static inline bool fuse_next_or_stop(riscv_t *rv,
-                                     const rv_insn_t *ir,
-                                     uint64_t cycle,
-                                     uint32_t PC)
-{
-#if RV32_HAS(SYSTEM)
-    if (need_handle_signal) {
-        need_handle_signal = false;
-        /* Match RVOP: return without saving cycle/PC. The signal handler
-         * will determine the appropriate PC from rv->PC (unchanged).
-         */
-        return true;
-    }
-#if !RV32_HAS(JIT)
-    if (unlikely(need_clear_block_map)) {
-        block_map_clear(rv);
-        need_clear_block_map = false;
-        rv->csr_cycle = cycle;
-        rv->PC = PC;
-        return false;
-    }
-#endif
-#endif
-    if (unlikely(RVOP_NO_NEXT(ir))) {
-        rv->csr_cycle = cycle;
-        rv->PC = PC;
-        return true;
-    }
-    const rv_insn_t *next = ir->next;
-    MUST_TAIL return next->impl(rv, next, cycle, PC);
-}
+#define FUSE_NEXT_OR_STOP(inst)                                               \
+    do {                                                                      \
+        IIF(RV32_HAS(SYSTEM))(                                                \
+            if (insn_may_trap(rv_insn_##inst) && need_handle_signal) {        \
+                need_handle_signal = false;                                   \
+                return true;                                                  \
+            }, )                                                              \
+        IIF(RV32_HAS(SYSTEM))(IIF(RV32_HAS(JIT))(                             \
+                                  , if (insn_may_trap(rv_insn_##inst) &&      \
+                                        unlikely(need_clear_block_map)) {     \
+                                      RVOP_SYNC_COUNTERS(rv);                 \
+                                      rv->PC = PC;                            \
+                                      block_map_clear(rv);                    \
+                                      need_clear_block_map = false;           \
+                                      return false;                           \
+                                  }), );                                      \
+        if (unlikely(RVOP_NO_NEXT(ir, insn_may_trap(rv_insn_##inst)))) {      \
+            RVOP_SYNC_COUNTERS(rv);                                           \
+            rv->PC = PC;                                                      \
+            return true;                                                      \
+        }                                                                     \
+        RVOP_NEXT();                                                          \
+    } while (0)
 
 /* multiple LUI */
-static PRESERVE_NONE bool do_fuse1(riscv_t *rv,
-                                   const rv_insn_t *ir,
-                                   uint64_t cycle,
-                                   uint32_t PC)
+RVOP_HANDLER(fuse1)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += ir->imm2;
     opcode_fuse_t *fuse = ir->fuse;
     for (int i = 0; i < ir->imm2; i++)
         rv->X[fuse[i].rd] = fuse[i].imm;
     PC += ir->imm2 * 4;
-    return fuse_next_or_stop(rv, ir, cycle, PC);
+    FUSE_NEXT_OR_STOP(fuse1);
 }
 
 /* LUI + ADD */
-static PRESERVE_NONE bool do_fuse2(riscv_t *rv,
-                                   const rv_insn_t *ir,
-                                   uint64_t cycle,
-                                   uint32_t PC)
+RVOP_HANDLER(fuse2)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += 2;
     rv->X[ir->rd] = ir->imm;
     rv->X[ir->rs2] = rv->X[ir->rd] + rv->X[ir->rs1];
     PC += 8;
-    return fuse_next_or_stop(rv, ir, cycle, PC);
+    FUSE_NEXT_OR_STOP(fuse2);
 }
 
 /* multiple SW */
-static PRESERVE_NONE bool do_fuse3(riscv_t *rv,
-                                   const rv_insn_t *ir,
-                                   uint64_t cycle,
-                                   uint32_t PC)
+RVOP_HANDLER(fuse3)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += ir->imm2;
     opcode_fuse_t *fuse = ir->fuse;
     for (int i = 0; i < ir->imm2; i++) {
         uint32_t addr = rv->X[fuse[i].rs1] + fuse[i].imm;
@@ -822,17 +1092,13 @@ static PRESERVE_NONE bool do_fuse3(riscv_t *rv,
 #endif
     }
     PC += ir->imm2 * 4;
-    return fuse_next_or_stop(rv, ir, cycle, PC);
+    FUSE_NEXT_OR_STOP(fuse3);
 }
 
 /* multiple LW */
-static PRESERVE_NONE bool do_fuse4(riscv_t *rv,
-                                   const rv_insn_t *ir,
-                                   uint64_t cycle,
-                                   uint32_t PC)
+RVOP_HANDLER(fuse4)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += ir->imm2;
     opcode_fuse_t *fuse = ir->fuse;
     for (int i = 0; i < ir->imm2; i++) {
         uint32_t addr = rv->X[fuse[i].rs1] + fuse[i].imm;
@@ -840,43 +1106,18 @@ static PRESERVE_NONE bool do_fuse4(riscv_t *rv,
         rv->X[fuse[i].rd] = MEM_READ_W(rv, addr);
     }
     PC += ir->imm2 * 4;
-    return fuse_next_or_stop(rv, ir, cycle, PC);
-}
-
-/* Execute shift operation from fused instruction data.
- * This avoids the unsafe cast from opcode_fuse_t* to rv_insn_t*.
- */
-static inline void fuse_shift_exec(riscv_t *rv, const opcode_fuse_t *f)
-{
-    switch (f->opcode) {
-    case rv_insn_slli:
-        rv->X[f->rd] = rv->X[f->rs1] << (f->imm & 0x1f);
-        break;
-    case rv_insn_srli:
-        rv->X[f->rd] = rv->X[f->rs1] >> (f->imm & 0x1f);
-        break;
-    case rv_insn_srai:
-        rv->X[f->rd] = ((int32_t) rv->X[f->rs1]) >> (f->imm & 0x1f);
-        break;
-    default:
-        __UNREACHABLE;
-        break;
-    }
+    FUSE_NEXT_OR_STOP(fuse4);
 }
 
 /* multiple shift immediate */
-static PRESERVE_NONE bool do_fuse5(riscv_t *rv,
-                                   const rv_insn_t *ir,
-                                   uint64_t cycle,
-                                   uint32_t PC)
+RVOP_HANDLER(fuse5)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += ir->imm2;
     opcode_fuse_t *fuse = ir->fuse;
     for (int i = 0; i < ir->imm2; i++)
         fuse_shift_exec(rv, &fuse[i]);
     PC += ir->imm2 * 4;
-    return fuse_next_or_stop(rv, ir, cycle, PC);
+    FUSE_NEXT_OR_STOP(fuse5);
 }
 
 /* fused LI + ECALL: li a7, imm; ecall
@@ -884,16 +1125,12 @@ static PRESERVE_NONE bool do_fuse5(riscv_t *rv,
  * uses a different syscall convention (t0 instead of a7).
  */
 #if !RV32_HAS(RV32E)
-static PRESERVE_NONE bool do_fuse6(riscv_t *rv,
-                                   const rv_insn_t *ir,
-                                   uint64_t cycle,
-                                   uint32_t PC)
+RVOP_HANDLER(fuse6)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += 2;
     rv->X[rv_reg_a7] = ir->imm;
     rv->compressed = false;
-    rv->csr_cycle = cycle;
+    RVOP_SYNC_COUNTERS(rv);
     /* ECALL is at PC+4 (second instruction in fused pair).
      * on_ecall expects rv->PC to be the ECALL address for trap handling.
      */
@@ -905,24 +1142,19 @@ static PRESERVE_NONE bool do_fuse6(riscv_t *rv,
 /* RV32E stub: fuse6 pattern is never generated for RV32E.
  * Defensive fallback in case of unexpected dispatch.
  */
-static PRESERVE_NONE bool do_fuse6(riscv_t *rv UNUSED,
-                                   const rv_insn_t *ir UNUSED,
-                                   uint64_t cycle UNUSED,
-                                   uint32_t PC UNUSED)
+RVOP_HANDLER(fuse6)
 {
     assert(!"fuse6 should not be called in RV32E mode");
+    RVOP_SYNC_COUNTERS(rv);
+    rv->PC = PC;
     return false;
 }
 #endif
 
 /* fused multiple ADDI */
-static PRESERVE_NONE bool do_fuse7(riscv_t *rv,
-                                   const rv_insn_t *ir,
-                                   uint64_t cycle,
-                                   uint32_t PC)
+RVOP_HANDLER(fuse7)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += ir->imm2;
     opcode_fuse_t *fuse = ir->fuse;
     for (int i = 0; i < ir->imm2; i++)
         /* Use unsigned arithmetic to avoid signed overflow UB.
@@ -931,7 +1163,7 @@ static PRESERVE_NONE bool do_fuse7(riscv_t *rv,
         rv->X[fuse[i].rd] =
             (uint32_t) rv->X[fuse[i].rs1] + (uint32_t) fuse[i].imm;
     PC += ir->imm2 * 4;
-    return fuse_next_or_stop(rv, ir, cycle, PC);
+    FUSE_NEXT_OR_STOP(fuse7);
 }
 
 /* fused LUI + ADDI: lui rd, imm20; addi rd, rd, imm12
@@ -940,17 +1172,13 @@ static PRESERVE_NONE bool do_fuse7(riscv_t *rv,
  * ir->imm2 = addi immediate (sign-extended 12-bit)
  * ir->rd = destination register
  */
-static PRESERVE_NONE bool do_fuse8(riscv_t *rv,
-                                   const rv_insn_t *ir,
-                                   uint64_t cycle,
-                                   uint32_t PC)
+RVOP_HANDLER(fuse8)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += 2;
     /* Cast to uint32_t to avoid signed overflow UB */
     rv->X[ir->rd] = (uint32_t) ir->imm + (uint32_t) ir->imm2;
     PC += 8;
-    return fuse_next_or_stop(rv, ir, cycle, PC);
+    FUSE_NEXT_OR_STOP(fuse8);
 }
 
 /* fused LUI + LW: lui rd, imm20; lw rd2, imm12(rd)
@@ -960,13 +1188,9 @@ static PRESERVE_NONE bool do_fuse8(riscv_t *rv,
  * ir->rd = lui destination (used as base)
  * ir->rs2 = lw destination register
  */
-static PRESERVE_NONE bool do_fuse9(riscv_t *rv,
-                                   const rv_insn_t *ir,
-                                   uint64_t cycle,
-                                   uint32_t PC)
+RVOP_HANDLER(fuse9)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += 2;
     /* Write LUI result to rd - required when rd != LW destination.
      * LUI completes before LW, so this write happens even if LW faults.
      */
@@ -976,7 +1200,7 @@ static PRESERVE_NONE bool do_fuse9(riscv_t *rv,
     RV_EXC_MISALIGN_HANDLER(3, LOAD, false, 1);
     rv->X[ir->rs2] = MEM_READ_W(rv, addr);
     PC += 8;
-    return fuse_next_or_stop(rv, ir, cycle, PC);
+    FUSE_NEXT_OR_STOP(fuse9);
 }
 
 /* fused LUI + SW: lui rd, imm20; sw rs2, imm12(rd)
@@ -986,13 +1210,9 @@ static PRESERVE_NONE bool do_fuse9(riscv_t *rv,
  * ir->rd = lui destination (used as base, dead after)
  * ir->rs1 = sw source register (data to store)
  */
-static PRESERVE_NONE bool do_fuse10(riscv_t *rv,
-                                    const rv_insn_t *ir,
-                                    uint64_t cycle,
-                                    uint32_t PC)
+RVOP_HANDLER(fuse10)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += 2;
     /* Write LUI result to rd - SW doesn't write registers, so rd may be
      * used later. LUI completes before SW, so this write happens even if
      * SW faults.
@@ -1007,7 +1227,7 @@ static PRESERVE_NONE bool do_fuse10(riscv_t *rv,
     check_tohost_write(rv, addr, value);
 #endif
     PC += 8;
-    return fuse_next_or_stop(rv, ir, cycle, PC);
+    FUSE_NEXT_OR_STOP(fuse10);
 }
 
 /* fused LW + ADDI (post-increment): lw rd, 0(rs1); addi rs1, rs1, step
@@ -1017,13 +1237,9 @@ static PRESERVE_NONE bool do_fuse10(riscv_t *rv,
  * ir->imm = load offset
  * ir->imm2 = increment step
  */
-static PRESERVE_NONE bool do_fuse11(riscv_t *rv,
-                                    const rv_insn_t *ir,
-                                    uint64_t cycle,
-                                    uint32_t PC)
+RVOP_HANDLER(fuse11)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += 2;
     uint32_t addr = rv->X[ir->rs1] + ir->imm;
     RV_EXC_MISALIGN_HANDLER(3, LOAD, false, 1);
     rv->X[ir->rd] = MEM_READ_W(rv, addr);
@@ -1035,7 +1251,7 @@ static PRESERVE_NONE bool do_fuse11(riscv_t *rv,
 #endif
         rv->X[ir->rs1] = rv->X[ir->rs1] + ir->imm2;
     PC += 8;
-    return fuse_next_or_stop(rv, ir, cycle, PC);
+    FUSE_NEXT_OR_STOP(fuse11);
 }
 
 /* fused ADDI + BNE: addi rd, rs1, imm; bne rd, x0, offset
@@ -1045,13 +1261,9 @@ static PRESERVE_NONE bool do_fuse11(riscv_t *rv,
  * ir->imm = addi immediate (usually -1 for countdown)
  * ir->imm2 = branch offset
  */
-static PRESERVE_NONE bool do_fuse12(riscv_t *rv,
-                                    const rv_insn_t *ir,
-                                    uint64_t cycle,
-                                    uint32_t PC)
+RVOP_HANDLER(fuse12)
 {
     RVOP_SYNC_PC(rv, PC);
-    cycle += 2;
     rv->X[ir->rd] = rv->X[ir->rs1] + ir->imm;
 
     if (rv->X[ir->rd] != 0) {
@@ -1063,11 +1275,11 @@ static PRESERVE_NONE bool do_fuse12(riscv_t *rv,
 #if RV32_HAS(SYSTEM)
             if (!rv->is_trapped) {
                 last_pc = PC;
-                MUST_TAIL return taken->impl(rv, taken, cycle, PC);
+                RVOP_JUMP(taken);
             }
 #else
             last_pc = PC;
-            MUST_TAIL return taken->impl(rv, taken, cycle, PC);
+            RVOP_JUMP(taken);
 #endif
         }
     } else {
@@ -1079,20 +1291,77 @@ static PRESERVE_NONE bool do_fuse12(riscv_t *rv,
 #if RV32_HAS(SYSTEM)
             if (!rv->is_trapped) {
                 last_pc = PC;
-                MUST_TAIL return untaken->impl(rv, untaken, cycle, PC);
+                RVOP_JUMP(untaken);
             }
 #else
             last_pc = PC;
-            MUST_TAIL return untaken->impl(rv, untaken, cycle, PC);
+            RVOP_JUMP(untaken);
 #endif
         }
     }
 
+    RVOP_SYNC_COUNTERS(rv);
+    rv->PC = PC;
+    return true;
+}
+
+/* fused SLLI + ADD: slli rd, rs1, shamt; add rd, rd, rs2 (or rs2, rd)
+ * Array indexing idiom, equivalent to the Zba shNadd instructions.
+ * ir->rd = destination, which also holds the shifted index in between
+ * ir->rs1 = index register
+ * ir->rs2 = base register
+ * ir->imm = shift amount
+ * ir->imm2 = byte length of the pair, either form may be compressed
+ */
+RVOP_HANDLER(fuse13)
+{
+    RVOP_SYNC_PC(rv, PC);
+    rv->X[ir->rd] = rv->X[ir->rs2] + (rv->X[ir->rs1] << (ir->imm & 0x1f));
+    PC += ir->imm2;
+    FUSE_NEXT_OR_STOP(fuse13);
+}
+
+#if RV32_HAS(GDBSTUB)
+/* GDB breakpoint, patched over the handler of the IR at its address. Blocks
+ * are not fused while the GDB stub is attached, so the IR is one instruction,
+ * and the counts before it are those after the previous IR or at the entry of
+ * the block.
+ */
+RVOP_HANDLER(debug_break)
+{
+    if (ir->insn_ofs > 1) {
+        cycle += (ir - 1)->cycle_ofs;
+        instret += (ir - 1)->insn_ofs;
+    }
     rv->csr_cycle = cycle;
+    rv->csr_instret = instret;
     rv->PC = PC;
+    rv->debug_stop = true;
     return true;
 }
+#endif
+
+#if RV32_HAS(COMPUTED_GOTO)
+    /* every handler leaves through a return or RVOP_JUMP */
+    __UNREACHABLE;
+} /* threaded_dispatch() */
+
+/* Execute from @ir until the chain of IRs stops */
+FORCE_INLINE bool dispatch_ir(riscv_t *rv,
+                              const rv_insn_t *ir,
+                              uint64_t cycle,
+                              uint64_t instret,
+                              uint32_t PC)
+{
+    return threaded_dispatch(rv, ir, cycle, instret, PC);
+}
 
+FORCE_INLINE void dispatch_init(void)
+{
+    if (unlikely(!dispatch_table))
+        threaded_dispatch(NULL, NULL, 0, 0, 0);
+}
+#else
 /* clang-format off */
 static const void *dispatch_table[] = {
     /* RV32 instructions */
@@ -1106,6 +1375,23 @@ static const void *dispatch_table[] = {
 };
 /* clang-format on */
 
+#if RV32_HAS(GDBSTUB)
+#define DEBUG_BREAK_IMPL ((const void *) do_debug_break)
+#endif
+
+/* Execute from @ir until the chain of IRs stops */
+FORCE_INLINE bool dispatch_ir(riscv_t *rv,
+                              const rv_insn_t *ir,
+                              uint64_t cycle,
+                              uint64_t instret,
+                              uint32_t PC)
+{
+    return ir->impl(rv, ir, cycle, instret, PC);
+}
+
+FORCE_INLINE void dispatch_init(void) {}
+#endif
+
 #if RV32_HAS(JIT)
 FORCE_INLINE bool insn_is_translatable(uint8_t opcode)
 {
@@ -1163,18 +1449,350 @@ FORCE_INLINE bool insn_is_direct_branch(uint8_t opcode)
 }
 #endif
 
-FORCE_INLINE bool insn_is_indirect_branch(uint8_t opcode)
+/* initial capacity of the IR array of a block under translation */
+#define BLOCK_IR_INIT_CAPACITY 16
+
+static rv_insn_t *block_ir_alloc(uint32_t n_insn)
+{
+    void *irs;
+    if (posix_memalign(&irs, CACHE_LINE_SIZE, n_insn * sizeof(rv_insn_t)))
+        return NULL;
+    return irs;
+}
+
+/* Move the first n_insn IRs into a new array of the given capacity */
+static rv_insn_t *block_ir_resize(rv_insn_t *irs,
+                                  uint32_t n_insn,
+                                  uint32_t capacity)
+{
+    rv_insn_t *new_irs = block_ir_alloc(capacity);
+    if (likely(new_irs))
+        memcpy(new_irs, irs, n_insn * sizeof(rv_insn_t));
+    free(irs);
+    return new_irs;
+}
+
+/* Link the IR array of a block so that each IR points at the adjacent one */
+static void block_ir_link(block_t *block)
+{
+    rv_insn_t *ir = block->ir_head;
+    block->ir_tail = ir + block->n_insn - 1;
+    for (; ir < block->ir_tail; ir++)
+        ir->next = ir + 1;
+    block->ir_tail->next = NULL;
+}
+
+/* Timing models. The cycles of an instruction depend on its class, and on
+ * the instruction before it for the load-use stall. They are charged when the
+ * block is translated, so a model costs nothing while the guest runs, and
+ * anything that depends on the direction a branch actually takes is left
+ * out: a conditional branch is assumed to go the way a static BTFN predictor
+ * guesses, taken when it jumps backward and not taken otherwise.
+ */
+static const timing_model_t timing_models[] = {
+    /* one instruction per cycle, which keeps cycle equal to instret */
+    {
+        .name = "ideal",
+        .latency =
+            {
+#define _(cls) [TIMING_##cls] = 1,
+                TIMING_CLASS_LIST
+#undef _
+            },
+    },
+    /* scalar five-stage pipeline with forwarding, an iterative divider and
+     * no branch predictor, so every taken jump flushes fetch and decode
+     */
+    {
+        .name = "inorder",
+        .latency =
+            {
+                [TIMING_alu] = 1,
+                [TIMING_mul] = 3,
+                [TIMING_div] = 34,
+                [TIMING_load] = 1,
+                [TIMING_store] = 1,
+                [TIMING_branch] = 1,
+                [TIMING_jump] = 1,
+                [TIMING_jump_indirect] = 2,
+                [TIMING_amo] = 4,
+                [TIMING_csr] = 3,
+                [TIMING_fence] = 4,
+                [TIMING_system] = 5,
+                [TIMING_fp] = 3,
+                [TIMING_fp_mul] = 4,
+                [TIMING_fp_div] = 16,
+            },
+        .load_use = 1,
+        .taken = 2,
+    },
+    /* non-pipelined core in the style of small FPGA soft cores, which spends
+     * several cycles on fetch, decode and register access of every instruction
+     */
+    {
+        .name = "multicycle",
+        .latency =
+            {
+                [TIMING_alu] = 3,
+                [TIMING_mul] = 4,
+                [TIMING_div] = 40,
+                [TIMING_load] = 5,
+                [TIMING_store] = 5,
+                [TIMING_branch] = 3,
+                [TIMING_jump] = 1,
+                [TIMING_jump_indirect] = 4,
+                [TIMING_amo] = 8,
+                [TIMING_csr] = 4,
+                [TIMING_fence] = 3,
+                [TIMING_system] = 6,
+                [TIMING_fp] = 10,
+                [TIMING_fp_mul] = 12,
+                [TIMING_fp_div] = 40,
+            },
+        .taken = 2,
+    },
+};
+
+const timing_model_t *timing_model_find(const char *name)
+{
+    if (!name)
+        return &timing_models[0];
+    for (size_t i = 0; i < ARRAY_SIZE(timing_models); i++) {
+        if (!strcmp(timing_models[i].name, name))
+            return &timing_models[i];
+    }
+    return NULL;
+}
+
+static uint8_t timing_class(uint8_t opcode)
 {
     switch (opcode) {
+#if RV32_HAS(EXT_M)
+    case rv_insn_mul:
+    case rv_insn_mulh:
+    case rv_insn_mulhsu:
+    case rv_insn_mulhu:
+        return TIMING_mul;
+    case rv_insn_div:
+    case rv_insn_divu:
+    case rv_insn_rem:
+    case rv_insn_remu:
+        return TIMING_div;
+#endif
+    case rv_insn_lb:
+    case rv_insn_lh:
+    case rv_insn_lw:
+    case rv_insn_lbu:
+    case rv_insn_lhu:
+#if RV32_HAS(EXT_F)
+    case rv_insn_flw:
+#endif
+#if RV32_HAS(EXT_C)
+    case rv_insn_clw:
+    case rv_insn_clwsp:
+#endif
+#if RV32_HAS(EXT_C) && RV32_HAS(EXT_F)
+    case rv_insn_cflw:
+    case rv_insn_cflwsp:
+#endif
+        return TIMING_load;
+    case rv_insn_sb:
+    case rv_insn_sh:
+    case rv_insn_sw:
+#if RV32_HAS(EXT_F)
+    case rv_insn_fsw:
+#endif
+#if RV32_HAS(EXT_C)
+    case rv_insn_csw:
+    case rv_insn_cswsp:
+#endif
+#if RV32_HAS(EXT_C) && RV32_HAS(EXT_F)
+    case rv_insn_cfsw:
+    case rv_insn_cfswsp:
+#endif
+        return TIMING_store;
+    case rv_insn_beq:
+    case rv_insn_bne:
+    case rv_insn_blt:
+    case rv_insn_bge:
+    case rv_insn_bltu:
+    case rv_insn_bgeu:
+#if RV32_HAS(EXT_C)
+    case rv_insn_cbeqz:
+    case rv_insn_cbnez:
+#endif
+        return TIMING_branch;
+    case rv_insn_jal:
+#if RV32_HAS(EXT_C)
+    case rv_insn_cjal:
+    case rv_insn_cj:
+#endif
+        return TIMING_jump;
     case rv_insn_jalr:
 #if RV32_HAS(EXT_C)
-    case rv_insn_cjalr:
     case rv_insn_cjr:
+    case rv_insn_cjalr:
+#endif
+        return TIMING_jump_indirect;
+#if RV32_HAS(EXT_A)
+    case rv_insn_lrw:
+    case rv_insn_scw:
+    case rv_insn_amoswapw:
+    case rv_insn_amoaddw:
+    case rv_insn_amoxorw:
+    case rv_insn_amoandw:
+    case rv_insn_amoorw:
+    case rv_insn_amominw:
+    case rv_insn_amomaxw:
+    case rv_insn_amominuw:
+    case rv_insn_amomaxuw:
+        return TIMING_amo;
+#endif
+#if RV32_HAS(Zicsr)
+    case rv_insn_csrrw:
+    case rv_insn_csrrs:
+    case rv_insn_csrrc:
+    case rv_insn_csrrwi:
+    case rv_insn_csrrsi:
+    case rv_insn_csrrci:
+        return TIMING_csr;
+#endif
+    case rv_insn_fence:
+#if RV32_HAS(Zifencei)
+    case rv_insn_fencei:
+#endif
+    case rv_insn_sfencevma:
+        return TIMING_fence;
+    case rv_insn_ecall:
+    case rv_insn_ebreak:
+#if !RV32_HAS(SYSTEM)
+    case rv_insn_libcall:
+#endif
+    case rv_insn_wfi:
+    case rv_insn_uret:
+#if RV32_HAS(SYSTEM)
+    case rv_insn_sret:
+#endif
+    case rv_insn_hret:
+    case rv_insn_mret:
+#if RV32_HAS(EXT_C)
+    case rv_insn_cebreak:
+#endif
+        return TIMING_system;
+#if RV32_HAS(EXT_F)
+    case rv_insn_fmadds:
+    case rv_insn_fmsubs:
+    case rv_insn_fnmsubs:
+    case rv_insn_fnmadds:
+    case rv_insn_fmuls:
+        return TIMING_fp_mul;
+    case rv_insn_fdivs:
+    case rv_insn_fsqrts:
+        return TIMING_fp_div;
+    case rv_insn_fadds:
+    case rv_insn_fsubs:
+    case rv_insn_fsgnjs:
+    case rv_insn_fsgnjns:
+    case rv_insn_fsgnjxs:
+    case rv_insn_fmins:
+    case rv_insn_fmaxs:
+    case rv_insn_fcvtws:
+    case rv_insn_fcvtwus:
+    case rv_insn_fmvxw:
+    case rv_insn_feqs:
+    case rv_insn_flts:
+    case rv_insn_fles:
+    case rv_insn_fclasss:
+    case rv_insn_fcvtsw:
+    case rv_insn_fcvtswu:
+    case rv_insn_fmvwx:
+        return TIMING_fp;
 #endif
-        return true;
     default:
+        return TIMING_alu;
+    }
+}
+
+/* Whether @ir may read register @reg, which is all the load-use stall needs.
+ * Register numbers are compared regardless of the register file.
+ */
+static bool timing_reads_reg(const rv_insn_t *ir, uint8_t reg)
+{
+    switch (ir->opcode) {
+    case rv_insn_lui:
+    case rv_insn_auipc:
+    case rv_insn_jal:
+#if RV32_HAS(EXT_C)
+    case rv_insn_cli:
+    case rv_insn_clui:
+    case rv_insn_cjal:
+    case rv_insn_cj:
+#endif
         return false;
+#if RV32_HAS(EXT_C)
+    /* rd is also the first source */
+    case rv_insn_caddi:
+    case rv_insn_cslli:
+        return ir->rd == reg;
+#endif
+    default:
+        return ir->rs1 == reg || ir->rs2 == reg;
+    }
+}
+
+/* Cycles of @ir, which follows @prev in the same block, or NULL */
+static uint32_t timing_cost(const timing_model_t *model,
+                            const rv_insn_t *ir,
+                            const rv_insn_t *prev)
+{
+    const uint8_t cls = timing_class(ir->opcode);
+    uint32_t cost = model->latency[cls];
+
+    if (prev && prev->rd && timing_class(prev->opcode) == TIMING_load &&
+        timing_reads_reg(ir, prev->rd))
+        cost += model->load_use;
+
+    switch (cls) {
+    case TIMING_branch:
+        if (ir->imm < 0)
+            cost += model->taken;
+        break;
+    case TIMING_jump:
+    case TIMING_jump_indirect:
+        cost += model->taken;
+        break;
+    default:
+        break;
+    }
+    return cost;
+}
+
+/* Charge the timing model and count retired instructions along the freshly
+ * decoded IRs of a block. Later passes that merge IRs keep the offsets of the
+ * last IR they absorb (see remove_next_nth_ir()), so the totals reflect the
+ * guest instructions rather than the optimized IRs. The loads, stores and
+ * conditional branches of the block are counted here too, for the PMU events.
+ */
+static void block_charge_cycles(const riscv_t *rv, block_t *block)
+{
+    uint32_t cycle_ofs = 0;
+    uint16_t insn_ofs = 0;
+    uint16_t n_load = 0, n_store = 0;
+    const rv_insn_t *prev = NULL;
+    for (rv_insn_t *ir = block->ir_head; ir; ir = ir->next) {
+        cycle_ofs += timing_cost(rv->timing, ir, prev);
+        ir->cycle_ofs = cycle_ofs;
+        ir->insn_ofs = ++insn_ofs;
+        const int access = insn_mem_access(ir->opcode);
+        n_load += !!(access & INSN_ACCESS_LOAD);
+        n_store += !!(access & INSN_ACCESS_STORE);
+        prev = ir;
     }
+    block->cycle_cost = cycle_ofs;
+    block->n_retired = insn_ofs;
+    block->n_load = n_load;
+    block->n_store = n_store;
+    block->cond_branch = prev && insn_is_cond_branch(prev->opcode);
 }
 
 static bool block_translate(riscv_t *rv, block_t *block)
@@ -1185,22 +1803,34 @@ retranslate:
     block->page_terminated = false;
 #endif
 
-    rv_insn_t *prev_ir = NULL;
-    rv_insn_t *ir = mpool_calloc(rv->block_ir_mp);
-    if (unlikely(!ir))
+    /* The IRs are decoded into a growable array, which is trimmed to the
+     * final block length once translation stops.
+     */
+    uint32_t capacity = BLOCK_IR_INIT_CAPACITY;
+    rv_insn_t *irs = block_ir_alloc(capacity);
+    if (unlikely(!irs))
         return false;
-    block->ir_head = ir;
 
     /* translate the basic block */
     while (true) {
-        if (prev_ir)
-            prev_ir->next = ir;
+        /* insn_ofs of an IR must not overflow */
+        if (block->n_insn == UINT16_MAX)
+            break;
+        if (block->n_insn == capacity) {
+            capacity <<= 1;
+            irs = block_ir_resize(irs, block->n_insn, capacity);
+            if (unlikely(!irs))
+                return false;
+        }
+        rv_insn_t *ir = irs + block->n_insn;
+        memset(ir, 0, sizeof(rv_insn_t));
 
         /* fetch the next instruction */
         uint32_t insn = rv->io.mem_ifetch(rv, block->pc_end);
 
 #if RV32_HAS(SYSTEM)
         if (!insn && need_retranslate) {
+            free(irs);
             memset(block, 0, sizeof(block_t));
             need_retranslate = false;
             goto retranslate;
@@ -1220,22 +1850,39 @@ retranslate:
             SET_CAUSE_AND_TVAL_THEN_TRAP(rv, ILLEGAL_INSN, insn);
             break;
         }
+#if !RV32_HAS(SYSTEM)
+        /* the entry of an accelerated libc routine becomes a block of its own
+         * that runs the routine on the host
+         */
+        if (!block->n_insn && rv->libc_calls) {
+            map_iter_t it;
+            map_find(rv->libc_calls, &it, &block->pc_end);
+            if (!map_at_end(rv->libc_calls, &it)) {
+                ir->opcode = rv_insn_libcall;
+                ir->imm = map_iter_value(&it, uint32_t);
+            }
+        }
+#endif
         ir->impl = dispatch_table[ir->opcode];
         ir->pc = block->pc_end; /* compute the end of pc */
         block->pc_end += is_compressed(insn) ? 2 : 4;
         block->n_insn++;
-        prev_ir = ir;
 #if RV32_HAS(JIT)
         if (!insn_is_translatable(ir->opcode))
             block->translatable = false;
 #endif
         /* stop on branch */
         if (insn_is_branch(ir->opcode)) {
-            if (insn_is_indirect_branch(ir->opcode)) {
+            /* rv_step_block() must see every block, so the histogram mode
+             * keeps indirect jumps from chaining through the table.
+             */
+            if (insn_is_indirect_branch(ir->opcode) &&
+                !(PRIV(rv)->run_flag & RV_RUN_HISTOGRAM)) {
                 ir->branch_table = calloc(1, sizeof(branch_history_table_t));
-                if (unlikely(!ir->branch_table))
+                if (unlikely(!ir->branch_table)) {
+                    free(irs);
                     return false;
-                assert(ir->branch_table);
+                }
                 memset(ir->branch_table->PC, -1,
                        sizeof(uint32_t) * HISTORY_SIZE);
             }
@@ -1256,51 +1903,57 @@ retranslate:
             }
         }
 #endif
-
-        ir = mpool_calloc(rv->block_ir_mp);
-        if (unlikely(!ir))
-            return false;
     }
 
     /* If no instructions were successfully decoded (e.g., first instruction
-     * was illegal), free the allocated IR and return failure.
+     * was illegal), free the IR array and return failure.
      */
-    if (unlikely(!prev_ir)) {
-        mpool_free(rv->block_ir_mp, block->ir_head);
+    if (unlikely(!block->n_insn)) {
+        free(irs);
         return false;
     }
 
-    /* Free orphaned IR that was allocated at end of previous iteration but not
-     * used due to early break (fetch fail, decode fail, etc.).
-     * This IR was linked at prev_ir->next but never became prev_ir.
-     */
-    if (prev_ir->next)
-        mpool_free(rv->block_ir_mp, prev_ir->next);
+    /* trim the unused tail of the IR array */
+    if (block->n_insn < capacity) {
+        irs = block_ir_resize(irs, block->n_insn, block->n_insn);
+        if (unlikely(!irs))
+            return false;
+    }
 
-    block->ir_tail = prev_ir;
-    block->ir_tail->next = NULL;
-    /* Set cycle cost before macro-op fusion. This intentionally counts
-     * original instructions for accurate timing - fused operations still
+    block->ir_head = irs;
+    block_ir_link(block);
+    /* Charge cycles before the IRs are optimized. This intentionally looks at
+     * the original instructions for accurate timing - fused operations still
      * represent the same logical work as unfused sequences.
      */
-    block->cycle_cost = block->n_insn;
+    block_charge_cycles(rv, block);
     return true;
 }
 
 #if RV32_HAS(MOP_FUSION)
-static inline void remove_next_nth_ir(const riscv_t *rv,
+/* Remove the n IRs following ir by sliding the rest of the block down, which
+ * keeps the IR array contiguous. Only IRs after ir move: the block head, and
+ * thus every branch target pointing into this block, stays in place.
+ */
+static inline void remove_next_nth_ir(const riscv_t *rv UNUSED,
                                       rv_insn_t *ir,
                                       block_t *block,
                                       uint8_t n)
 {
-    for (uint8_t i = 0; i < n; i++) {
-        rv_insn_t *next = ir->next;
-        ir->next = ir->next->next;
-        mpool_free(rv->block_ir_mp, next);
-    }
-    if (!ir->next)
-        block->ir_tail = ir;
+    /* ir now stands for the IRs it absorbs, so it ends where the last does */
+    ir->cycle_ofs = ir[n].cycle_ofs;
+    ir->insn_ofs = ir[n].insn_ofs;
+    memmove(ir + 1, ir + 1 + n,
+            (block->ir_tail - ir - n) * sizeof(rv_insn_t));
     block->n_insn -= n;
+    block_ir_link(block);
+#if RV32_HAS(SYSTEM_MMIO)
+    /* lazy fusion candidates recorded past ir have moved as well */
+    for (uint8_t i = 0; i < block->n_lazy_candidates; i++) {
+        if (block->lazy_candidates[i].ir > ir)
+            block->lazy_candidates[i].ir -= n;
+    }
+#endif
 }
 
 /* Count consecutive instructions with same opcode */
@@ -1362,7 +2015,7 @@ static inline bool try_fuse_sequence(riscv_t *rv,
 
     ir->fuse = fuse_data;
     /* Copy original instruction BEFORE changing opcode (preserves original
-     * opcode in fuse[0] for handlers like shift_func that need it) */
+     * opcode in fuse[0] for handlers like fuse_shift_exec that need it) */
     memcpy(ir->fuse, ir, sizeof(opcode_fuse_t));
     ir->opcode = fuse_opcode;
     ir->imm2 = count;
@@ -1376,6 +2029,43 @@ static inline bool try_fuse_sequence(riscv_t *rv,
     return true;
 }
 
+/* SLLI + ADD scaled index fusion (fuse13):
+ * slli rd, rs1, shamt; add rd, rd, rs2
+ * The shifted value only lives in rd until the ADD overwrites it, so the pair
+ * collapses into rd = rs2 + (rs1 << shamt). The other ADD operand must not be
+ * rd, whose value SLLI changes. Compressed forms (C.SLLI, C.ADD) are accepted
+ * as well, so the byte length of the pair is kept in imm2.
+ */
+static bool try_fuse_shift_add(riscv_t *rv, block_t *block, rv_insn_t *ir)
+{
+    const rv_insn_t *next_ir = ir->next;
+    if (!next_ir || next_ir->rd != ir->rd || (ir->imm & ~0x1f))
+        return false;
+
+    uint8_t insn_len;
+    if (IF_insn(next_ir, add))
+        insn_len = 4;
+#if RV32_HAS(EXT_C)
+    else if (IF_insn(next_ir, cadd))
+        insn_len = 2;
+#endif
+    else
+        return false;
+
+    if ((next_ir->rs1 == ir->rd) == (next_ir->rs2 == ir->rd))
+        return false;
+
+    /* C.SLLI shifts rd in place and leaves rs1 unset */
+    if (!IF_insn(ir, slli))
+        ir->rs1 = ir->rd;
+    ir->rs2 = (next_ir->rs1 == ir->rd) ? next_ir->rs2 : next_ir->rs1;
+    ir->imm2 = next_ir->pc + insn_len - ir->pc;
+    ir->opcode = rv_insn_fuse13;
+    ir->impl = dispatch_table[ir->opcode];
+    remove_next_nth_ir(rv, ir, block, 1);
+    return true;
+}
+
 #if RV32_HAS(SYSTEM_MMIO)
 /* Function argument registers (a0-a7) - likely to change between calls.
  * Lazy fusion verified once may become invalid if these registers
@@ -1658,7 +2348,15 @@ static void match_pattern(riscv_t *rv, block_t *block)
             break;
             /* TODO: mixture of SW and LW */
             /* TODO: reorder instruction to match pattern */
+#if RV32_HAS(EXT_C)
+        case rv_insn_cslli:
+            try_fuse_shift_add(rv, block, ir);
+            break;
+#endif
         case rv_insn_slli:
+            if (try_fuse_shift_add(rv, block, ir))
+                break;
+            /* fall through */
         case rv_insn_srli:
         case rv_insn_srai:
             /* Multiple shift immediate fusion (fuse5) */
@@ -1780,69 +2478,297 @@ static void try_lazy_fusion(riscv_t *rv, block_t *block)
             /* Compute address: base + offset */
             uint32_t addr = rv->X[ir->rs1] + (uint32_t) ir->imm;
 
-            /* Check if address is within RAM bounds */
-            if (!GUEST_RAM_CONTAINS(PRIV(rv)->mem, addr, 4)) {
-                all_ram = false;
-                cand->failed = true;
+            /* Check if address is within RAM bounds */
+            if (!GUEST_RAM_CONTAINS(PRIV(rv)->mem, addr, 4)) {
+                all_ram = false;
+                cand->failed = true;
+                break;
+            }
+        }
+
+        if (all_ram) {
+            /* Attempt fusion - may fail due to allocation */
+            uint8_t fuse_opcode =
+                (cand->opcode == rv_insn_lw) ? rv_insn_fuse4 : rv_insn_fuse3;
+            if (try_fuse_sequence(rv, block, cand->ir, cand->count,
+                                  fuse_opcode)) {
+                cand->verified = true;
+            } else {
+                /* Allocation failed, can retry later */
+                all_finalized = false;
+            }
+        }
+    }
+
+    /* Only mark done when all candidates have final state */
+    if (all_finalized)
+        block->lazy_fusion_done = true;
+}
+#endif /* RV32_HAS(SYSTEM_MMIO) */
+#endif /* RV32_HAS(MOP_FUSION) */
+
+typedef struct {
+    bool is_constant[N_RV_REGS];
+    uint32_t const_val[N_RV_REGS];
+} constopt_info_t;
+
+#define CONSTOPT(inst, code)                                  \
+    static void constopt_##inst(rv_insn_t *ir UNUSED,         \
+                                constopt_info_t *info UNUSED) \
+    {                                                         \
+        code;                                                 \
+    }
+
+#include "rv32_constopt.c"
+static const void *constopt_table[] = {
+#define _(inst, can_branch, insn_len, translatable, reg_mask) \
+    [rv_insn_##inst] = constopt_##inst,
+    RV_INSN_LIST
+#undef _
+};
+#undef CONSTOPT
+
+typedef void (*constopt_func_t)(rv_insn_t *, constopt_info_t *);
+static void optimize_constant(riscv_t *rv UNUSED, block_t *block)
+{
+    constopt_info_t info = {.is_constant[0] = true};
+    assert(rv->X[0] == 0);
+
+    uint32_t i;
+    rv_insn_t *ir;
+    for (i = 0, ir = block->ir_head; i < block->n_insn; i++, ir = ir->next)
+        ((constopt_func_t) constopt_table[ir->opcode])(ir, &info);
+}
+
+/* Copy propagation and dead register write elimination.
+ *
+ * Both passes only reason about plain ALU instructions, which never trap and
+ * name every register they touch. Any other instruction is a barrier: it may
+ * trap and expose the register file, access memory, or read and write
+ * registers implicitly. All registers are live at block exit. Under these
+ * rules, rewriting a source to an equal register and dropping a write that is
+ * overwritten before any read are invisible to the guest. Blocks translated
+ * while GDB is attached skip them, as it can stop after every instruction.
+ */
+#define ALU_BARRIER 0xff
+
+/* register fields read by an ALU instruction, or ALU_BARRIER */
+static uint8_t alu_insn_srcs(const rv_insn_t *ir)
+{
+    switch (ir->opcode) {
+    case rv_insn_lui:
+#if RV32_HAS(EXT_C)
+    case rv_insn_cli:
+    case rv_insn_clui:
+#endif
+        return F_none;
+    case rv_insn_addi:
+    case rv_insn_slti:
+    case rv_insn_sltiu:
+    case rv_insn_xori:
+    case rv_insn_ori:
+    case rv_insn_andi:
+    case rv_insn_slli:
+    case rv_insn_srli:
+    case rv_insn_srai:
+        return F_rs1;
+    case rv_insn_add:
+    case rv_insn_sub:
+    case rv_insn_sll:
+    case rv_insn_slt:
+    case rv_insn_sltu:
+    case rv_insn_xor:
+    case rv_insn_srl:
+    case rv_insn_sra:
+    case rv_insn_or:
+    case rv_insn_and:
+#if RV32_HAS(EXT_M)
+    case rv_insn_mul:
+    case rv_insn_mulh:
+    case rv_insn_mulhsu:
+    case rv_insn_mulhu:
+#endif
+#if RV32_HAS(EXT_C)
+    case rv_insn_cadd:
+#endif
+        return F_rs1 | F_rs2;
+#if RV32_HAS(EXT_C)
+    case rv_insn_cmv:
+        return F_rs2;
+#endif
+    default:
+        return ALU_BARRIER;
+    }
+}
+
+/* source register if the instruction is a register move, otherwise rd */
+static uint8_t alu_insn_move_src(const rv_insn_t *ir)
+{
+    switch (ir->opcode) {
+    case rv_insn_addi:
+        return ir->imm ? ir->rd : ir->rs1;
+    case rv_insn_add:
+        if (ir->rs1 == rv_reg_zero)
+            return ir->rs2;
+        return ir->rs2 == rv_reg_zero ? ir->rs1 : ir->rd;
+#if RV32_HAS(EXT_C)
+    case rv_insn_cmv:
+        return ir->rs2;
+#endif
+    default:
+        return ir->rd;
+    }
+}
+
+/* Read registers through the moves that copied them, e.g.
+ *   mv a5, a0; addi a5, a5, 1  ->  mv a5, a0; addi a5, a0, 1
+ * which shortens dependency chains and leaves the move dead.
+ */
+static void propagate_copies(block_t *block)
+{
+    uint8_t copy_of[N_RV_REGS];
+    for (int i = 0; i < N_RV_REGS; i++)
+        copy_of[i] = i;
+
+    for (rv_insn_t *ir = block->ir_head; ir; ir = ir->next) {
+        const uint8_t srcs = alu_insn_srcs(ir);
+        if (srcs == ALU_BARRIER) {
+            for (int i = 0; i < N_RV_REGS; i++)
+                copy_of[i] = i;
+            continue;
+        }
+
+        if (srcs & F_rs1)
+            ir->rs1 = copy_of[ir->rs1];
+        if (srcs & F_rs2)
+            ir->rs2 = copy_of[ir->rs2];
+
+        /* rd takes a new value: it is no longer a copy, and copies made from
+         * it are dropped
+         */
+        copy_of[ir->rd] = ir->rd;
+        for (int i = 0; i < N_RV_REGS; i++) {
+            if (copy_of[i] == ir->rd)
+                copy_of[i] = i;
+        }
+        const uint8_t src = alu_insn_move_src(ir);
+        if (ir->rd != rv_reg_zero && src != ir->rd)
+            copy_of[ir->rd] = src;
+    }
+}
+
+/* Turn ALU writes that are overwritten before being read into no-ops. The
+ * no-op keeps the instruction length, so PC and cycle accounting are intact.
+ */
+static void eliminate_dead_writes(block_t *block)
+{
+    for (rv_insn_t *ir = block->ir_head; ir; ir = ir->next) {
+        if (ir->rd == rv_reg_zero || alu_insn_srcs(ir) == ALU_BARRIER)
+            continue;
+
+        for (const rv_insn_t *later = ir->next; later; later = later->next) {
+            const uint8_t srcs = alu_insn_srcs(later);
+            if (srcs == ALU_BARRIER ||
+                ((srcs & F_rs1) && later->rs1 == ir->rd) ||
+                ((srcs & F_rs2) && later->rs2 == ir->rd))
                 break;
-            }
-        }
+            if (later->rd != ir->rd)
+                continue;
 
-        if (all_ram) {
-            /* Attempt fusion - may fail due to allocation */
-            uint8_t fuse_opcode =
-                (cand->opcode == rv_insn_lw) ? rv_insn_fuse4 : rv_insn_fuse3;
-            if (try_fuse_sequence(rv, block, cand->ir, cand->count,
-                                  fuse_opcode)) {
-                cand->verified = true;
-            } else {
-                /* Allocation failed, can retry later */
-                all_finalized = false;
-            }
+            uint8_t nop = rv_insn_nop;
+#if RV32_HAS(EXT_C)
+            if (ir->next->pc - ir->pc == 2)
+                nop = rv_insn_cnop;
+#endif
+            /* pc, insn_ofs and cycle_ofs stay as they are */
+            ir->imm = 0;
+            ir->rd = ir->rs1 = ir->rs2 = rv_reg_zero;
+            ir->opcode = nop;
+            ir->impl = dispatch_table[ir->opcode];
+            break;
         }
     }
-
-    /* Only mark done when all candidates have final state */
-    if (all_finalized)
-        block->lazy_fusion_done = true;
 }
-#endif /* RV32_HAS(SYSTEM_MMIO) */
-#endif /* RV32_HAS(MOP_FUSION) */
 
-typedef struct {
-    bool is_constant[N_RV_REGS];
-    uint32_t const_val[N_RV_REGS];
-} constopt_info_t;
+#if RV32_HAS(GDBSTUB)
+/* Point the IR of @block at @addr, if any, to the breakpoint handler if @set,
+ * or back to its own handler otherwise.
+ */
+static void breakpoint_patch_ir(block_t *block, uint32_t addr, bool set)
+{
+    if (addr < block->pc_start || addr >= block->pc_end)
+        return;
 
-#define CONSTOPT(inst, code)                                  \
-    static void constopt_##inst(rv_insn_t *ir UNUSED,         \
-                                constopt_info_t *info UNUSED) \
-    {                                                         \
-        code;                                                 \
+    for (rv_insn_t *ir = block->ir_head; ir; ir = ir->next) {
+        if (ir->pc == addr) {
+            ir->impl = set ? DEBUG_BREAK_IMPL : dispatch_table[ir->opcode];
+            return;
+        }
     }
+}
 
-#include "rv32_constopt.c"
-static const void *constopt_table[] = {
-#define _(inst, can_branch, insn_len, translatable, reg_mask) \
-    [rv_insn_##inst] = constopt_##inst,
-    RV_INSN_LIST
-#undef _
-};
-#undef CONSTOPT
+/* patch the breakpoints within a block that has just been translated */
+static void breakpoint_patch_block(riscv_t *rv, block_t *block)
+{
+    if (map_empty(rv->breakpoint_map))
+        return;
 
-typedef void (*constopt_func_t)(rv_insn_t *, constopt_info_t *);
-static void optimize_constant(riscv_t *rv UNUSED, block_t *block)
+    for (rv_insn_t *ir = block->ir_head; ir; ir = ir->next) {
+        if (breakpoint_map_find(rv->breakpoint_map, ir->pc))
+            ir->impl = DEBUG_BREAK_IMPL;
+    }
+}
+
+void breakpoint_patch(riscv_t *rv, riscv_word_t addr, bool set)
 {
-    constopt_info_t info = {.is_constant[0] = true};
-    assert(rv->X[0] == 0);
+    dispatch_init();
 
-    uint32_t i;
-    rv_insn_t *ir;
-    for (i = 0, ir = block->ir_head; i < block->n_insn; i++, ir = ir->next)
-        ((constopt_func_t) constopt_table[ir->opcode])(ir, &info);
+#if !RV32_HAS(JIT)
+    const block_map_t *map = &rv->block_map;
+    for (uint32_t i = 0; i < map->block_capacity; i++) {
+        if (map->map[i])
+            breakpoint_patch_ir(map->map[i], addr, set);
+    }
+#else
+    block_t *block;
+    list_for_each_entry (block, &rv->block_list, list)
+        breakpoint_patch_ir(block, addr, set);
+#endif
 }
+#endif /* RV32_HAS(GDBSTUB) */
 
 static block_t *prev = NULL;
+
+void rv_invalidate_blocks(riscv_t *rv)
+{
+#if !RV32_HAS(JIT)
+    block_map_clear(rv);
+#else
+    /* Blocks may be in use by the T2C thread, so they are only flagged for
+     * block_find_or_translate() to replace, and the chains into them are cut.
+     */
+#if RV32_HAS(T2C)
+    pthread_mutex_lock(&rv->cache_lock);
+#endif
+    block_t *block;
+    list_for_each_entry (block, &rv->block_list, list) {
+        block->invalidated = true;
+#if RV32_HAS(T2C)
+        ATOMIC_STORE(&block->hot2, false, ATOMIC_RELEASE);
+#endif
+        rv_insn_t *tail = block->ir_tail;
+        tail->branch_taken = tail->branch_untaken = NULL;
+        if (insn_is_indirect_branch(tail->opcode) && tail->branch_table)
+            memset(tail->branch_table, 0, sizeof(branch_history_table_t));
+    }
+    jit_flush(rv);
+#if RV32_HAS(T2C)
+    pthread_mutex_unlock(&rv->cache_lock);
+#endif
+#endif
+    prev = NULL;
+}
+
 static block_t *block_find_or_translate(riscv_t *rv)
 {
 #if !RV32_HAS(JIT)
@@ -1856,6 +2782,10 @@ static block_t *block_find_or_translate(riscv_t *rv)
     /* discard cache if satp mismatch or block was invalidated by SFENCE.VMA */
     if (next_blk && (next_blk->satp != rv->csr_satp || next_blk->invalidated))
         next_blk = NULL;
+#else
+    /* discard a block invalidated by rv_invalidate_blocks() */
+    if (next_blk && next_blk->invalidated)
+        next_blk = NULL;
 #endif
 #endif
 
@@ -1876,6 +2806,8 @@ static block_t *block_find_or_translate(riscv_t *rv)
         prev = NULL;
     }
 #endif
+    rv->pmu_event[PMU_EVENT_block_miss]++;
+
     /* allocate a new block */
     next_blk = block_alloc(rv);
     if (unlikely(!next_blk))
@@ -1890,14 +2822,25 @@ static block_t *block_find_or_translate(riscv_t *rv)
      * in "block_alloc()"
      */
     next_blk->satp = rv->csr_satp;
-    next_blk->invalidated = false;
 #endif
 
-    optimize_constant(rv, next_blk);
+#if RV32_HAS(GDBSTUB)
+    /* GDB can stop at any instruction and rewrite registers, so blocks stay
+     * unoptimized while it is attached, with its breakpoints patched in.
+     */
+    if (rv->debug_mode)
+        breakpoint_patch_block(rv, next_blk);
+    else
+#endif
+    {
+        optimize_constant(rv, next_blk);
+        propagate_copies(next_blk);
+        eliminate_dead_writes(next_blk);
 #if RV32_HAS(MOP_FUSION)
-    /* macro operation fusion */
-    match_pattern(rv, next_blk);
+        /* macro operation fusion */
+        match_pattern(rv, next_blk);
 #endif
+    }
 
 #if !RV32_HAS(JIT)
     /* insert the block into block map and L1 cache */
@@ -1939,7 +2882,7 @@ static block_t *block_find_or_translate(riscv_t *rv)
         }
 
         /* upadte JALR LUT */
-        if (!entry->ir_tail->branch_table) {
+        if (!insn_is_indirect_branch(entry->ir_tail->opcode)) {
             continue;
         }
 
@@ -1980,15 +2923,7 @@ static block_t *block_find_or_translate(riscv_t *rv)
 #endif
 
     /* free IRs in replaced block */
-    for (rv_insn_t *ir = replaced_blk->ir_head, *next_ir; ir != NULL;
-         ir = next_ir) {
-        next_ir = ir->next;
-
-        if (ir->fuse)
-            mpool_free(rv->fuse_mp, ir->fuse);
-
-        mpool_free(rv->block_ir_mp, ir);
-    }
+    block_free_ir(rv, replaced_blk);
 
 #if RV32_HAS(T2C)
     /* Clear jit_cache entry before disposing LLVM engine to prevent stale
@@ -2005,10 +2940,10 @@ static block_t *block_find_or_translate(riscv_t *rv)
         jit_cache_update(rv->jit_cache, key, NULL);
     }
     inline_cache_clear_key(rv->inline_cache, key);
-    /* Dispose LLVM execution engine before freeing the block.
-     * The engine owns the memory where block->func points.
+    /* Dispose LLVM execution engines before freeing the block.
+     * The engines own the memory where block->func points.
      */
-    t2c_dispose_engine(replaced_blk->llvm_engine);
+    t2c_dispose_block_engine(replaced_blk);
 #endif
 
     list_del_init(&replaced_blk->list);
@@ -2022,6 +2957,98 @@ static block_t *block_find_or_translate(riscv_t *rv)
     return next_blk;
 }
 
+#if !RV32_HAS(SYSTEM)
+/* instructions scanned ahead of translating a block, see block_decodable() */
+#define TRANSLATE_AHEAD_SCAN 1024
+/* pending block entries of rv_translate_ahead() */
+#define TRANSLATE_AHEAD_PENDING 64
+
+/* Whether every instruction from @pc up to the next branch decodes without
+ * leaving [@pc, @end). Translating data or an unsupported instruction would
+ * raise an illegal instruction trap, which must only happen when running.
+ */
+static bool block_decodable(riscv_t *rv, riscv_word_t pc, riscv_word_t end)
+{
+    for (uint32_t i = 0; i < TRANSLATE_AHEAD_SCAN && pc < end; i++) {
+        rv_insn_t ir;
+        memset(&ir, 0, sizeof(rv_insn_t));
+        uint32_t insn = rv->io.mem_ifetch(rv, pc);
+        if (!insn || !rv_decode(&ir, insn))
+            return false;
+        if (insn_is_branch(ir.opcode))
+            return true;
+        pc += is_compressed(insn) ? 2 : 4;
+    }
+    return false;
+}
+
+static bool block_is_cached(riscv_t *rv, riscv_word_t pc)
+{
+#if !RV32_HAS(JIT)
+    return block_find(&rv->block_map, pc);
+#else
+    return cache_get(rv->block_cache, pc, false);
+#endif
+}
+
+uint32_t rv_translate_ahead(riscv_t *rv,
+                            riscv_word_t pc,
+                            riscv_word_t end,
+                            uint32_t max_blocks)
+{
+    const riscv_word_t start = pc, saved_pc = rv->PC;
+    const uint64_t block_miss = rv->pmu_event[PMU_EVENT_block_miss];
+    riscv_word_t pending[TRANSLATE_AHEAD_PENDING];
+    uint32_t n_pending = 0, n_blocks = 0;
+
+    pending[n_pending++] = pc;
+    while (n_pending && n_blocks < max_blocks) {
+        pc = pending[--n_pending];
+        if (pc < start || pc >= end || (pc & 1) || block_is_cached(rv, pc) ||
+            !block_decodable(rv, pc, end))
+            continue;
+
+        rv->PC = pc;
+        block_t *block = block_find_or_translate(rv);
+        if (!block)
+            break;
+        n_blocks++;
+
+        /* Follow the fall-through path, which is also where calls return,
+         * and the target of a direct jump or branch.
+         */
+        const rv_insn_t *tail = block->ir_tail;
+        if (n_pending < TRANSLATE_AHEAD_PENDING)
+            pending[n_pending++] = block->pc_end;
+        switch (tail->opcode) {
+        case rv_insn_jal:
+        case rv_insn_beq:
+        case rv_insn_bne:
+        case rv_insn_blt:
+        case rv_insn_bge:
+        case rv_insn_bltu:
+        case rv_insn_bgeu:
+#if RV32_HAS(EXT_C)
+        case rv_insn_cj:
+        case rv_insn_cjal:
+        case rv_insn_cbeqz:
+        case rv_insn_cbnez:
+#endif
+            if (n_pending < TRANSLATE_AHEAD_PENDING)
+                pending[n_pending++] = tail->pc + tail->imm;
+            break;
+        default:
+            break;
+        }
+    }
+
+    /* nothing has run yet */
+    rv->PC = saved_pc;
+    rv->pmu_event[PMU_EVENT_block_miss] = block_miss;
+    return n_blocks;
+}
+#endif
+
 /* We disable profiler to make sure every guest instructions be translated by
  * JIT compiler in architecture test.
  */
@@ -2048,6 +3075,29 @@ static bool runtime_profiler(riscv_t *rv, block_t *block)
 }
 #endif
 
+#if RV32_HAS(T2C)
+/* Hand the block over to the T2C thread. Return false if the request could
+ * not be allocated.
+ */
+static bool t2c_enqueue(riscv_t *rv, const block_t *block)
+{
+    queue_entry_t *entry = malloc(sizeof(queue_entry_t));
+    if (unlikely(!entry))
+        return false;
+    /* Store cache key instead of pointer to prevent use-after-free */
+#if RV32_HAS(SYSTEM)
+    entry->key = (uint64_t) block->pc_start | ((uint64_t) block->satp << 32);
+#else
+    entry->key = (uint64_t) block->pc_start;
+#endif
+    pthread_mutex_lock(&rv->wait_queue_lock);
+    list_add(&entry->list, &rv->wait_queue);
+    pthread_cond_signal(&rv->wait_queue_cond);
+    pthread_mutex_unlock(&rv->wait_queue_lock);
+    return true;
+}
+#endif
+
 #if RV32_HAS(SYSTEM_MMIO)
 static bool rv_has_plic_trap(riscv_t *rv)
 {
@@ -2055,11 +3105,20 @@ static bool rv_has_plic_trap(riscv_t *rv)
             (rv->csr_sip & rv->csr_sie));
 }
 
+/* Interrupt delivery is event driven: the common case is a single compare
+ * against rv->next_event plus a SIP & SIE test. Device polling and the timer
+ * compare only run when their deadline has been reached; asynchronous sources
+ * (PLIC, software interrupts, CSR writes to SIE) are caught by the SIP test.
+ */
 static void rv_check_interrupt(riscv_t *rv)
 {
+    if (likely(rv->csr_cycle < rv->next_event &&
+               !(rv->csr_sip & rv->csr_sie)))
+        return;
+
     vm_attr_t *attr = PRIV(rv);
-    if (peripheral_update_ctr-- == 0) {
-        peripheral_update_ctr = 64;
+    if (rv->csr_cycle >= rv->next_poll) {
+        rv->next_poll = rv->csr_cycle + PERIPHERAL_POLL_CYCLES;
 
 #if defined(__EMSCRIPTEN__)
     escape_seq:
@@ -2082,12 +3141,27 @@ static void rv_check_interrupt(riscv_t *rv)
 
     /* Derive current timer from cycle counter for interrupt comparison.
      * Timer is no longer incremented per-instruction; instead computed here.
+     * While STIP is clear, the timer compare becomes the next event; once
+     * set, it stays set until the guest reprograms the timer through SBI,
+     * which resets next_event.
      */
-    uint64_t current_timer = rv->csr_cycle + rv->timer_offset;
-    if (current_timer > attr->timer)
+    uint64_t next_event = rv->next_poll;
+    uint64_t current_timer =
+        cycle_to_timer(rv, rv->csr_cycle) + rv->timer_offset;
+    if (current_timer > attr->timer) {
         rv->csr_sip |= RV_INT_STI;
-    else
+    } else if (attr->timer - rv->timer_offset != UINT64_MAX) {
         rv->csr_sip &= ~RV_INT_STI;
+        /* first cycle at which current_timer exceeds attr->timer */
+        uint64_t timer_due =
+            timer_to_cycle(rv, attr->timer - rv->timer_offset + 1);
+        if (timer_due < next_event)
+            next_event = timer_due;
+    } else {
+        /* a disarmed timer, e.g. sbi_set_timer(-1), never fires */
+        rv->csr_sip &= ~RV_INT_STI;
+    }
+    rv->next_event = next_event;
 
     if (rv_has_plic_trap(rv)) {
         uint32_t intr_applicable = rv->csr_sip & rv->csr_sie;
@@ -2114,6 +3188,22 @@ static void rv_check_interrupt(riscv_t *rv)
 }
 #endif
 
+/* Charge the per-block PMU events of a block that the interpreter ran up to
+ * its end. rv_step() keeps blocks out of compiled code while these events are
+ * counted.
+ */
+static inline void pmu_charge_block(riscv_t *rv, const block_t *block)
+{
+    if (likely(!rv->pmu_detailed))
+        return;
+    rv->pmu_event[PMU_EVENT_load] += block->n_load;
+    rv->pmu_event[PMU_EVENT_store] += block->n_store;
+    if (block->cond_branch) {
+        rv->pmu_event[PMU_EVENT_branch]++;
+        rv->pmu_event[PMU_EVENT_branch_taken] += rv->PC != block->pc_end;
+    }
+}
+
 void rv_step(void *arg)
 {
     assert(arg);
@@ -2122,11 +3212,14 @@ void rv_step(void *arg)
     vm_attr_t *attr = PRIV(rv);
     uint32_t cycles = attr->cycle_per_step;
 
+    dispatch_init();
+
     /* find or translate a block for starting PC */
     const uint64_t cycles_target = rv->csr_cycle + cycles;
 
-    /* loop until hitting the cycle target */
-    while (rv->csr_cycle < cycles_target && !rv->halt) {
+    /* loop until hitting the cycle target, or a GDB breakpoint or watchpoint */
+    while (rv->csr_cycle < cycles_target &&
+           !rv->halt IIF(RV32_HAS(GDBSTUB))(&&!rv->debug_stop, )) {
 #if RV32_HAS(SYSTEM_MMIO)
         /* check for any interrupt after every block emulation */
         rv_check_interrupt(rv);
@@ -2183,6 +3276,10 @@ void rv_step(void *arg)
         if (prev
 #if RV32_HAS(JIT) && RV32_HAS(SYSTEM)
             && prev->satp == rv->csr_satp && !prev->invalidated
+#endif
+#if RV32_HAS(GDBSTUB)
+            /* chained blocks would not return here to check for a stop */
+            && !rv->debug_mode
 #endif
         ) {
             rv_insn_t *last_ir = prev->ir_tail;
@@ -2210,6 +3307,14 @@ void rv_step(void *arg)
 #endif
         last_pc = rv->PC;
 #if RV32_HAS(JIT)
+#if RV32_HAS(GDBSTUB)
+        /* compiled code would run past breakpoints and watchpoints */
+        if (rv->debug_mode)
+            goto interpret;
+#endif
+        /* compiled code does not count the per-block PMU events */
+        if (unlikely(rv->pmu_detailed))
+            goto interpret;
 #if RV32_HAS(T2C)
         /* executed through the tier-2 JIT compiler */
         if (ATOMIC_LOAD(&block->hot2, ATOMIC_ACQUIRE)) {
@@ -2220,38 +3325,55 @@ void rv_step(void *arg)
             /* Ensure instruction cache coherency before executing T2C code */
             __asm__ volatile("isb" ::: "memory");
 #endif
+            /* The T2C thread replaces func when it recompiles the block, so
+             * load it once.
+             */
+            exec_t2c_func_t func =
+                (exec_t2c_func_t) ATOMIC_LOAD(&block->func, ATOMIC_ACQUIRE);
             /* Defensive NULL check - should not occur if seqlocks work
              * correctly but protects against races during block invalidation
              */
-            if (unlikely(!block->func)) {
+            if (unlikely(!func)) {
                 /* Block was invalidated, fall through to interpreter */
                 prev = NULL;
                 continue;
             }
-            ((exec_t2c_func_t) block->func)(rv);
+            const uint64_t t2c_instret = rv->csr_instret;
+            func(rv);
+            rv->pmu_event[PMU_EVENT_jit_insn] +=
+                rv->csr_instret - t2c_instret;
+            /* recompile quick-tier code that stays hot */
+            const t2c_profile_t *profile = block->t2c_profile;
+            if (unlikely(profile && !block->requeued &&
+                         ATOMIC_LOAD(&profile->heat, ATOMIC_RELAXED) >=
+                             T2C_RECOMPILE_THRESHOLD))
+                block->requeued = t2c_enqueue(rv, block);
+            /* Inline caches are private to this thread and would keep
+             * entering the quick-tier code, so drop the stale entry here
+             * once the recompiled code is installed.
+             */
+            if (unlikely(block->requeued &&
+                         ATOMIC_LOAD(&block->recompiled, ATOMIC_ACQUIRE))) {
+#if RV32_HAS(SYSTEM)
+                uint64_t key = (uint64_t) block->pc_start |
+                               ((uint64_t) block->satp << 32);
+#else
+                uint64_t key = (uint64_t) block->pc_start;
+#endif
+                inline_cache_clear_key(rv->inline_cache, key);
+                ATOMIC_STORE(&block->recompiled, false, ATOMIC_RELAXED);
+            }
             prev = NULL;
             continue;
         } /* check if invoking times of t1 generated code exceed threshold */
         else if (!ATOMIC_LOAD(&block->compiled, ATOMIC_RELAXED) &&
                  ATOMIC_LOAD(&block->n_invoke, ATOMIC_RELAXED) >= THRESHOLD) {
             ATOMIC_STORE(&block->compiled, true, ATOMIC_RELAXED);
-            queue_entry_t *entry = malloc(sizeof(queue_entry_t));
-            if (unlikely(!entry)) {
+            if (unlikely(!t2c_enqueue(rv, block))) {
                 /* Malloc failed - reset compiled flag to allow retry later */
                 ATOMIC_STORE(&block->compiled, false, ATOMIC_RELAXED);
                 continue;
             }
-            /* Store cache key instead of pointer to prevent use-after-free */
-#if RV32_HAS(SYSTEM)
-            entry->key =
-                (uint64_t) block->pc_start | ((uint64_t) block->satp << 32);
-#else
-            entry->key = (uint64_t) block->pc_start;
-#endif
-            pthread_mutex_lock(&rv->wait_queue_lock);
-            list_add(&entry->list, &rv->wait_queue);
-            pthread_cond_signal(&rv->wait_queue_cond);
-            pthread_mutex_unlock(&rv->wait_queue_lock);
         }
 #endif
         /* executed through the tier-1 JIT compiler */
@@ -2273,7 +3395,6 @@ void rv_step(void *arg)
 #endif
             ((exec_block_func_t) state->buf)(
                 rv, (uintptr_t) (state->buf + block->offset));
-            rv->csr_cycle += block->cycle_cost;
 #if RV32_HAS(SYSTEM)
             /* Handle trap if one occurred during JIT block execution */
             if (rv->is_trapped) {
@@ -2297,7 +3418,6 @@ void rv_step(void *arg)
 #endif
             ((exec_block_func_t) state->buf)(
                 rv, (uintptr_t) (state->buf + block->offset));
-            rv->csr_cycle += block->cycle_cost;
 #if RV32_HAS(SYSTEM)
             /* Handle trap if one occurred during JIT block execution */
             if (rv->is_trapped) {
@@ -2309,17 +3429,19 @@ void rv_step(void *arg)
             prev = NULL;
             continue;
         }
+    interpret:
         set_reset(&pc_set);
         has_loops = false;
 #endif
         /* execute the block by interpreter.
-         * Per-instruction cycle counting is used to support block chaining,
-         * where chained blocks bypass the outer loop and accumulate cycles
-         * via the cycle++ in each instruction handler.
+         * Chained blocks bypass the outer loop, so each block adds its
+         * own cycles and retired instruction count when it transfers control,
+         * and the totals are written back to rv->csr_cycle and
+         * rv->csr_instret when the chain stops.
          */
         const rv_insn_t *ir = block->ir_head;
-        uint64_t cycle = rv->csr_cycle;
-        if (unlikely(!ir->impl(rv, ir, cycle, rv->PC))) {
+        if (unlikely(!dispatch_ir(rv, ir, rv->csr_cycle, rv->csr_instret,
+                                  rv->PC))) {
             /* block should not be extended if exception handler invoked */
             prev = NULL;
             break;
@@ -2328,6 +3450,12 @@ void rv_step(void *arg)
         if (has_loops && !block->has_loops)
             block->has_loops = true;
 #endif
+        if (unlikely(rv->pmu_detailed)) {
+            /* the block returned without chaining, see RVOP_PMU_EXIT() */
+            pmu_charge_block(rv, block);
+            prev = NULL;
+            continue;
+        }
         prev = block;
     }
 
@@ -2348,10 +3476,14 @@ void rv_step(void *arg)
 #endif
 }
 
-void rv_step_debug(void *arg)
+bool rv_step_insn(riscv_t *rv, rv_insn_t *ir)
 {
-    assert(arg);
-    riscv_t *rv = arg;
+    dispatch_init();
+
+    /* a lone instruction never closes a block, so the chaining history kept
+     * by rv_step() no longer describes how control reached the next block.
+     */
+    prev = NULL;
 
 #if RV32_HAS(SYSTEM_MMIO)
     rv_check_interrupt(rv);
@@ -2363,10 +3495,8 @@ void rv_step_debug(void *arg)
         PRIV(rv)->on_exit = true;
 #endif
 
-    rv_insn_t ir;
-
 retranslate:
-    memset(&ir, 0, sizeof(rv_insn_t));
+    memset(ir, 0, sizeof(rv_insn_t));
 
     /* fetch the next instruction */
     uint32_t insn = rv->io.mem_ifetch(rv, rv->PC);
@@ -2386,28 +3516,71 @@ retranslate:
                "insn fetch returned 0 without setting trap state");
         trap_handler(rv);
 #endif
-        return;
+        return false;
     }
 
     /* decode the instruction */
-    if (!rv_decode(&ir, insn)) {
+    if (!rv_decode(ir, insn)) {
         rv->compressed = is_compressed(insn);
         SET_CAUSE_AND_TVAL_THEN_TRAP(rv, ILLEGAL_INSN, insn);
-        return;
+        return false;
+    }
+
+    ir->impl = dispatch_table[ir->opcode];
+    ir->pc = rv->PC;
+    ir->next = NULL;
+    ir->cycle_ofs = timing_cost(rv->timing, ir, NULL);
+    ir->insn_ofs = 1;
+    dispatch_ir(rv, ir, rv->csr_cycle, rv->csr_instret, rv->PC);
+    return true;
+}
+
+#if !RV32_HAS(SYSTEM)
+const block_t *rv_step_block(riscv_t *rv)
+{
+    dispatch_init();
+
+    /* the block returns here whatever its successor is, so rv_step() must not
+     * chain it to the previous block it ran.
+     */
+    prev = NULL;
+
+    block_t *block = block_find_or_translate(rv);
+    if (unlikely(!block)) {
+        rv_log_fatal("Failed to allocate or translate block at PC=0x%08x",
+                     rv->PC);
+        rv->halt = true;
+        return NULL;
     }
 
-    ir.impl = dispatch_table[ir.opcode];
-    ir.pc = rv->PC;
-    ir.next = NULL;
-    ir.impl(rv, &ir, rv->csr_cycle, rv->PC);
-    return;
+    /* on exit */
+    if (unlikely(block->ir_head->pc == PRIV(rv)->exit_addr))
+        PRIV(rv)->on_exit = true;
+
+    /* branch_taken and branch_untaken are only linked by rv_step(), and the
+     * indirect jumps of blocks translated in RV_RUN_HISTOGRAM mode own no
+     * branch history table, so the block stops at its last instruction.
+     */
+    if (unlikely(!dispatch_ir(rv, block->ir_head, rv->csr_cycle,
+                              rv->csr_instret, rv->PC)))
+        return NULL;
+    return block;
+}
+#endif
+
+void rv_step_debug(void *arg)
+{
+    assert(arg);
+    riscv_t *rv = arg;
+
+    rv_insn_t ir;
+    rv_step_insn(rv, &ir);
 }
 
 #if RV32_HAS(SYSTEM)
 static void __trap_handler(riscv_t *rv)
 {
-    rv_insn_t *ir = mpool_calloc(rv->block_ir_mp);
-    assert(ir);
+    rv_insn_t ir_buf = {0}, *ir = &ir_buf;
 
     /* set to false by sret implementation */
     while (rv->is_trapped && !rv_has_halted(rv)) {
@@ -2434,14 +3607,15 @@ static void __trap_handler(riscv_t *rv)
             break;
 
         rv_decode(ir, insn);
+        ir->cycle_ofs = timing_cost(rv->timing, ir, NULL);
+        ir->insn_ofs = 1;
         reloc_enable_mmu_jalr_addr = rv->PC;
 
         ir->impl = dispatch_table[ir->opcode];
         rv->compressed = is_compressed(insn);
-        ir->impl(rv, ir, rv->csr_cycle, rv->PC);
+        dispatch_ir(rv, ir, rv->csr_cycle, rv->csr_instret, rv->PC);
     }
 
-    mpool_free(rv->block_ir_mp, ir);
     prev = NULL;
 }
 #endif /* RV32_HAS(SYSTEM) */
@@ -2642,6 +3816,75 @@ void memcpy_handler(riscv_t *rv)
     rv->PC = rv->X[rv_reg_ra] & ~1U;
 }
 
+void memmove_handler(riscv_t *rv)
+{
+    memory_t *m = PRIV(rv)->mem;
+    uint32_t dest = rv->X[rv_reg_a0];
+    uint32_t src = rv->X[rv_reg_a1];
+    uint32_t count = rv->X[rv_reg_a2];
+
+    /* Bounds checking to prevent buffer overflow */
+    if (dest >= m->mem_size || count > m->mem_size - dest) {
+        SET_CAUSE_AND_TVAL_THEN_TRAP(rv, STORE_MISALIGNED, dest);
+        return;
+    }
+    if (src >= m->mem_size || count > m->mem_size - src) {
+        SET_CAUSE_AND_TVAL_THEN_TRAP(rv, LOAD_MISALIGNED, src);
+        return;
+    }
+
+    memmove((char *) m->mem_base + dest, (char *) m->mem_base + src, count);
+    rv->PC = rv->X[rv_reg_ra] & ~1U;
+}
+
+void memcmp_handler(riscv_t *rv)
+{
+    memory_t *m = PRIV(rv)->mem;
+    uint32_t s1 = rv->X[rv_reg_a0];
+    uint32_t s2 = rv->X[rv_reg_a1];
+    uint32_t count = rv->X[rv_reg_a2];
+
+    /* Bounds checking to prevent buffer overflow */
+    if (s1 >= m->mem_size || count > m->mem_size - s1) {
+        SET_CAUSE_AND_TVAL_THEN_TRAP(rv, LOAD_MISALIGNED, s1);
+        return;
+    }
+    if (s2 >= m->mem_size || count > m->mem_size - s2) {
+        SET_CAUSE_AND_TVAL_THEN_TRAP(rv, LOAD_MISALIGNED, s2);
+        return;
+    }
+
+    /* return the difference of the first mismatching bytes like newlib */
+    const uint8_t *p1 = m->mem_base + s1, *p2 = m->mem_base + s2;
+    uint32_t res = 0;
+    if (memcmp(p1, p2, count)) {
+        uint32_t i = 0;
+        while (p1[i] == p2[i])
+            i++;
+        res = (uint32_t) (p1[i] - p2[i]);
+    }
+    rv->X[rv_reg_a0] = res;
+    rv->PC = rv->X[rv_reg_ra] & ~1U;
+}
+
+void strlen_handler(riscv_t *rv)
+{
+    memory_t *m = PRIV(rv)->mem;
+    uint32_t str = rv->X[rv_reg_a0];
+
+    /* the terminator must lie within the guest memory */
+    const uint8_t *end = str < m->mem_size ? memchr(m->mem_base + str, 0,
+                                                    m->mem_size - str)
+                                           : NULL;
+    if (!end) {
+        SET_CAUSE_AND_TVAL_THEN_TRAP(rv, LOAD_MISALIGNED, str);
+        return;
+    }
+
+    rv->X[rv_reg_a0] = (uint32_t) (end - (m->mem_base + str));
+    rv->PC = rv->X[rv_reg_ra] & ~1U;
+}
+
 void dump_registers(riscv_t *rv, char *out_file_path)
 {
     FILE *f = out_file_path[0] == '-' ? stdout : fopen(out_file_path, "w");
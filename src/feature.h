@@ -134,6 +134,11 @@
 #define RV32_FEATURE_BLOCK_CHAINING 1
 #endif
 
+/* Computed-goto (direct-threaded) interpreter dispatch */
+#ifndef RV32_FEATURE_COMPUTED_GOTO
+#define RV32_FEATURE_COMPUTED_GOTO 0
+#endif
+
 /* Logging with color */
 #ifndef RV32_FEATURE_LOG_COLOR
 #define RV32_FEATURE_LOG_COLOR 1
@@ -13,8 +13,20 @@
 #include "mini-gdbstub/include/gdbstub.h"
 
 #include "breakpoint.h"
+#include "io.h"
 #include "riscv.h"
 #include "riscv_private.h"
+#if RV32_HAS(SYSTEM)
+#include "system.h"
+#endif
+
+/* types of the Z packet beyond BP_SOFTWARE in the GDB remote protocol */
+enum {
+    Z_HARDWARE_BP = 1,
+    Z_WRITE_WATCH = 2,
+    Z_READ_WATCH = 3,
+    Z_ACCESS_WATCH = 4,
+};
 
 static size_t rv_get_reg_bytes(UNUSED int regno)
 {
@@ -50,30 +62,74 @@ static int rv_write_reg(void *args, int regno, void *data)
     return 0;
 }
 
-static int rv_read_mem(void *args, size_t addr, size_t len, void *val)
+/* Translate the guest address @vaddr for the debugger. Unlike a guest
+ * access, the page walk neither raises a page fault nor sets the A and D bits.
+ * Return false if @vaddr is not mapped.
+ */
+static bool rv_translate(riscv_t *rv UNUSED, uint32_t vaddr, uint32_t *paddr)
 {
-    riscv_t *rv = (riscv_t *) args;
+#if RV32_HAS(SYSTEM)
+    if (rv->csr_satp) {
+        uint32_t level;
+        const pte_t *pte = mmu_walk(rv, vaddr, &level);
+        if (!pte)
+            return false;
+        get_ppn_and_offset();
+        *paddr = ppn | offset;
+        return true;
+    }
+#endif
+    *paddr = vaddr;
+    return true;
+}
 
-    int err = 0;
-    for (size_t i = 0; i < len; i++) {
-        /* FIXME: This is implemented as a simple workaround for reading
-         * an invalid address. We may have to do error handling in the
-         * mem_read_* function directly.
-         */
-        *((uint8_t *) val + i) = rv->io.mem_read_b(rv, addr + i);
+/* Copy between guest memory at @addr and @buf a page at a time, since each
+ * page is translated on its own. Only RAM is accessible, as reading or
+ * writing a device register may change the state of the device.
+ */
+static int rv_access_mem(riscv_t *rv,
+                         size_t addr,
+                         size_t len,
+                         uint8_t *buf,
+                         bool write)
+{
+    if ((uint64_t) addr + len > (uint64_t) UINT32_MAX + 1)
+        return EFAULT;
+
+    memory_t *mem = PRIV(rv)->mem;
+    for (size_t n; len; addr += n, buf += n, len -= n) {
+        const uint32_t vaddr = addr;
+        n = RV_PG_SIZE - (vaddr & (RV_PG_SIZE - 1));
+        if (n > len)
+            n = len;
+
+        uint32_t paddr;
+        if (!rv_translate(rv, vaddr, &paddr) ||
+            !GUEST_RAM_CONTAINS(mem, paddr, n))
+            return EFAULT;
+
+        if (write)
+            memory_write(mem, paddr, buf, n);
+        else
+            memory_read(mem, buf, paddr, n);
     }
 
-    return err;
+    return 0;
+}
+
+static int rv_read_mem(void *args, size_t addr, size_t len, void *val)
+{
+    return rv_access_mem((riscv_t *) args, addr, len, val, false);
 }
 
 static int rv_write_mem(void *args, size_t addr, size_t len, void *val)
 {
     riscv_t *rv = (riscv_t *) args;
-
-    for (size_t i = 0; i < len; i++)
-        rv->io.mem_write_b(rv, addr + i, *((uint8_t *) val + i));
-
-    return 0;
+    const int err = rv_access_mem(rv, addr, len, val, true);
+    /* the write may patch code that was already translated */
+    if (!err)
+        rv_invalidate_blocks(rv);
+    return err;
 }
 
 static inline bool rv_is_interrupt(riscv_t *rv)
@@ -86,12 +142,12 @@ static gdb_action_t rv_cont(void *args)
     riscv_t *rv = (riscv_t *) args;
     assert(rv);
 
-    for (; !rv_has_halted(rv) && !rv_is_interrupt(rv);) {
-        if (breakpoint_map_find(rv->breakpoint_map, rv_get_pc(rv)))
-            break;
-
-        rv_step_debug(rv);
-    }
+    /* Blocks run at full interpreter speed until the handler of a breakpoint
+     * or an access to a watchpoint sets debug_stop.
+     */
+    while (!rv_has_halted(rv) && !rv_is_interrupt(rv) && !rv->debug_stop)
+        rv_step(rv);
+    rv->debug_stop = false;
 
     /* Clear the interrupt if it's pending */
     ATOMIC_STORE(&rv->is_interrupted, false, ATOMIC_RELAXED);
@@ -104,27 +160,79 @@ static gdb_action_t rv_stepi(void *args)
     riscv_t *rv = (riscv_t *) args;
     assert(rv);
 
+    /* the instruction is stepped on its own, past any breakpoint patched
+     * over it, and stops anyway after an access to a watchpoint
+     */
     rv_step_debug(rv);
+    rv->debug_stop = false;
     return ACT_RESUME;
 }
 
+/* the watchpoint accesses of a Z packet type, or 0 for a breakpoint */
+static uint8_t rv_watch_access(bp_type_t type)
+{
+    switch ((int) type) {
+    case Z_WRITE_WATCH:
+        return WATCH_WRITE;
+    case Z_READ_WATCH:
+        return WATCH_READ;
+    case Z_ACCESS_WATCH:
+        return WATCH_READ | WATCH_WRITE;
+    default:
+        return 0;
+    }
+}
+
 static bool rv_set_bp(void *args, size_t addr, bp_type_t type)
 {
     riscv_t *rv = (riscv_t *) args;
-    if (type != BP_SOFTWARE)
+
+    /* The length of a watchpoint is not passed on, so it covers the aligned
+     * word at addr, which is what a variable of int or pointer type takes.
+     */
+    const uint8_t access = rv_watch_access(type);
+    if (access) {
+        if (rv->n_watchpoints == N_WATCHPOINTS)
+            return false;
+        rv->watchpoints[rv->n_watchpoints++] = (watchpoint_t) {
+            .addr = addr & ~3U,
+            .access = access,
+        };
+        return true;
+    }
+
+    /* hardware breakpoints are no different to an emulator */
+    if ((int) type != BP_SOFTWARE && (int) type != Z_HARDWARE_BP)
         return false;
 
-    return breakpoint_map_insert(rv->breakpoint_map, addr);
+    if (!breakpoint_map_insert(rv->breakpoint_map, addr))
+        return false;
+    breakpoint_patch(rv, addr, true);
+    return true;
 }
 
 static bool rv_del_bp(void *args, size_t addr, bp_type_t type)
 {
     riscv_t *rv = (riscv_t *) args;
-    if (type != BP_SOFTWARE)
+
+    const uint8_t access = rv_watch_access(type);
+    if (access) {
+        for (uint32_t i = 0; i < rv->n_watchpoints; i++) {
+            watchpoint_t *wp = &rv->watchpoints[i];
+            if (wp->addr == (addr & ~3U) && wp->access == access) {
+                *wp = rv->watchpoints[--rv->n_watchpoints];
+                break;
+            }
+        }
+        return true;
+    }
+
+    if ((int) type != BP_SOFTWARE && (int) type != Z_HARDWARE_BP)
         return false;
 
     /* When there is no matched breakpoint, no further action is taken */
-    breakpoint_map_del(rv->breakpoint_map, addr);
+    if (breakpoint_map_del(rv->breakpoint_map, addr))
+        breakpoint_patch(rv, addr, false);
     return true;
 }
 
@@ -16,6 +16,17 @@
 #include <stdatomic.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#include <time.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #endif
 
 #include "io.h"
@@ -35,21 +46,74 @@ static uint64_t data_memory_size;
  * This provides automatic memory growth with minimal initial footprint.
  */
 
-/* Chunk size: 64KB provides good balance between granularity and overhead */
-#define CHUNK_SHIFT 16
-#define CHUNK_SIZE (1UL << CHUNK_SHIFT)
+/* Chunk size, see MEM_CHUNK_SHIFT in io.h */
+#define CHUNK_SHIFT MEM_CHUNK_SHIFT
+#define CHUNK_SIZE MEM_CHUNK_SIZE
 #define CHUNK_MASK (~(CHUNK_SIZE - 1))
 
 /* Maximum chunks for 4GB address space: 4GB / 64KB = 65536 */
 #define MAX_CHUNKS (0x100000000ULL >> CHUNK_SHIFT)
-#define BITMAP_SIZE (MAX_CHUNKS / 8)
+#define BITMAP_SIZE MEM_BITMAP_SIZE
 
-/* Bitmap tracking which chunks are activated */
+/* Bitmap tracking which chunks are activated. Bits are updated with atomic
+ * read-modify-write since the fault handler and a GC running on another
+ * thread may touch neighboring chunks sharing a byte.
+ */
 static uint8_t chunk_bitmap[BITMAP_SIZE];
 
-/* GC state: circular scan index */
+/* Bitmap of activated chunks the GC found holding data and left read-only.
+ * They cannot have changed since, so the GC skips them until a guest write
+ * faults, makes the chunk writable again and clears its bit.
+ */
+static uint8_t chunk_clean[BITMAP_SIZE];
+
+/* GC state: circular scan index, only used by the GC itself */
 static uint32_t gc_scan_idx;
 
+/* GC sweep generation, incremented every time the scan index wraps around.
+ * The fault handler stamps each chunk with the generation of its latest
+ * activation or write; chunks written during the current sweep are still in
+ * use and are skipped until the next one. Both are accessed atomically, as
+ * the handler and the GC may run on different threads.
+ */
+static uint8_t gc_epoch;
+static uint8_t chunk_epoch[MAX_CHUNKS];
+
+/* Chunk whose protection is being changed, by the fault handler or by the
+ * GC, or GC_NO_FENCE. Each side takes the chunk first, so a guest write
+ * cannot make a chunk writable while the GC decides whether to reclaim it.
+ */
+#define GC_NO_FENCE UINT32_MAX
+static atomic_uint_fast32_t gc_fence_idx = GC_NO_FENCE;
+
+/* Background GC thread, see memory_gc_start(). gc_lock serializes its sweeps
+ * with memory_save(), memory_restore() and memory_delete().
+ */
+static pthread_t gc_thread;
+static bool gc_thread_running;
+static bool gc_thread_stop;
+static uint32_t gc_interval_ms;
+static pthread_mutex_t gc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gc_wake = PTHREAD_COND_INITIALIZER;
+static void memory_gc_stop(void);
+
+/* Number of activated chunks examined per memory_gc() call */
+#define GC_SCAN_BUDGET 8
+
+/* Set once guest RAM is a private mapping of a snapshot file. Releasing
+ * pages with MADV_DONTNEED would then expose the file contents again
+ * instead of zeros, so reclaimed chunks are replaced with anonymous memory.
+ */
+static bool memory_file_backed;
+
+/* How guest RAM is backed, see memory_backing_t */
+static memory_backing_t memory_backing;
+
+/* Length of the host mapping, rounded up to the huge page size for
+ * MEM_BACKING_HUGETLB.
+ */
+static uint64_t data_memory_map_size;
+
 /* Statistics: current and peak number of activated chunks (atomic for signal
  * safety) */
 static atomic_uint_fast32_t active_chunks;
@@ -61,25 +125,97 @@ static struct sigaction prev_sigbus_handler;
 
 static inline bool bitmap_test(uint32_t idx)
 {
-    return (chunk_bitmap[idx >> 3] & (1 << (idx & 7))) != 0;
+    return (ATOMIC_LOAD(&chunk_bitmap[idx >> 3], ATOMIC_RELAXED) &
+            (1 << (idx & 7))) != 0;
 }
 
 static inline void bitmap_set(uint32_t idx)
 {
-    chunk_bitmap[idx >> 3] |= (1 << (idx & 7));
+    ATOMIC_FETCH_OR(&chunk_bitmap[idx >> 3], (uint8_t) (1 << (idx & 7)),
+                    ATOMIC_RELAXED);
 }
 
 static inline void bitmap_clear(uint32_t idx)
 {
-    chunk_bitmap[idx >> 3] &= ~(1 << (idx & 7));
+    ATOMIC_FETCH_AND(&chunk_bitmap[idx >> 3], (uint8_t) ~(1 << (idx & 7)),
+                     ATOMIC_RELAXED);
+}
+
+static inline bool clean_test(uint32_t idx)
+{
+    return (ATOMIC_LOAD(&chunk_clean[idx >> 3], ATOMIC_RELAXED) &
+            (1 << (idx & 7))) != 0;
+}
+
+static inline void clean_set(uint32_t idx)
+{
+    ATOMIC_FETCH_OR(&chunk_clean[idx >> 3], (uint8_t) (1 << (idx & 7)),
+                    ATOMIC_RELAXED);
+}
+
+static inline void clean_clear(uint32_t idx)
+{
+    ATOMIC_FETCH_AND(&chunk_clean[idx >> 3], (uint8_t) ~(1 << (idx & 7)),
+                     ATOMIC_RELAXED);
+}
+
+/* take the chunk @idx for a protection change, see gc_fence_idx */
+static inline bool fence_try_take(uint32_t idx)
+{
+    uint_fast32_t unowned = GC_NO_FENCE;
+    return atomic_compare_exchange_strong_explicit(
+        &gc_fence_idx, &unowned, idx, memory_order_acquire,
+        memory_order_relaxed);
+}
+
+static inline void fence_release(void)
+{
+    atomic_store_explicit(&gc_fence_idx, GC_NO_FENCE, memory_order_release);
 }
 
 /* Check if a memory region is all zeros (for reclaim decision).
- * Uses byte-wise scan to avoid alignment issues with word-sized access.
- * Compiler may optimize this to SIMD operations where available.
+ * Chunks are OR-reduced 64 bytes at a time with SIMD where available, so a
+ * non-zero chunk is usually rejected within its first cache line, and a zero
+ * chunk is confirmed at memory bandwidth. Unaligned loads keep it correct for
+ * the partial last chunk.
  */
 static bool is_region_zero(const uint8_t *ptr, size_t size)
 {
+#if defined(__AVX2__)
+    for (; size >= 64; ptr += 64, size -= 64) {
+        __m256i v =
+            _mm256_or_si256(_mm256_loadu_si256((const __m256i *) ptr),
+                            _mm256_loadu_si256((const __m256i *) (ptr + 32)));
+        if (!_mm256_testz_si256(v, v))
+            return false;
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; size >= 64; ptr += 64, size -= 64) {
+        __m128i v = _mm_or_si128(
+            _mm_or_si128(_mm_loadu_si128((const __m128i *) ptr),
+                         _mm_loadu_si128((const __m128i *) (ptr + 16))),
+            _mm_or_si128(_mm_loadu_si128((const __m128i *) (ptr + 32)),
+                         _mm_loadu_si128((const __m128i *) (ptr + 48))));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xFFFF)
+            return false;
+    }
+#elif defined(__ARM_NEON)
+    for (; size >= 64; ptr += 64, size -= 64) {
+        uint8x16_t v = vorrq_u8(vorrq_u8(vld1q_u8(ptr), vld1q_u8(ptr + 16)),
+                                vorrq_u8(vld1q_u8(ptr + 32), vld1q_u8(ptr + 48)));
+        uint64x2_t w = vreinterpretq_u64_u8(v);
+        if (vgetq_lane_u64(w, 0) | vgetq_lane_u64(w, 1))
+            return false;
+    }
+#else
+    for (; size >= 64; ptr += 64, size -= 64) {
+        uint64_t w[8];
+        memcpy(w, ptr, sizeof(w));
+        if (w[0] | w[1] | w[2] | w[3] | w[4] | w[5] | w[6] | w[7])
+            return false;
+    }
+#endif
     for (size_t i = 0; i < size; i++) {
         if (ptr[i] != 0)
             return false;
@@ -116,11 +252,24 @@ static void memory_fault_handler(int sig, siginfo_t *si, void *context UNUSED)
             chunk_len = end - chunk_start;
         }
 
+        /* Wait while a GC on another thread decides whether to reclaim this
+         * chunk. Once it is done, the chunk is either still active or
+         * released, and both cases are handled below.
+         */
+        while (!fence_try_take(chunk_idx))
+            ;
+
         /* Activate the chunk with read/write permissions */
-        if (mprotect((void *) chunk_start, chunk_len, PROT_READ | PROT_WRITE) ==
-            0) {
-            /* Only count if not already active (handles re-fault edge cases) */
-            if (!bitmap_test(chunk_idx)) {
+        bool handled = mprotect((void *) chunk_start, chunk_len,
+                                PROT_READ | PROT_WRITE) == 0;
+        if (handled) {
+            ATOMIC_STORE(&chunk_epoch[chunk_idx],
+                         ATOMIC_LOAD(&gc_epoch, ATOMIC_RELAXED),
+                         ATOMIC_RELAXED);
+            if (bitmap_test(chunk_idx)) {
+                /* a write to a chunk the GC left read-only */
+                clean_clear(chunk_idx);
+            } else {
                 bitmap_set(chunk_idx);
                 uint_fast32_t current =
                     atomic_fetch_add_explicit(&active_chunks, 1,
@@ -135,8 +284,10 @@ static void memory_fault_handler(int sig, siginfo_t *si, void *context UNUSED)
                         break;
                 }
             }
-            return; /* Resume execution */
         }
+        fence_release();
+        if (handled)
+            return; /* Resume execution */
     }
 
     /* Not our fault or mprotect failed - chain to previous handler */
@@ -187,7 +338,86 @@ static void restore_signal_handlers(void)
 }
 #endif /* HAVE_MMAP */
 
+#if HAVE_MMAP
+#if defined(__linux__)
+/* Prefer the NUMA node the calling (hart) thread runs on for guest RAM.
+ * Raw syscalls avoid a dependency on libnuma; failures are harmless since the
+ * policy is only a preference.
+ */
+static void memory_bind_local_node(void *addr, size_t len)
+{
+#if defined(SYS_getcpu) && defined(SYS_mbind)
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= 64)
+        return;
+    unsigned long nodemask = 1UL << node;
+    const int mpol_preferred = 1; /* MPOL_PREFERRED */
+    syscall(SYS_mbind, addr, len, mpol_preferred, &nodemask,
+            sizeof(nodemask) * 8, 0);
+#else
+    (void) addr;
+    (void) len;
+#endif
+}
+#endif
+
+/* Fault in the whole mapping now, so the guest never takes a fault later */
+static void memory_populate(uint8_t *base, size_t len)
+{
+#if defined(MADV_POPULATE_WRITE)
+    if (madvise(base, len, MADV_POPULATE_WRITE) == 0)
+        return;
+#endif
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t off = 0; off < len; off += page)
+        ((volatile uint8_t *) base)[off] = 0;
+}
+
+/* Map guest RAM with every page present: no SIGSEGV round-trips on first
+ * touch, and huge pages to cut host TLB misses. Returns MAP_FAILED on error.
+ */
+static uint8_t *memory_map_prefault(uint64_t size, memory_backing_t backing)
+{
+    uint64_t map_size = size;
+    int flags = MAP_ANONYMOUS | MAP_PRIVATE;
+#if defined(MAP_HUGETLB)
+    if (backing == MEM_BACKING_HUGETLB) {
+        /* default huge page size, explicit pages must be reserved by the
+         * administrator (vm.nr_hugepages)
+         */
+        const uint64_t huge_size = 2UL << 20;
+        map_size = (size + huge_size - 1) & ~(huge_size - 1);
+        flags |= MAP_HUGETLB;
+    }
+#else
+    if (backing == MEM_BACKING_HUGETLB)
+        return MAP_FAILED;
+#endif
+
+    uint8_t *base = mmap(NULL, map_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (base == MAP_FAILED)
+        return MAP_FAILED;
+
+#if defined(MADV_HUGEPAGE)
+    if (backing == MEM_BACKING_PREFAULT)
+        madvise(base, map_size, MADV_HUGEPAGE);
+#endif
+#if defined(__linux__)
+    memory_bind_local_node(base, map_size);
+#endif
+    memory_populate(base, map_size);
+
+    data_memory_map_size = map_size;
+    return base;
+}
+#endif /* HAVE_MMAP */
+
 memory_t *memory_new(uint64_t size)
+{
+    return memory_new_backed(size, MEM_BACKING_DEMAND);
+}
+
+memory_t *memory_new_backed(uint64_t size, memory_backing_t backing)
 {
     if (!size)
         return NULL;
@@ -203,6 +433,39 @@ memory_t *memory_new(uint64_t size)
         return NULL;
 
 #if HAVE_MMAP
+    memset(chunk_bitmap, 0, sizeof(chunk_bitmap));
+    memset(chunk_clean, 0, sizeof(chunk_clean));
+    gc_scan_idx = 0;
+    gc_epoch = 0;
+    memset(chunk_epoch, 0, sizeof(chunk_epoch));
+    memory_file_backed = false;
+    memory_backing = backing;
+    atomic_store_explicit(&active_chunks, 0, memory_order_relaxed);
+    atomic_store_explicit(&peak_chunks, 0, memory_order_relaxed);
+
+    if (backing != MEM_BACKING_DEMAND) {
+        data_memory_base = memory_map_prefault(size, backing);
+        if (data_memory_base == MAP_FAILED) {
+            rv_log_warn("Failed to map %s guest memory",
+                         backing == MEM_BACKING_HUGETLB ? "hugetlb"
+                                                        : "prefaulted");
+            free(mem);
+            return NULL;
+        }
+        data_memory_size = size;
+
+        /* every chunk is present for the lifetime of the mapping */
+        uint32_t nr_chunks = (size + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+        for (uint32_t idx = 0; idx < nr_chunks; idx++)
+            bitmap_set(idx);
+        atomic_store_explicit(&active_chunks, nr_chunks, memory_order_relaxed);
+        atomic_store_explicit(&peak_chunks, nr_chunks, memory_order_relaxed);
+
+        mem->mem_base = data_memory_base;
+        mem->mem_size = data_memory_size;
+        return mem;
+    }
+
     /* Install signal handlers for demand paging */
     if (!install_signal_handlers()) {
         free(mem);
@@ -225,16 +488,14 @@ memory_t *memory_new(uint64_t size)
     }
 
     data_memory_size = size;
-    memset(chunk_bitmap, 0, sizeof(chunk_bitmap));
-    gc_scan_idx = 0;
-    atomic_store_explicit(&active_chunks, 0, memory_order_relaxed);
-    atomic_store_explicit(&peak_chunks, 0, memory_order_relaxed);
+    data_memory_map_size = size;
 #else
     /* Fallback for systems without mmap (e.g., Windows, Emscripten).
      * Cannot use demand paging - physical memory is allocated upfront.
      * Limit to 512MB to avoid excessive memory consumption.
      * Build with HAVE_MMAP=1 for larger address spaces.
      */
+    (void) backing;
 #define MALLOC_MAX_SIZE (512UL * 1024 * 1024) /* 512 MB */
     if (size > MALLOC_MAX_SIZE) {
         free(mem);
@@ -259,9 +520,12 @@ memory_t *memory_new(uint64_t size)
 void memory_delete(memory_t *mem)
 {
 #if HAVE_MMAP
+    memory_gc_stop();
+
     /* Restore handlers first to prevent use-after-free in signal handler */
-    restore_signal_handlers();
-    munmap(mem->mem_base, mem->mem_size);
+    if (memory_backing == MEM_BACKING_DEMAND)
+        restore_signal_handlers();
+    munmap(mem->mem_base, data_memory_map_size);
 #else
     free(mem->mem_base);
 #endif
@@ -286,70 +550,322 @@ uint64_t memory_get_usage(void)
 #endif
 }
 
-/* Incremental garbage collection - scans one chunk per call.
- * Reclaims zeroed chunks by releasing physical pages (madvise)
- * and re-arming the fault handler (mprotect PROT_NONE).
+#if HAVE_MMAP
+/* Examine one activated chunk: release it if it only holds zeros, or leave it
+ * read-only so that the next guest write to it is noticed. Returns true if it
+ * was released.
  */
-void memory_gc(void)
+static bool gc_reclaim_chunk(uint32_t idx)
 {
-#if HAVE_MMAP
-    uint32_t idx = gc_scan_idx;
+    uint8_t *chunk_ptr = data_memory_base + ((uintptr_t) idx << CHUNK_SHIFT);
+
+    /* Calculate chunk size (may be partial for last chunk) */
+    size_t chunk_len = CHUNK_SIZE;
+    uintptr_t chunk_end = (uintptr_t) chunk_ptr + CHUNK_SIZE;
+    uintptr_t mem_end = (uintptr_t) data_memory_base + data_memory_size;
+    if (chunk_end > mem_end)
+        chunk_len = mem_end - (uintptr_t) chunk_ptr;
+
+    /* the fault handler is activating the chunk, which is in use then */
+    if (!fence_try_take(idx))
+        return false;
+
+    /* Write-protect the chunk before scanning it: a racing guest write
+     * faults and waits in the handler until the chunk is dealt with, so the
+     * scan stays valid. Almost every chunk holds data and fails within its
+     * first cache line; it then stays read-only until it is written again.
+     */
+    bool reclaimed = false;
+    if (mprotect(chunk_ptr, chunk_len, PROT_READ) != 0) {
+        /* leave the chunk as it is */
+    } else if (!is_region_zero(chunk_ptr, chunk_len)) {
+        clean_set(idx);
+    } else if (mprotect(chunk_ptr, chunk_len, PROT_NONE) == 0) {
+        /* Release physical pages back to OS (advisory) */
+        if (memory_file_backed)
+            mmap(chunk_ptr, chunk_len, PROT_NONE,
+                 MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, -1,
+                 0);
+        else
+            madvise(chunk_ptr, chunk_len, MADV_DONTNEED);
+        bitmap_clear(idx);
+        uint_fast32_t current =
+            atomic_load_explicit(&active_chunks, memory_order_relaxed);
+        if (current > 0)
+            atomic_fetch_sub_explicit(&active_chunks, 1, memory_order_relaxed);
+        reclaimed = true;
+    } else {
+        mprotect(chunk_ptr, chunk_len, PROT_READ | PROT_WRITE);
+    }
+
+    fence_release();
+    return reclaimed;
+}
 
+/* Examine up to GC_SCAN_BUDGET activated chunks, skipping eight at a time
+ * where none is both active and possibly written since its last scan.
+ */
+static void gc_sweep(void)
+{
     /* Only process chunks within our actual memory size */
     uint32_t max_idx = (data_memory_size + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
     if (max_idx > MAX_CHUNKS)
         max_idx = MAX_CHUNKS;
 
-    if (idx >= max_idx) {
-        gc_scan_idx = 0;
+    const uint8_t epoch = ATOMIC_LOAD(&gc_epoch, ATOMIC_RELAXED);
+    uint32_t idx = gc_scan_idx;
+    for (int budget = GC_SCAN_BUDGET; budget > 0;) {
+        if (idx >= max_idx) {
+            /* sweep complete, start the next generation */
+            idx = 0;
+            ATOMIC_STORE(&gc_epoch, (uint8_t) (epoch + 1), ATOMIC_RELAXED);
+            break;
+        }
+
+        if (!(idx & 7) &&
+            !(ATOMIC_LOAD(&chunk_bitmap[idx >> 3], ATOMIC_RELAXED) &
+              ~ATOMIC_LOAD(&chunk_clean[idx >> 3], ATOMIC_RELAXED))) {
+            idx += 8;
+            continue;
+        }
+
+        if (bitmap_test(idx) && !clean_test(idx) &&
+            ATOMIC_LOAD(&chunk_epoch[idx], ATOMIC_RELAXED) != epoch) {
+            gc_reclaim_chunk(idx);
+            budget--;
+        }
+        idx++;
+    }
+    gc_scan_idx = idx;
+}
+
+static void *gc_thread_main(void *arg UNUSED)
+{
+    pthread_mutex_lock(&gc_lock);
+    while (!gc_thread_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += gc_interval_ms / 1000;
+        deadline.tv_nsec += (long) (gc_interval_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&gc_wake, &gc_lock, &deadline);
+        if (!gc_thread_stop)
+            gc_sweep();
+    }
+    pthread_mutex_unlock(&gc_lock);
+    return NULL;
+}
+
+static void memory_gc_stop(void)
+{
+    if (!gc_thread_running)
         return;
+
+    pthread_mutex_lock(&gc_lock);
+    gc_thread_stop = true;
+    pthread_cond_signal(&gc_wake);
+    pthread_mutex_unlock(&gc_lock);
+    pthread_join(gc_thread, NULL);
+    gc_thread_running = false;
+}
+#endif
+
+/* Incremental garbage collection - examines up to GC_SCAN_BUDGET activated
+ * chunks per call. Reclaims zeroed chunks by releasing physical pages
+ * (madvise) and re-arming the fault handler (mprotect PROT_NONE).
+ *
+ * Chunks are write-protected while they are examined, and the fault handler
+ * takes a chunk before changing its protection, so no signal masking is
+ * needed. Once memory_gc_start() has moved the GC to its own thread, calls
+ * from the emulation loop do nothing.
+ */
+void memory_gc(void)
+{
+#if HAVE_MMAP
+    /* prefaulted RAM stays resident, reclaiming would split huge pages */
+    if (memory_backing != MEM_BACKING_DEMAND || gc_thread_running)
+        return;
+
+    gc_sweep();
+#endif
+}
+
+bool memory_gc_start(uint32_t interval_ms)
+{
+#if HAVE_MMAP
+    if (memory_backing != MEM_BACKING_DEMAND || gc_thread_running ||
+        !interval_ms)
+        return false;
+
+    gc_interval_ms = interval_ms;
+    gc_thread_stop = false;
+
+    /* asynchronous signals are meant for the thread running the guest */
+    sigset_t mask, old_mask;
+    sigfillset(&mask);
+    sigdelset(&mask, SIGSEGV);
+    sigdelset(&mask, SIGBUS);
+    pthread_sigmask(SIG_SETMASK, &mask, &old_mask);
+    gc_thread_running = !pthread_create(&gc_thread, NULL, gc_thread_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    return gc_thread_running;
+#else
+    (void) interval_ms;
+    return false;
+#endif
+}
+
+#if HAVE_MMAP
+/* Snapshot image layout, starting at a MEM_IMAGE_ALIGN-aligned file offset:
+ *   [0, BITMAP_SIZE)                            chunk activation bitmap
+ *   [MEM_IMAGE_ALIGN, MEM_IMAGE_ALIGN + size)   guest RAM
+ *
+ * Only activated chunks holding data are written; the others are left as
+ * file holes, so the image stays sparse. The RAM image starts on a 64 KiB
+ * boundary, a multiple of any host page size, so that it can be mapped
+ * directly on restore.
+ */
+#define MEM_IMAGE_ALIGN 0x10000
+
+static bool pwrite_full(int fd, const uint8_t *buf, size_t len, off_t off)
+{
+    while (len) {
+        ssize_t n = pwrite(fd, buf, len, off);
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+        off += n;
     }
+    return true;
+}
 
-    /* Block signals during bitmap operations to prevent races with handler */
-    sigset_t block_set, old_set;
-    sigemptyset(&block_set);
-    sigaddset(&block_set, SIGSEGV);
-    sigaddset(&block_set, SIGBUS);
-    sigprocmask(SIG_BLOCK, &block_set, &old_set);
+static bool pread_full(int fd, uint8_t *buf, size_t len, off_t off)
+{
+    while (len) {
+        ssize_t n = pread(fd, buf, len, off);
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+        off += n;
+    }
+    return true;
+}
 
-    /* Check if this chunk is activated */
-    if (bitmap_test(idx)) {
-        uint8_t *chunk_ptr =
-            data_memory_base + ((uintptr_t) idx << CHUNK_SHIFT);
+static bool memory_save_image(const memory_t *mem, int fd, uint64_t offset)
+{
+    if (!pwrite_full(fd, chunk_bitmap, BITMAP_SIZE, offset))
+        return false;
 
-        /* Calculate chunk size (may be partial for last chunk) */
+    const uint64_t ram_offset = offset + MEM_IMAGE_ALIGN;
+    const uint32_t max_idx = (mem->mem_size + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+    for (uint32_t idx = 0; idx < max_idx; idx++) {
+        if (!bitmap_test(idx))
+            continue;
+
+        uint64_t chunk_off = (uint64_t) idx << CHUNK_SHIFT;
         size_t chunk_len = CHUNK_SIZE;
-        uintptr_t chunk_end = (uintptr_t) chunk_ptr + CHUNK_SIZE;
-        uintptr_t mem_end = (uintptr_t) data_memory_base + data_memory_size;
-        if (chunk_end > mem_end)
-            chunk_len = mem_end - (uintptr_t) chunk_ptr;
-
-        /* Reclaim if chunk is all zeros */
-        if (is_region_zero(chunk_ptr, chunk_len)) {
-            /* Protect first to prevent races where chunk gets dirtied
-             * between madvise and mprotect. Only proceed if successful.
-             */
-            if (mprotect(chunk_ptr, chunk_len, PROT_NONE) == 0) {
-                /* Release physical pages back to OS (advisory) */
-                madvise(chunk_ptr, chunk_len, MADV_DONTNEED);
-                bitmap_clear(idx);
-                uint_fast32_t current =
-                    atomic_load_explicit(&active_chunks, memory_order_relaxed);
-                if (current > 0)
-                    atomic_fetch_sub_explicit(&active_chunks, 1,
-                                              memory_order_relaxed);
-            }
+        if (chunk_off + CHUNK_SIZE > mem->mem_size)
+            chunk_len = mem->mem_size - chunk_off;
+        if (is_region_zero(mem->mem_base + chunk_off, chunk_len))
+            continue;
+        if (!pwrite_full(fd, mem->mem_base + chunk_off, chunk_len,
+                         ram_offset + chunk_off))
+            return false;
+    }
+
+    /* extend the file over trailing untouched chunks */
+    return ftruncate(fd, ram_offset + mem->mem_size) == 0;
+}
+
+static bool memory_restore_image(memory_t *mem, int fd, uint64_t offset)
+{
+    uint8_t bitmap[BITMAP_SIZE];
+    if (pread(fd, bitmap, BITMAP_SIZE, offset) != BITMAP_SIZE)
+        return false;
+
+    /* Prefaulted RAM is copied into instead: a file mapping would replace
+     * its huge pages with small ones, and hugetlb RAM cannot be mapped over
+     * unless its size is a multiple of the huge page size. Every chunk of it
+     * stays active, whatever the bitmap says.
+     */
+    if (memory_backing != MEM_BACKING_DEMAND)
+        return pread_full(fd, mem->mem_base, mem->mem_size,
+                          offset + MEM_IMAGE_ALIGN);
+
+    /* Map the saved image copy-on-write over guest RAM: pages are read in
+     * from the file only when the guest touches them, and guest writes go to
+     * private anonymous pages, leaving the snapshot intact for other runs.
+     */
+    void *base = mmap(mem->mem_base, mem->mem_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, fd,
+                      offset + MEM_IMAGE_ALIGN);
+    if (base == MAP_FAILED)
+        return false;
+
+    memcpy(chunk_bitmap, bitmap, BITMAP_SIZE);
+    memset(chunk_clean, 0, sizeof(chunk_clean));
+    memset(chunk_epoch, 0, sizeof(chunk_epoch));
+    memory_file_backed = true;
+    gc_scan_idx = 0;
+    gc_epoch = 0;
+
+    /* Chunks inactive at save time go back to demand paging, coalescing
+     * adjacent ones into a single mprotect() call.
+     */
+    const uint32_t max_idx = (mem->mem_size + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+    uint32_t active = 0;
+    for (uint32_t idx = 0; idx < max_idx;) {
+        if (bitmap_test(idx)) {
+            active++;
+            idx++;
+            continue;
         }
+
+        uint32_t end = idx + 1;
+        while (end < max_idx && !bitmap_test(end))
+            end++;
+
+        uint64_t start_off = (uint64_t) idx << CHUNK_SHIFT;
+        uint64_t end_off = (uint64_t) end << CHUNK_SHIFT;
+        if (end_off > mem->mem_size)
+            end_off = mem->mem_size;
+        mprotect(mem->mem_base + start_off, end_off - start_off, PROT_NONE);
+        idx = end;
     }
+    atomic_store_explicit(&active_chunks, active, memory_order_relaxed);
+    atomic_store_explicit(&peak_chunks, active, memory_order_relaxed);
+    return true;
+}
 
-    /* Restore signal mask */
-    sigprocmask(SIG_SETMASK, &old_set, NULL);
+/* a background GC must not release chunks while they are saved or mapped */
+bool memory_save(const memory_t *mem, int fd, uint64_t offset)
+{
+    if (offset & (MEM_IMAGE_ALIGN - 1))
+        return false;
 
-    /* Advance to next chunk (circular) */
-    gc_scan_idx = (idx + 1) % max_idx;
-#endif
+    pthread_mutex_lock(&gc_lock);
+    bool saved = memory_save_image(mem, fd, offset);
+    pthread_mutex_unlock(&gc_lock);
+    return saved;
 }
 
+bool memory_restore(memory_t *mem, int fd, uint64_t offset)
+{
+    if (offset & (MEM_IMAGE_ALIGN - 1))
+        return false;
+
+    pthread_mutex_lock(&gc_lock);
+    bool restored = memory_restore_image(mem, fd, offset);
+    pthread_mutex_unlock(&gc_lock);
+    return restored;
+}
+#endif /* HAVE_MMAP */
+
 /*
  * Fast memory access functions - no bounds checking for performance.
  * Callers must validate addresses. With MMAP, out-of-bounds access
@@ -22,21 +22,70 @@ typedef struct {
     ((uint64_t) (addr) < (mem)->mem_size && \
      (uint64_t) (size) <= (mem)->mem_size - (uint64_t) (addr))
 
+/* Guest RAM is faulted in, reclaimed and saved in chunks of
+ * 1 << MEM_CHUNK_SHIFT bytes. 64 KiB provides a good balance between
+ * granularity and overhead; 21 (2 MiB) lets the host back each chunk with one
+ * huge page.
+ */
+#ifndef MEM_CHUNK_SHIFT
+#define MEM_CHUNK_SHIFT 16
+#endif
+#if MEM_CHUNK_SHIFT < 16 || MEM_CHUNK_SHIFT > 21
+#error "MEM_CHUNK_SHIFT must be within [16, 21]"
+#endif
+#define MEM_CHUNK_SIZE (1UL << MEM_CHUNK_SHIFT)
+
+/* bytes of the chunk bitmap that a saved RAM image starts with, one bit per
+ * chunk of the 4 GiB address space
+ */
+#define MEM_BITMAP_SIZE ((0x100000000ULL >> MEM_CHUNK_SHIFT) / 8)
+
+/* how guest RAM is backed by host memory */
+typedef enum {
+    /* reserved upfront, faulted in and reclaimed per chunk (default) */
+    MEM_BACKING_DEMAND,
+    /* fully populated at creation, transparent huge pages, NUMA-local */
+    MEM_BACKING_PREFAULT,
+    /* fully populated at creation from explicit huge pages (hugetlbfs) */
+    MEM_BACKING_HUGETLB,
+} memory_backing_t;
+
 /* create a memory instance */
 memory_t *memory_new(uint64_t size);
 
+/* create a memory instance with the given backing */
+memory_t *memory_new_backed(uint64_t size, memory_backing_t backing);
+
 /* delete a memory instance */
 void memory_delete(memory_t *m);
 
 /* reclaim unused memory pages (incremental GC) */
 void memory_gc(void);
 
+/* reclaim unused memory pages on a background thread every @interval_ms
+ * milliseconds instead, until memory_delete(). Only demand-paged RAM is
+ * reclaimed; returns false if the thread was not started.
+ */
+bool memory_gc_start(uint32_t interval_ms);
+
 /* get peak physical memory usage in bytes
  * With MMAP: actual physical memory via demand paging
  * Without MMAP: total allocated size (capped at 512MB)
  */
 uint64_t memory_get_usage(void);
 
+#if HAVE_MMAP
+/* save guest RAM to a file descriptor at a 64 KiB aligned offset.
+ * Only chunks the guest has touched are written; the rest stay file holes.
+ */
+bool memory_save(const memory_t *m, int fd, uint64_t offset);
+
+/* map guest RAM copy-on-write from an image written by memory_save(), or
+ * copy it in when RAM is prefaulted
+ */
+bool memory_restore(memory_t *m, int fd, uint64_t offset);
+#endif
+
 /* read an instruction from memory */
 uint32_t memory_ifetch(uint32_t addr);
 
@@ -97,6 +97,8 @@ static inline bool bht_should_translate(const branch_history_table_t *bt,
 #define JUMP_NORMAL jump_normal + 1
 #if RV32_HAS(SYSTEM)
 #define JUMP_LOC_1 jump_loc_1 + 1
+#define JUMP_TLB_MISS jump_tlb_miss + 2
+#define JUMP_TLB_HIT jump_tlb_hit + 1
 #endif
 /* Special values for target_pc in struct jump */
 #define TARGET_PC_EXIT -1U
@@ -131,6 +133,8 @@ enum x64_reg {
 #define JUMP_NORMAL jump_normal
 #if RV32_HAS(SYSTEM)
 #define JUMP_LOC_1 jump_loc_1
+#define JUMP_TLB_MISS jump_tlb_miss
+#define JUMP_TLB_HIT jump_tlb_hit
 #endif
 /* Special values for target_pc in struct jump */
 #define TARGET_PC_EXIT ~UINT32_C(0)
@@ -1222,6 +1226,33 @@ static inline void emit_store(struct jit_state *state,
         set_dirty(src, false);
 }
 
+/* Add a 32-bit immediate to the 64-bit counter at [dst + offset] */
+static inline void emit_add_counter(struct jit_state *state,
+                                    int dst,
+                                    uint32_t offset,
+                                    uint32_t imm)
+{
+    if (!imm)
+        return;
+#if defined(__x86_64__)
+    /* REX.W 81 /0: add qword ptr [dst + offset], imm32 */
+    assert(imm <= INT32_MAX);
+    emit_basic_rex(state, 1, 0, dst);
+    emit1(state, 0x81);
+    emit_modrm_and_displacement(state, 0, dst, offset);
+    emit4(state, imm);
+#elif defined(__aarch64__)
+    /* riscv_t counters lie beyond the reach of the imm9 load/store form */
+    assert(offset < 4096);
+    emit_addsub_imm(state, true, AS_ADD, R10, dst, offset);
+    emit_loadstore_imm(state, LS_LDRX, temp_reg, R10, 0);
+    emit_movewide_imm(state, true, temp_imm_reg, imm);
+    emit_addsub_register(state, true, AS_ADD, temp_reg, temp_reg,
+                         temp_imm_reg);
+    emit_loadstore_imm(state, LS_STRX, temp_reg, R10, 0);
+#endif
+}
+
 static inline void emit_jmp(struct jit_state *state,
                             uint32_t target_pc,
                             uint32_t target_satp UNUSED)
@@ -1729,6 +1760,87 @@ void emit_jit_mmu_handler(struct jit_state *state, uint8_t vreg_idx)
     emit_a64(state, insn);
 #endif
 }
+
+/* The inline dTLB probe indexes rv->dtlb[] with a shift and tests the perm,
+ * valid and dirty bytes with a single 32-bit load.
+ */
+static_assert(sizeof(tlb_entry_t) == 16, "dTLB probe assumes 16-byte entries");
+static_assert(offsetof(tlb_entry_t, valid) == offsetof(tlb_entry_t, perm) + 1,
+              "dTLB probe assumes valid follows perm");
+static_assert(offsetof(tlb_entry_t, dirty) == offsetof(tlb_entry_t, perm) + 2,
+              "dTLB probe assumes dirty follows valid");
+#define TLB_ENTRY_SHIFT 4
+#define TLB_VALID_BIT (1U << 8)
+#define TLB_DIRTY_BIT (1U << 16)
+
+/* Return the n-th host register that holds no live vm register. */
+static int scratch_reg(int n)
+{
+    for (int i = 0; i < n_host_regs; i++) {
+        if (register_map[i].alive)
+            continue;
+        if (!n--)
+            return register_map[i].reg_idx;
+    }
+    __UNREACHABLE;
+}
+
+/* Emit an inline dTLB probe for an access at the guest virtual address held
+ * in temp_reg, mirroring ram_host_addr(). On a hit, the returned host register
+ * holds the host address of the access and execution falls through. A dTLB
+ * miss, a missing permission, a write to a clean page and a frame outside
+ * guest RAM branch to the location recorded in @jump_miss, where the caller
+ * emits the jit_mmu_handler path. temp_reg is preserved. The caller must have
+ * stored back and reset the register allocator, so that every host register
+ * not mapped afterwards is free to clobber.
+ */
+static int emit_dtlb_probe(struct jit_state *state,
+                           riscv_t *rv,
+                           bool write,
+                           uint32_t *jump_miss)
+{
+    const int host = scratch_reg(0);
+    const int entry = scratch_reg(1);
+    const int tmp = scratch_reg(2);
+    const uint32_t mask = TLB_PERM_RAM | TLB_VALID_BIT |
+                          (write ? PTE_W | TLB_DIRTY_BIT : PTE_R);
+
+    /* entry = &rv->dtlb[vpn & TLB_MASK] */
+    emit_mov(state, temp_reg, host);
+    emit_alu32_imm8(state, 0xc1, 5, host, RV_PG_SHIFT);
+    emit_mov(state, host, entry);
+    emit_alu32_imm32(state, 0x81, 4, entry, TLB_MASK);
+    emit_alu32_imm8(state, 0xc1, 4, entry, TLB_ENTRY_SHIFT);
+    emit_alu64(state, 0x01, parameter_reg[0], entry);
+    emit_load_imm(state, tmp, offsetof(riscv_t, dtlb));
+    emit_alu64(state, 0x01, tmp, entry);
+
+    /* host = (entry->vpn ^ vpn) | ((flags & mask) ^ mask), zero on a hit */
+    emit_load(state, S32, entry, tmp, offsetof(tlb_entry_t, vpn));
+    emit_alu32(state, 0x31, tmp, host);
+    emit_load(state, S32, entry, tmp, offsetof(tlb_entry_t, perm));
+    emit_alu32_imm32(state, 0x81, 4, tmp, mask);
+    emit_alu32_imm32(state, 0x81, 6, tmp, mask);
+    emit_alu32(state, 0x09, tmp, host);
+    *jump_miss = state->offset;
+    emit_jcc_offset(state, JCC_JNE);
+
+    /* host = mem_base + (entry->ppn | page offset) */
+    emit_load(state, S32, entry, host, offsetof(tlb_entry_t, ppn));
+    emit_mov(state, temp_reg, tmp);
+    emit_alu32_imm32(state, 0x81, 4, tmp, MASK(RV_PG_SHIFT));
+    emit_alu32(state, 0x09, tmp, host);
+    emit_load_imm_sext(state, tmp, (intptr_t) PRIV(rv)->mem->mem_base);
+    emit_alu64(state, 0x01, tmp, host);
+
+    /* The scratch registers are not mapped to any vm register, so they must
+     * not be written back by a later save_reg().
+     */
+    set_dirty(host, false);
+    set_dirty(entry, false);
+    set_dirty(tmp, false);
+    return host;
+}
 #endif
 
 static void prepare_translate(struct jit_state *state)
@@ -2084,6 +2196,11 @@ static inline void liveness_calc(block_t *block)
             /* ADDI + BNE: rs1 is source */
             liveness[ir->rs1] = idx;
             break;
+        case rv_insn_fuse13:
+            /* SLLI + ADD: rs1 is the index, rs2 the base */
+            liveness[ir->rs1] = idx;
+            liveness[ir->rs2] = idx;
+            break;
         default:
             __UNREACHABLE;
         }
@@ -2822,6 +2939,22 @@ static void do_fuse12(struct jit_state *state, riscv_t *rv, rv_insn_t *ir)
     emit_exit(state);
 }
 
+/* fused SLLI + ADD (scaled index)
+ * rd = rs2 + (rs1 << imm)
+ */
+static void do_fuse13(struct jit_state *state,
+                      riscv_t *rv UNUSED,
+                      rv_insn_t *ir)
+{
+    ra_load2(state, ir->rs1, ir->rs2);
+    vm_reg[2] = map_vm_reg_reserved2(state, ir->rd, vm_reg[0], vm_reg[1]);
+    emit_mov(state, vm_reg[0], temp_reg);
+    emit_alu32_imm8(state, SHIFT_IMM_OPCODE, SHIFT_SHL, temp_reg,
+                    ir->imm & RV32_SHIFT_MASK);
+    emit_alu32(state, ALU_OP_ADD, vm_reg[1], temp_reg);
+    emit_mov(state, temp_reg, vm_reg[2]);
+}
+
 /* clang-format off */
 static const void *dispatch_table[] = {
     /* RV32 instructions */
@@ -2854,6 +2987,11 @@ static void code_cache_flush(struct jit_state *state, riscv_t *rv)
     return;
 }
 
+void jit_flush(riscv_t *rv)
+{
+    code_cache_flush(rv->jit_state, rv);
+}
+
 typedef void (*codegen_block_func_t)(struct jit_state *,
                                      riscv_t *,
                                      rv_insn_t *);
@@ -2865,6 +3003,16 @@ static void translate(struct jit_state *state, riscv_t *rv, block_t *block)
     reset_reg();
     liveness_reset();
     liveness_calc(block);
+    /* Charge the block on entry rather than when the host code returns, since
+     * chained blocks and loops run many blocks within one call.
+     */
+    emit_add_counter(state, parameter_reg[0], offsetof(riscv_t, csr_cycle),
+                     block->cycle_cost);
+    emit_add_counter(state, parameter_reg[0], offsetof(riscv_t, csr_instret),
+                     block->n_retired);
+    emit_add_counter(state, parameter_reg[0],
+                     offsetof(riscv_t, pmu_event[PMU_EVENT_jit_insn]),
+                     block->n_retired);
     for (idx = 0, ir = block->ir_head; idx < block->n_insn && !should_flush;
          idx++, ir = next) {
         next = ir->next;
@@ -2977,7 +3125,8 @@ static void translate_chained_block(struct jit_state *state,
         }
     }
 
-    branch_history_table_t *bt = ir->branch_table;
+    branch_history_table_t *bt =
+        insn_is_indirect_branch(ir->opcode) ? ir->branch_table : NULL;
     if (bt) {
         int max_idx = bht_find_max_idx(bt);
 #if RV32_HAS(SYSTEM)
@@ -68,6 +68,8 @@ struct host_reg {
 struct jit_state *jit_state_init(size_t size);
 void jit_state_exit(struct jit_state *state);
 void jit_translate(riscv_t *rv, block_t *block);
+/* drop all tier-1 machine code, e.g. after the guest code was rewritten */
+void jit_flush(riscv_t *rv);
 typedef void (*exec_block_func_t)(riscv_t *rv, uintptr_t);
 
 /* JIT misaligned memory access handler.
@@ -83,6 +85,32 @@ void jit_misaligned_handler(riscv_t *rv,
 void t2c_compile(riscv_t *, block_t *, pthread_mutex_t *);
 typedef void (*exec_t2c_func_t)(riscv_t *);
 
+/* T2C compiles a block in two stages. Its first promotion runs a quick O1
+ * pipeline whose code counts how often the trace is entered or loops back to
+ * one of its blocks, and how often each conditional branch goes either way.
+ * Once the heat passes T2C_RECOMPILE_THRESHOLD, the block is recompiled with
+ * the full pipeline and the counts attached as branch weights.
+ */
+#define T2C_QUICK_OPT_LEVEL 1
+#define T2C_RECOMPILE_THRESHOLD (THRESHOLD * 4)
+
+/* jumps back within hot quick-tier code between returns to rv_step() */
+#define T2C_HEAT_EXIT_INTERVAL 4096
+
+/* branches beyond this number in a quick-tier trace are left uncounted */
+#define T2C_PROFILE_BRANCHES 256
+
+typedef struct {
+    const rv_insn_t *ir; /**< the conditional branch being counted */
+    uint32_t count[2];   /**< taken and untaken executions */
+} t2c_branch_count_t;
+
+typedef struct {
+    uint32_t heat;     /**< trace entries and backward jumps within it */
+    uint32_t n_branch; /**< used slots of branch[] */
+    t2c_branch_count_t branch[T2C_PROFILE_BRANCHES];
+} t2c_profile_t;
+
 /* The jit-cache records the program counters and the entries of executable
  * instructions generated by T2C. Like hardware cache, the old jit-cache will be
  * replaced by the new one which uses the same slot.
@@ -113,6 +141,7 @@ typedef void (*exec_t2c_func_t)(riscv_t *);
  *
  * Invalidation: Inline cache entries are cleared on:
  * - Block eviction (inline_cache_clear_key in emulate.c)
+ * - Installation of recompiled T2C code (rv_step in emulate.c)
  * - SFENCE.VMA (inline_cache_clear_page in rv32_template.c)
  * - FENCE.I / code_cache_flush (inline_cache_clear in jit.c)
  *
@@ -193,9 +222,6 @@ void jit_cache_update(struct jit_cache *cache, uint64_t key, void *entry);
 void jit_cache_clear(struct jit_cache *cache);
 void jit_cache_clear_page(struct jit_cache *cache, uint32_t va, uint32_t satp);
 
-/* Dispose LLVM execution engine when a T2C-compiled block is freed */
-void t2c_dispose_engine(void *engine);
-
-/* Wrapper for cache cleanup - disposes LLVM engine from a block */
+/* Dispose the LLVM engines and the profile of a block before it is freed */
 void t2c_dispose_block_engine(void *block);
 #endif
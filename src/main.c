@@ -11,6 +11,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#if HAVE_MMAP
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#endif
 
 #if defined(__EMSCRIPTEN__)
 #include "em_runtime.h"
@@ -18,6 +24,7 @@
 
 #include "elf.h"
 #include "io.h"
+#include "map.h"
 #include "riscv.h"
 #include "utils.h"
 
@@ -26,6 +33,13 @@
 static bool opt_trace = false;
 #endif
 
+#if !RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+/* serve runs of the loaded program over the fork-server control pipe */
+static bool opt_forkserver = false;
+/* milliseconds a fork-server run may take before it is killed, 0 for none */
+static uint32_t opt_forkserver_timeout = 0;
+#endif
+
 #if RV32_HAS(GDBSTUB)
 /* enable program gdbstub mode */
 static bool opt_gdbstub = false;
@@ -48,15 +62,55 @@ static char *opt_prog_name;
 /* target argc and argv */
 static int prog_argc;
 static char **prog_args;
-static const char *optstr = "tgqmhpd:a:k:i:b:x:";
+static const char *optstr = "tgqmhpFLd:a:k:i:b:x:s:r:M:S:O:C:H:T:R:P:W:G:";
 
 /* enable misaligned memory access */
 static bool opt_misaligned = false;
 
+/* run well-known guest libc routines on the host */
+static bool opt_accel_libc = false;
+
+/* host backing of guest RAM */
+static memory_backing_t opt_mem_backing = MEM_BACKING_DEMAND;
+
+/* milliseconds between background memory GC steps, 0 to GC inline */
+static uint32_t opt_mem_gc_interval = 0;
+
+#if RV32_HAS(T2C)
+/* LLVM optimization level of tier-2 code */
+#ifndef CONFIG_T2C_OPT_LEVEL
+#define CONFIG_T2C_OPT_LEVEL 3
+#endif
+static_assert(CONFIG_T2C_OPT_LEVEL >= 0 && CONFIG_T2C_OPT_LEVEL <= 3,
+              "T2C optimization level must be 0-3");
+static int opt_t2c_opt_level = CONFIG_T2C_OPT_LEVEL;
+static char *opt_t2c_cache_dir;
+#endif
+
 /* dump profiling data */
 static bool opt_prof_data = false;
 static char *prof_out_file;
 
+/* sampled simulation: every interval starts with a detailed window */
+#define SAMPLE_INTERVAL_DEFAULT 100000000ULL
+#define SAMPLE_WINDOW_DEFAULT 1000000ULL
+static bool opt_sample = false;
+static char *sample_out_file;
+static uint64_t opt_sample_interval = SAMPLE_INTERVAL_DEFAULT;
+static uint64_t opt_sample_window = SAMPLE_WINDOW_DEFAULT;
+
+/* dynamic instruction and register histograms */
+static bool opt_histogram = false;
+static char *histogram_out_file;
+
+/* timing model */
+static char *opt_timing_model;
+static uint32_t opt_clock_mhz;
+
+/* nondeterministic inputs to record, or to replay */
+static char *opt_record_out;
+static char *opt_replay_in;
+
 #if RV32_HAS(SYSTEM_MMIO)
 /* Linux kernel data */
 static char *opt_kernel_img;
@@ -66,6 +120,11 @@ static char *opt_bootargs;
 #define VBLK_DEV_MAX 100
 static char *opt_virtio_blk_img[VBLK_DEV_MAX];
 static int opt_virtio_blk_idx = 0;
+#if HAVE_MMAP
+/* VM snapshot to write on SIGUSR1, and to resume from */
+static char *opt_snapshot_out;
+static char *opt_snapshot_in;
+#endif
 #endif
 
 static void print_usage(const char *filename)
@@ -77,6 +136,11 @@ static void print_usage(const char *filename)
 #if !RV32_HAS(SYSTEM_MMIO)
         "  -t : print executable trace\n"
 #endif
+#if !RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+        "  -F : run as a fork server on file descriptors 198/199\n"
+        "  -W <ms> : kill fork-server runs that take longer than <ms> "
+        "milliseconds\n"
+#endif
 #if RV32_HAS(GDBSTUB)
         "  -g : allow remote GDB connections (as gdbstub)\n"
 #endif
@@ -88,6 +152,10 @@ static void print_usage(const char *filename)
         "(default read and write). This option may be specified "
         "multiple times for multiple block devices\n"
         "  -b <bootargs> : use customized <bootargs> for the kernel\n"
+#if HAVE_MMAP
+        "  -s <snapshot> : save VM state to <snapshot> on SIGUSR1\n"
+        "  -r <snapshot> : resume from <snapshot> instead of booting\n"
+#endif
 #endif
         "  -d [filename]: dump registers as JSON to the "
         "given file or `-` (STDOUT)\n"
@@ -95,11 +163,87 @@ static void print_usage(const char *filename)
         "  -a [filename] : dump signature to the given file, "
         "required by arch-test test\n"
         "  -m : enable misaligned memory access\n"
+#if !RV32_HAS(SYSTEM)
+        "  -L : run the guest's memcpy, memset, memmove, memcmp and strlen "
+        "on the host\n"
+#endif
+#if HAVE_MMAP
+        "  -M <demand|prefault|hugetlb> : host backing of guest memory "
+        "(default: demand)\n"
+        "  -G <ms> : reclaim unused guest memory on a background thread "
+        "every <ms> milliseconds\n"
+#endif
+#if RV32_HAS(T2C)
+        "  -O <0-3> : LLVM optimization level of tier-2 code "
+        "(default: T2C_OPT_LEVEL of the build)\n"
+        "  -C <dir> : cache tier-2 code in <dir> across runs\n"
+#endif
         "  -p : generate profiling data\n"
+        "  -S <file>[,<interval>[,<window>]] : fast-forward and save "
+        "statistics of a detailed <window> (default 1000000) taken every "
+        "<interval> (default 100000000) instructions to <file>, and their "
+        "basic block vectors to <file>.bb\n"
+#if !RV32_HAS(SYSTEM)
+        "  -H [filename] : save the dynamic instruction and register "
+        "histograms to the given file or `-` (STDOUT)\n"
+#endif
+        "  -T [<model>][,<MHz>] : charge cycles with the ideal, inorder or "
+        "multicycle timing model (default: ideal), and derive time from "
+        "cycles at a <MHz> core clock\n"
+        "  -R <log> : record the inputs from the host to <log>\n"
+        "  -P <log> : replay the inputs recorded in <log>\n"
         "  -h : show this message",
         filename);
 }
 
+/* parse [<model>][,<MHz>] */
+static bool parse_timing_arg(char *arg)
+{
+    char *mhz = strchr(arg, ',');
+    if (mhz) {
+        *mhz++ = '\0';
+        char *end;
+        unsigned long val = strtoul(mhz, &end, 0);
+        if (*end || !val || val > UINT32_MAX)
+            return false;
+        opt_clock_mhz = val;
+    }
+    if (*arg)
+        opt_timing_model = arg;
+    return true;
+}
+
+/* parse <file>[,<interval>[,<window>]] */
+static bool parse_sample_arg(char *arg)
+{
+    char *interval = strchr(arg, ',');
+    if (interval) {
+        *interval++ = '\0';
+        char *window = strchr(interval, ',');
+        if (window) {
+            *window++ = '\0';
+            char *end;
+            opt_sample_window = strtoull(window, &end, 0);
+            if (*end)
+                return false;
+        }
+        char *end;
+        opt_sample_interval = strtoull(interval, &end, 0);
+        if (*end)
+            return false;
+    }
+    if (!*arg || !opt_sample_window ||
+        opt_sample_window > opt_sample_interval) {
+        rv_log_error("Invalid sampling window %" PRIu64
+                     " for interval %" PRIu64,
+                     opt_sample_window, opt_sample_interval);
+        return false;
+    }
+    opt_sample = true;
+    sample_out_file = arg;
+    return true;
+}
+
 static bool parse_args(int argc, char **args)
 {
     int opt;
@@ -114,6 +258,20 @@ static bool parse_args(int argc, char **args)
             opt_trace = true;
             break;
 #endif
+#if !RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+        case 'F':
+            opt_forkserver = true;
+            break;
+        case 'W': {
+            char *end;
+            unsigned long val = strtoul(optarg, &end, 0);
+            if (*end || !val || val > UINT32_MAX)
+                return false;
+            opt_forkserver_timeout = val;
+            emu_argc++;
+            break;
+        }
+#endif
 #if RV32_HAS(GDBSTUB)
         case 'g':
             opt_gdbstub = true;
@@ -145,6 +303,16 @@ static bool parse_args(int argc, char **args)
                 return false;
             emu_argc++;
             break;
+#if HAVE_MMAP
+        case 's':
+            opt_snapshot_out = optarg;
+            emu_argc++;
+            break;
+        case 'r':
+            opt_snapshot_in = optarg;
+            emu_argc++;
+            break;
+#endif
 #endif
         case 'q':
             opt_quiet_outputs = true;
@@ -154,9 +322,73 @@ static bool parse_args(int argc, char **args)
         case 'm':
             opt_misaligned = true;
             break;
+#if !RV32_HAS(SYSTEM)
+        case 'L':
+            opt_accel_libc = true;
+            break;
+#endif
+#if HAVE_MMAP
+        case 'M':
+            if (!strcmp(optarg, "demand"))
+                opt_mem_backing = MEM_BACKING_DEMAND;
+            else if (!strcmp(optarg, "prefault"))
+                opt_mem_backing = MEM_BACKING_PREFAULT;
+            else if (!strcmp(optarg, "hugetlb"))
+                opt_mem_backing = MEM_BACKING_HUGETLB;
+            else
+                return false;
+            emu_argc++;
+            break;
+        case 'G': {
+            char *end;
+            unsigned long val = strtoul(optarg, &end, 0);
+            if (*end || !val || val > UINT32_MAX)
+                return false;
+            opt_mem_gc_interval = val;
+            emu_argc++;
+            break;
+        }
+#endif
+#if RV32_HAS(T2C)
+        case 'O':
+            if (optarg[0] < '0' || optarg[0] > '3' || optarg[1])
+                return false;
+            opt_t2c_opt_level = optarg[0] - '0';
+            emu_argc++;
+            break;
+        case 'C':
+            opt_t2c_cache_dir = optarg;
+            emu_argc++;
+            break;
+#endif
         case 'p':
             opt_prof_data = true;
             break;
+        case 'S':
+            if (!parse_sample_arg(optarg))
+                return false;
+            emu_argc++;
+            break;
+#if !RV32_HAS(SYSTEM)
+        case 'H':
+            opt_histogram = true;
+            histogram_out_file = optarg;
+            emu_argc++;
+            break;
+#endif
+        case 'T':
+            if (!parse_timing_arg(optarg))
+                return false;
+            emu_argc++;
+            break;
+        case 'R':
+            opt_record_out = optarg;
+            emu_argc++;
+            break;
+        case 'P':
+            opt_replay_in = optarg;
+            emu_argc++;
+            break;
         case 'd':
             opt_dump_regs = true;
             registers_out_file = optarg;
@@ -172,6 +404,11 @@ static bool parse_args(int argc, char **args)
         }
     }
 
+    if (opt_record_out && opt_replay_in) {
+        rv_log_error("-R and -P cannot be used together");
+        return false;
+    }
+
     prog_argc = argc - emu_argc - 1;
     /* optind points to the first non-option string, so it should indicate the
      * target program.
@@ -241,6 +478,202 @@ static void dump_test_signature(const char UNUSED *prog_name)
     elf_delete(elf);
 }
 
+#if !RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+/* Fork-server mode
+ *
+ * The ELF file is parsed and loaded, guest memory is set up and the signal
+ * handlers are installed once. Every request then forks a child, which
+ * inherits all of it copy-on-write and only has to lay out its own argv
+ * before running.
+ *
+ * Requests are read from FORKSRV_CTL_FD:
+ *   uint32_t args_len;   bytes of NUL-terminated guest argv strings
+ *   uint32_t input_len;  bytes of data fed to the guest's stdin
+ *   char args[args_len];
+ *   uint8_t input[input_len];
+ * and one forksrv_result_t per request is written to FORKSRV_ST_FD. The
+ * server exits once the control pipe is closed. A run that exceeds the -W
+ * timeout is killed by SIGALRM and reported with status -SIGALRM.
+ *
+ * Before the first request, the blocks reachable from the entry point and
+ * from every function symbol are translated (user mode only, without an MMU
+ * to walk), so that each child inherits
+ * them rather than translating the same code again.
+ */
+#define FORKSRV_CTL_FD 198
+#define FORKSRV_ST_FD 199
+#define FORKSRV_ARGS_MAX 256
+/* at most half of the block map is warmed, so that nothing is evicted */
+#define FORKSRV_WARM_BLOCKS ((1U << BLOCK_MAP_CAPACITY_BITS) / 2)
+
+typedef struct {
+    int32_t status; /**< guest exit code, or -signal if the emulator died */
+    uint32_t pc;    /**< program counter when the guest stopped */
+    uint32_t x[32]; /**< integer registers when the guest stopped */
+} forksrv_result_t;
+
+static bool forksrv_read(int fd, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool forksrv_write(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    while (len) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+#if !RV32_HAS(SYSTEM)
+static void forksrv_warm(riscv_t *rv, riscv_word_t entry)
+{
+    map_t funcs = map_init(uint32_t, uint32_t, map_cmp_uint);
+    elf_t *elf = elf_new();
+    if (!funcs || !elf || !elf_open(elf, opt_prog_name))
+        goto out;
+    elf_get_functions(elf, funcs);
+
+    /* the function holding the entry point goes first, or the page of the
+     * entry point when it has no sized symbol
+     */
+    riscv_word_t entry_end = (entry & ~(RV_PG_SIZE - 1)) + RV_PG_SIZE;
+    map_iter_t it;
+    for (map_first(funcs, &it); !map_at_end(funcs, &it); map_next(funcs, &it)) {
+        uint32_t start = map_iter_key(&it, uint32_t);
+        uint32_t size = map_iter_value(&it, uint32_t);
+        if (start <= entry && entry - start < size) {
+            entry_end = start + size;
+            break;
+        }
+    }
+    uint32_t budget = FORKSRV_WARM_BLOCKS;
+    budget -= rv_translate_ahead(rv, entry, entry_end, budget);
+
+    for (map_first(funcs, &it); budget && !map_at_end(funcs, &it);
+         map_next(funcs, &it)) {
+        uint32_t start = map_iter_key(&it, uint32_t);
+        uint32_t size = map_iter_value(&it, uint32_t);
+        budget -= rv_translate_ahead(rv, start, start + size, budget);
+    }
+    rv_log_info("Fork server translated %u blocks ahead",
+                FORKSRV_WARM_BLOCKS - budget);
+
+out:
+    elf_delete(elf);
+    if (funcs)
+        map_delete(funcs);
+}
+#endif
+
+static void run_forkserver(riscv_t *rv, vm_attr_t *attr)
+{
+    const riscv_word_t entry = rv_get_pc(rv);
+
+#if !RV32_HAS(SYSTEM)
+    forksrv_warm(rv, entry);
+#endif
+
+    /* filled in by the child, read back by the server after waitpid() */
+    forksrv_result_t *shared = mmap(NULL, sizeof(*shared),
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        rv_log_fatal("Cannot allocate fork-server result buffer");
+        return;
+    }
+
+    uint32_t lens[2];
+    while (forksrv_read(FORKSRV_CTL_FD, lens, sizeof(lens))) {
+        char *args = malloc(lens[0] + 1);
+        uint8_t *input = malloc(lens[1] + 1);
+        FILE *input_file = tmpfile();
+        if (!args || !input || !input_file ||
+            !forksrv_read(FORKSRV_CTL_FD, args, lens[0]) ||
+            !forksrv_read(FORKSRV_CTL_FD, input, lens[1]) ||
+            fwrite(input, 1, lens[1], input_file) != lens[1]) {
+            rv_log_error("Malformed fork-server request");
+            free(args);
+            free(input);
+            if (input_file)
+                fclose(input_file);
+            break;
+        }
+        args[lens[0]] = '\0';
+        fflush(input_file);
+        rewind(input_file);
+
+        char *argv[FORKSRV_ARGS_MAX + 1];
+        int argc = 0;
+        for (char *a = args; a < args + lens[0] && argc < FORKSRV_ARGS_MAX;
+             a += strlen(a) + 1)
+            argv[argc++] = a;
+        argv[argc] = NULL;
+
+        memset(shared, 0, sizeof(*shared));
+        fflush(stdout);
+        fflush(stderr);
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(FORKSRV_CTL_FD);
+            close(FORKSRV_ST_FD);
+            dup2(fileno(input_file), STDIN_FILENO);
+
+            if (opt_forkserver_timeout) {
+                struct itimerval limit = {0};
+                limit.it_value.tv_sec = opt_forkserver_timeout / 1000;
+                limit.it_value.tv_usec = opt_forkserver_timeout % 1000 * 1000;
+                signal(SIGALRM, SIG_DFL);
+                setitimer(ITIMER_REAL, &limit, NULL);
+            }
+
+            if (argc) {
+                attr->argc = argc;
+                attr->argv = argv;
+            }
+            rv_reset(rv, entry);
+            rv_run(rv);
+
+            shared->status = attr->exit_code;
+            shared->pc = rv_get_pc(rv);
+            for (int i = 0; i < 32; i++)
+                shared->x[i] = rv_get_reg(rv, i);
+            exit(attr->exit_code);
+        }
+
+        int wstatus = 0;
+        if (pid < 0 || waitpid(pid, &wstatus, 0) < 0) {
+            rv_log_error("Fork-server failed to run the guest");
+            shared->status = -1;
+        } else if (WIFSIGNALED(wstatus)) {
+            shared->status = -WTERMSIG(wstatus);
+        }
+
+        fclose(input_file);
+        free(args);
+        free(input);
+        if (!forksrv_write(FORKSRV_ST_FD, shared, sizeof(*shared)))
+            break;
+    }
+
+    munmap(shared, sizeof(*shared));
+}
+#endif
+
 /* CYCLE_PER_STEP shall be defined on different runtime */
 #ifndef CYCLE_PER_STEP
 #define CYCLE_PER_STEP 100
@@ -277,6 +710,14 @@ int main(int argc, char **args)
         return 1;
     }
 
+#if !RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+    /* forked runs would inherit the GC state, but not the GC thread */
+    if (opt_forkserver && opt_mem_gc_interval) {
+        rv_log_error("-G cannot be combined with -F");
+        return 1;
+    }
+#endif
+
     int run_flag = 0;
 #if !RV32_HAS(SYSTEM_MMIO)
     run_flag |= opt_trace;
@@ -285,9 +726,13 @@ int main(int argc, char **args)
     run_flag |= opt_gdbstub << 1;
 #endif
     run_flag |= opt_prof_data << 2;
+    run_flag |= opt_sample << 3;
+    run_flag |= opt_histogram << 4;
 
     vm_attr_t attr = {
         .mem_size = MEM_SIZE,
+        .mem_backing = opt_mem_backing,
+        .mem_gc_interval = opt_mem_gc_interval,
         .stack_size = STACK_SIZE,
         .args_offset_size = ARGS_OFFSET_SIZE,
         .argc = prog_argc,
@@ -295,8 +740,21 @@ int main(int argc, char **args)
         .log_level = LOG_WARN,
         .run_flag = run_flag,
         .profile_output_file = prof_out_file,
+        .sample_output_file = sample_out_file,
+        .sample_interval = opt_sample_interval,
+        .sample_window = opt_sample_window,
+        .histogram_output_file = histogram_out_file,
+        .timing_model = opt_timing_model,
+        .clock_mhz = opt_clock_mhz,
+        .record_output_file = opt_record_out,
+        .replay_input_file = opt_replay_in,
         .cycle_per_step = CYCLE_PER_STEP,
         .allow_misalign = opt_misaligned,
+        .accel_libc = opt_accel_libc,
+#if RV32_HAS(T2C)
+        .t2c_opt_level = opt_t2c_opt_level,
+        .t2c_cache_dir = opt_t2c_cache_dir,
+#endif
         .fd_stdin = STDIN_FILENO,
         .fd_stdout = STDOUT_FILENO,
         .fd_stderr = STDERR_FILENO,
@@ -311,6 +769,9 @@ int main(int argc, char **args)
     } else {
         attr.data.system.vblk_device = NULL;
     }
+#if HAVE_MMAP
+    attr.snapshot_output_file = opt_snapshot_out;
+#endif
 #else
     attr.data.user.elf_program = opt_prog_name;
 #endif
@@ -346,11 +807,25 @@ int main(int argc, char **args)
     }
 #endif
 
+#if RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+    if (opt_snapshot_in && !rv_snapshot_restore(rv, opt_snapshot_in)) {
+        attr.exit_code = 1;
+        rv_delete(rv);
+        rv = NULL;
+        goto end;
+    }
+#endif
+
 #if defined(__EMSCRIPTEN__)
     disable_run_button();
 #endif
 
-    rv_run(rv);
+#if !RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+    if (opt_forkserver)
+        run_forkserver(rv, &attr);
+    else
+#endif
+        rv_run(rv);
 
     /* dump registers as JSON */
     if (opt_dump_regs)
@@ -0,0 +1,211 @@
+/*
+ * rv32emu is freely redistributable under the MIT License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "log.h"
+#include "replay.h"
+
+/* A log file holds a fixed header followed by the entries, each of which is
+ * a replay_entry_t and its len bytes of data. A replayed log is loaded into
+ * memory as the same sequence of entries without the header.
+ */
+#define REPLAY_MAGIC "RV32RPLY"
+#define REPLAY_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} replay_header_t;
+
+typedef struct {
+    uint64_t when; /**< instret when logged, the poll count for poll events */
+    uint32_t kind; /**< replay_kind_t */
+    uint32_t len;  /**< bytes of data that follow */
+} replay_entry_t;
+
+struct replay {
+    uint8_t *log;   /**< entries to replay */
+    size_t len;     /**< bytes of entries */
+    size_t pos;     /**< offset of the next entry to replay */
+    uint64_t polls; /**< poll events so far, logged or not */
+    FILE *out;      /**< recording, or NULL */
+    const uint64_t *instret;
+};
+
+static const char *const replay_kind_name[] = {
+#define _(kind) #kind,
+    REPLAY_KIND_LIST
+#undef _
+};
+
+static bool replay_load(replay_t *r, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        rv_log_error("Cannot open replay log %s", path);
+        return false;
+    }
+
+    bool ok = false;
+    replay_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        memcmp(hdr.magic, REPLAY_MAGIC, sizeof(hdr.magic)) ||
+        hdr.version != REPLAY_VERSION) {
+        rv_log_error("%s is not a valid replay log", path);
+        goto out;
+    }
+
+    long start = ftell(f);
+    if (fseek(f, 0, SEEK_END) || start < 0)
+        goto out;
+    long end = ftell(f);
+    if (end < start || fseek(f, start, SEEK_SET))
+        goto out;
+
+    r->len = end - start;
+    r->log = malloc(r->len ? r->len : 1);
+    if (!r->log || fread(r->log, 1, r->len, f) != r->len) {
+        rv_log_error("Failed to read replay log %s", path);
+        goto out;
+    }
+    ok = true;
+
+out:
+    fclose(f);
+    return ok;
+}
+
+replay_t *replay_new(const char *record_path,
+                     const char *replay_path,
+                     const uint64_t *instret)
+{
+    replay_t *r = calloc(1, sizeof(replay_t));
+    if (!r)
+        return NULL;
+    r->instret = instret;
+
+    if (replay_path && !replay_load(r, replay_path))
+        goto fail;
+
+    if (record_path) {
+        r->out = fopen(record_path, "wb");
+        if (!r->out) {
+            rv_log_error("Cannot create replay log %s", record_path);
+            goto fail;
+        }
+        replay_header_t hdr = {.version = REPLAY_VERSION};
+        memcpy(hdr.magic, REPLAY_MAGIC, sizeof(hdr.magic));
+        if (fwrite(&hdr, sizeof(hdr), 1, r->out) != 1) {
+            rv_log_error("Failed to write replay log %s", record_path);
+            goto fail;
+        }
+    }
+    return r;
+
+fail:
+    replay_delete(r);
+    return NULL;
+}
+
+void replay_delete(replay_t *r)
+{
+    if (!r)
+        return;
+    if (r->out)
+        fclose(r->out);
+    free(r->log);
+    free(r);
+}
+
+bool replay_playing(const replay_t *r)
+{
+    return r && r->pos < r->len;
+}
+
+/* Copy the header of the replayed entry at the current position to @entry.
+ * Entries are packed back to back, so the header may be misaligned in the log.
+ * Return false at the end of the log.
+ */
+static bool replay_peek(const replay_t *r, replay_entry_t *entry)
+{
+    if (r->pos + sizeof(*entry) > r->len)
+        return false;
+    memcpy(entry, r->log + r->pos, sizeof(*entry));
+    return true;
+}
+
+static void replay_append(replay_t *r,
+                          uint64_t when,
+                          replay_kind_t kind,
+                          const void *buf,
+                          uint32_t len)
+{
+    const replay_entry_t entry = {.when = when, .kind = kind, .len = len};
+
+    if (r->out && (fwrite(&entry, sizeof(entry), 1, r->out) != 1 ||
+                   fwrite(buf, 1, len, r->out) != len)) {
+        rv_log_error("Failed to write replay log, recording stopped");
+        fclose(r->out);
+        r->out = NULL;
+    }
+}
+
+void replay_input(replay_t *r, replay_kind_t kind, void *buf, uint32_t len)
+{
+    if (!r)
+        return;
+
+    if (!replay_playing(r)) {
+        replay_append(r, *r->instret, kind, buf, len);
+        return;
+    }
+
+    replay_entry_t entry;
+    const bool found = replay_peek(r, &entry);
+    if (!found || entry.kind != kind || entry.len != len ||
+        r->pos + sizeof(entry) + len > r->len) {
+        rv_log_fatal("Replay diverged at instret %" PRIu64
+                     ": expected %s input of %u bytes",
+                     *r->instret, replay_kind_name[kind], len);
+        if (found && entry.kind < ARRAY_SIZE(replay_kind_name))
+            rv_log_fatal("The log holds %s input of %u bytes instead",
+                         replay_kind_name[entry.kind], entry.len);
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(buf, r->log + r->pos + sizeof(entry), len);
+    r->pos += sizeof(entry) + len;
+}
+
+bool replay_poll(replay_t *r, replay_kind_t kind, bool ready)
+{
+    if (!r)
+        return ready;
+
+    const uint64_t poll = r->polls++;
+    if (!replay_playing(r)) {
+        if (ready)
+            replay_append(r, poll, kind, NULL, 0);
+        return ready;
+    }
+
+    replay_entry_t entry;
+    if (!replay_peek(r, &entry) || entry.kind != kind || entry.when > poll)
+        return false;
+    if (entry.when < poll) {
+        rv_log_fatal("Replay diverged at instret %" PRIu64
+                     ": %s event of poll %" PRIu64 " was missed",
+                     *r->instret, replay_kind_name[kind], entry.when);
+        exit(EXIT_FAILURE);
+    }
+    r->pos += sizeof(entry) + entry.len;
+    return true;
+}
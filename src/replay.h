@@ -0,0 +1,67 @@
+/*
+ * rv32emu is freely redistributable under the MIT License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Record and replay of nondeterministic inputs
+ *
+ * Everything the guest observes that does not follow from its own state
+ * passes through a log: the results of the system calls served by the host,
+ * the host clock, and the input of the UART and the Goldfish RTC. Recording
+ * appends each input to the log, replaying feeds the recorded inputs back in
+ * the same order without consulting the host, so a replayed run retraces the
+ * recorded one instruction by instruction.
+ *
+ * A log replays while it holds entries past the current position, and
+ * records once the position reaches its end.
+ */
+
+/* kinds of logged inputs */
+#define REPLAY_KIND_LIST                                                  \
+    _(syscall)   /* result and output buffer of a syscall the host served */ \
+    _(time)      /* host clock read through the time CSRs */              \
+    _(uart_poll) /* UART input became ready, at a count of polls */       \
+    _(uart_in)   /* byte read from the UART */                            \
+    _(rtc)       /* host clock read by the Goldfish RTC */
+
+typedef enum {
+#define _(kind) REPLAY_##kind,
+    REPLAY_KIND_LIST
+#undef _
+} replay_kind_t;
+
+typedef struct replay replay_t;
+
+/* Create a log that replays the file @replay_path if given, and records into
+ * the file @record_path if given. @instret stamps each entry for divergence
+ * reports. Return NULL on error.
+ */
+replay_t *replay_new(const char *record_path,
+                     const char *replay_path,
+                     const uint64_t *instret);
+
+/* flush the recorded entries and delete the log */
+void replay_delete(replay_t *r);
+
+/* whether the next input comes from the log rather than from the host */
+bool replay_playing(const replay_t *r);
+
+/* Pass @len bytes of input at @buf through the log. Recording appends them,
+ * replaying overwrites them with the recorded bytes. A replayed entry of
+ * another kind or length means the run diverged from the recording, which is
+ * fatal. @r may be NULL, then this is a no-op.
+ */
+void replay_input(replay_t *r, replay_kind_t kind, void *buf, uint32_t len);
+
+/* Pass the outcome of polling a device through the log, as an event that is
+ * only logged when @ready is set. Replaying ignores @ready and returns whether
+ * the poll recorded at this point was ready.
+ */
+bool replay_poll(replay_t *r, replay_kind_t kind, bool ready);
+
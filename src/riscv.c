@@ -6,6 +6,8 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -47,6 +49,19 @@
 
 #define BLOCK_IR_MAP_CAPACITY_BITS 10
 
+/* release the IR array of a block along with its cold payloads */
+void block_free_ir(riscv_t *rv, block_t *block)
+{
+    rv_insn_t *ir = block->ir_head;
+    for (uint32_t i = 0; i < block->n_insn; i++, ir++) {
+        if (insn_is_indirect_branch(ir->opcode))
+            free(ir->branch_table);
+        else if (ir->fuse)
+            mpool_free(rv->fuse_mp, ir->fuse);
+    }
+    free(block->ir_head);
+}
+
 #if !RV32_HAS(JIT)
 /* initialize the block map */
 static void block_map_init(block_map_t *map, const uint8_t bits)
@@ -66,16 +81,7 @@ void block_map_clear(riscv_t *rv)
         if (!block)
             continue;
 
-        uint32_t idx;
-        rv_insn_t *ir, *next;
-        for (idx = 0, ir = block->ir_head; idx < block->n_insn;
-             idx++, ir = next) {
-            if (ir->fuse)
-                mpool_free(rv->fuse_mp, ir->fuse);
-            free(ir->branch_table);
-            next = ir->next;
-            mpool_free(rv->block_ir_mp, ir);
-        }
+        block_free_ir(rv, block);
         mpool_free(rv->block_mp, block);
         map->map[i] = NULL;
     }
@@ -96,7 +102,6 @@ static void block_map_destroy(riscv_t *rv)
     free(rv->block_map.map);
 
     mpool_destroy(rv->block_mp);
-    mpool_destroy(rv->block_ir_mp);
     mpool_destroy(rv->fuse_mp);
 }
 #endif
@@ -598,6 +603,27 @@ riscv_t *rv_create(riscv_user_t rv_attr)
         return NULL;
     assert(rv);
 
+    /* copy over the attr */
+    rv->data = rv_attr;
+
+    vm_attr_t *attr = PRIV(rv);
+    const char *timing_model = attr->timing_model;
+    rv->timing = timing_model_find(timing_model);
+    if (!rv->timing) {
+        rv_log_error("Unknown timing model %s", timing_model);
+        free(rv);
+        return NULL;
+    }
+
+    if (attr->record_output_file || attr->replay_input_file) {
+        rv->replay = replay_new(attr->record_output_file,
+                                attr->replay_input_file, &rv->csr_instret);
+        if (!rv->replay) {
+            free(rv);
+            return NULL;
+        }
+    }
+
 #if RV32_HAS(SYSTEM_MMIO)
     /* register cleaning callback for CTRL+a+x exit */
     atexit(rv_async_block_clear);
@@ -605,13 +631,24 @@ riscv_t *rv_create(riscv_user_t rv_attr)
     atexit(rv_fsync_device);
 #endif
 
-    /* copy over the attr */
-    rv->data = rv_attr;
-
-    vm_attr_t *attr = PRIV(rv);
-    attr->mem = memory_new(attr->mem_size);
-    assert(attr->mem);
+    attr->mem = memory_new_backed(attr->mem_size, attr->mem_backing);
+    if (!attr->mem && attr->mem_backing == MEM_BACKING_HUGETLB) {
+        /* too few huge pages reserved (vm.nr_hugepages) */
+        rv_log_warn("Falling back to prefaulted guest memory");
+        attr->mem_backing = MEM_BACKING_PREFAULT;
+        attr->mem = memory_new_backed(attr->mem_size, attr->mem_backing);
+    }
+    if (!attr->mem) {
+        rv_log_error("Cannot allocate %" PRIu64 " bytes of guest memory",
+                     attr->mem_size);
+        if (rv->replay)
+            replay_delete(rv->replay);
+        free(rv);
+        return NULL;
+    }
     assert(!(((uintptr_t) attr->mem) & 0b11));
+    if (attr->mem_gc_interval && !memory_gc_start(attr->mem_gc_interval))
+        rv_log_warn("Cannot run the memory GC on a background thread");
 
     /* reset */
     rv_reset(rv, 0U);
@@ -652,7 +689,32 @@ riscv_t *rv_create(riscv_user_t rv_attr)
     if ((end = elf_get_symbol(elf, "_end")))
         attr->break_addr = end->st_value;
 
+#if RV32_HAS(T2C)
+    /* function bounds let T2C inline small callees into a region */
+    rv->t2c_funcs = map_init(uint32_t, uint32_t, map_cmp_uint);
+    if (rv->t2c_funcs)
+        elf_get_functions(elf, rv->t2c_funcs);
+#endif
+
 #if !RV32_HAS(SYSTEM)
+    if (attr->accel_libc) {
+        static const char *const libc_names[] = {
+#define _(func) [libcall_##func] = #func,
+            LIBCALL_LIST
+#undef _
+        };
+        rv->libc_calls = map_init(uint32_t, uint32_t, map_cmp_uint);
+        for (uint32_t i = 0; rv->libc_calls && i < ARRAY_SIZE(libc_names);
+             i++) {
+            const struct Elf32_Sym *sym = elf_get_symbol(elf, libc_names[i]);
+            if (sym) {
+                map_insert(rv->libc_calls, &sym->st_value, &i);
+                rv_log_info("Running %s at 0x%08x on the host", libc_names[i],
+                            sym->st_value);
+            }
+        }
+    }
+
     /* set not exiting */
     attr->on_exit = false;
     attr->exit_addr = 0;
@@ -700,6 +762,9 @@ riscv_t *rv_create(riscv_user_t rv_attr)
         .on_ebreak = ebreak_handler,
         .on_memcpy = memcpy_handler,
         .on_memset = memset_handler,
+        .on_memmove = memmove_handler,
+        .on_memcmp = memcmp_handler,
+        .on_strlen = strlen_handler,
         .on_trap = trap_handler,
     };
     memcpy(&rv->io, &io, sizeof(riscv_io_t));
@@ -772,11 +837,13 @@ riscv_t *rv_create(riscv_user_t rv_attr)
     assert(attr->uart);
     attr->uart->in_fd = attr->fd_stdin;
     attr->uart->out_fd = attr->fd_stdout;
+    attr->uart->replay = rv->replay;
 
     /* setup rtc */
 #if RV32_HAS(GOLDFISH_RTC)
     attr->rtc = rtc_new();
     assert(attr->rtc);
+    attr->rtc->replay = rv->replay;
 #endif /* RV32_HAS(GOLDFISH_RTC) */
 
     attr->vblk = calloc(attr->vblk_cnt, sizeof(virtio_blk_state_t *));
@@ -862,17 +929,15 @@ riscv_t *rv_create(riscv_user_t rv_attr)
     capture_keyboard_input();
 #endif /* !RV32_HAS(SYSTEM_MMIO) */
 
-    /* create block and IRs memory pool */
+    /* create block and fuse memory pools; IR arrays are allocated per block */
     rv->block_mp = mpool_create(sizeof(block_t) << BLOCK_MAP_CAPACITY_BITS,
                                 sizeof(block_t));
-    rv->block_ir_mp = mpool_create(
-        sizeof(rv_insn_t) << BLOCK_IR_MAP_CAPACITY_BITS, sizeof(rv_insn_t));
     /* Fuse pool: fixed-size slots for macro-op fusion arrays.
      * Each slot holds up to FUSE_MAX_ENTRIES opcode_fuse_t structures.
      */
     rv->fuse_mp = mpool_create(FUSE_SLOT_SIZE << BLOCK_IR_MAP_CAPACITY_BITS,
                                FUSE_SLOT_SIZE);
-    if (!rv->block_mp || !rv->block_ir_mp || !rv->fuse_mp) {
+    if (!rv->block_mp || !rv->fuse_mp) {
         rv_log_fatal("Failed to create memory pool");
         goto fail_mpool;
     }
@@ -941,7 +1006,6 @@ fail_block_cache:
 fail_jit_state:
 #endif
 fail_mpool:
-    mpool_destroy(rv->block_ir_mp);
     mpool_destroy(rv->block_mp);
     mpool_destroy(rv->fuse_mp);
 #if RV32_HAS(SYSTEM_MMIO)
@@ -1004,6 +1068,37 @@ void rv_debug(riscv_t *rv);
 
 void rv_profile(riscv_t *rv, char *out_file_path);
 
+/* Run with periodic detailed windows and dump their statistics */
+static void rv_run_sampled(riscv_t *rv);
+
+#if !RV32_HAS(SYSTEM)
+/* Run block by block and dump the dynamic instruction and register usage */
+static void rv_run_histogram(riscv_t *rv);
+#endif
+
+#if RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+/* Set asynchronously by SIGUSR1; the snapshot itself is taken between two
+ * rv_step() calls, where the hart state is fully written back.
+ */
+static volatile sig_atomic_t snapshot_requested;
+
+static void snapshot_signal_handler(int sig UNUSED)
+{
+    snapshot_requested = 1;
+}
+
+static void rv_snapshot_poll(riscv_t *rv)
+{
+    if (likely(!snapshot_requested))
+        return;
+    snapshot_requested = 0;
+
+    const char *path = PRIV(rv)->snapshot_output_file;
+    if (rv_snapshot_save(rv, path))
+        rv_log_info("Snapshot saved to %s", path);
+}
+#endif
+
 void rv_run(riscv_t *rv)
 {
     assert(rv);
@@ -1017,9 +1112,22 @@ void rv_run(riscv_t *rv)
 #endif
     );
 
-    if (!(attr->run_flag & (RV_RUN_TRACE | RV_RUN_GDBSTUB))) {
+    if (!(attr->run_flag &
+          (RV_RUN_TRACE | RV_RUN_GDBSTUB | RV_RUN_SAMPLE |
+           RV_RUN_HISTOGRAM))) {
 #ifdef __EMSCRIPTEN__
         emscripten_set_main_loop_arg(rv_step, (void *) rv, 0, 1);
+#elif RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+        if (attr->snapshot_output_file) {
+            signal(SIGUSR1, snapshot_signal_handler);
+            for (; !rv_has_halted(rv);) {
+                rv_step(rv);
+                rv_snapshot_poll(rv);
+            }
+        } else {
+            for (; !rv_has_halted(rv);) /* run until the flag is done */
+                rv_step(rv);            /* step instructions */
+        }
 #else
         /* default main loop */
         for (; !rv_has_halted(rv);) /* run until the flag is done */
@@ -1034,6 +1142,12 @@ void rv_run(riscv_t *rv)
     else if (attr->run_flag & RV_RUN_GDBSTUB)
         rv_debug(rv);
 #endif
+    else if (attr->run_flag & RV_RUN_SAMPLE)
+        rv_run_sampled(rv);
+#if !RV32_HAS(SYSTEM)
+    else if (attr->run_flag & RV_RUN_HISTOGRAM)
+        rv_run_histogram(rv);
+#endif
 
     if (attr->run_flag & RV_RUN_PROFILE) {
         assert(attr->profile_output_file);
@@ -1069,6 +1183,10 @@ void rv_delete(riscv_t *rv)
 #if !RV32_HAS(JIT) || (RV32_HAS(SYSTEM_MMIO))
     vm_attr_t *attr = PRIV(rv);
 #endif
+#if !RV32_HAS(SYSTEM)
+    if (rv->libc_calls)
+        map_delete(rv->libc_calls);
+#endif
 #if !RV32_HAS(JIT)
     map_delete(attr->fd_map);
     memory_delete(attr->mem);
@@ -1095,13 +1213,17 @@ void rv_delete(riscv_t *rv)
     pthread_cond_destroy(&rv->wait_queue_cond);
     jit_cache_exit(rv->jit_cache);
     inline_cache_exit(rv->inline_cache);
+    if (rv->t2c_funcs)
+        map_delete(rv->t2c_funcs);
 
     /* Dispose LLVM engines for all remaining blocks before freeing cache */
     clear_cache_hot(rv->block_cache, t2c_dispose_block_engine);
 #endif
     jit_state_exit(rv->jit_state);
+    block_t *block;
+    list_for_each_entry (block, &rv->block_list, list)
+        block_free_ir(rv, block);
     cache_free(rv->block_cache);
-    mpool_destroy(rv->block_ir_mp);
     mpool_destroy(rv->block_mp);
     mpool_destroy(rv->fuse_mp);
 #endif
@@ -1114,6 +1236,7 @@ void rv_delete(riscv_t *rv)
     /* sync device, cleanup inside the callee */
     rv_fsync_device();
 #endif
+    replay_delete(rv->replay);
     free(rv);
 }
 
@@ -1250,14 +1373,27 @@ void rv_reset(riscv_t *rv, riscv_word_t pc)
     /* reset the csrs */
     rv->csr_mtvec = 0;
     rv->csr_cycle = 0;
+    rv->csr_instret = 0;
 #if RV32_HAS(SYSTEM)
     rv->timer_offset = 0;
+#endif
+#if RV32_HAS(SYSTEM_MMIO)
+    rv->next_event = 0;
+    rv->next_poll = 0;
 #endif
     rv->csr_mstatus = 0;
     rv->csr_misa |= MISA_SUPER | MISA_USER;
     rv->csr_mvendorid = RV_MVENDORID;
     rv->csr_marchid = RV_MARCHID;
     rv->csr_mimpid = RV_MIMPID;
+    rv->csr_mcountinhibit = 0;
+    memset(rv->csr_mhpmevent, 0, sizeof(rv->csr_mhpmevent));
+    memset(rv->csr_mhpmcounter, 0, sizeof(rv->csr_mhpmcounter));
+    memset(rv->pmu_event, 0, sizeof(rv->pmu_event));
+    rv_pmu_rebase(rv);
+#if RV32_HAS(SYSTEM)
+    rv->sbi_pmu_used = 0;
+#endif
 #if !RV32_HAS(RV32E)
     rv->csr_misa |= MISA_I;
 #else
@@ -1372,3 +1508,506 @@ void rv_profile(riscv_t *rv, char *out_file_path)
     }
 #endif
 }
+
+static const uint8_t insn_len_table[] = {
+#define _(inst, can_branch, insn_len, translatable, reg_mask) \
+    [rv_insn_##inst] = insn_len,
+    RV_INSN_LIST
+#undef _
+};
+
+static const bool insn_can_branch_table[] = {
+#define _(inst, can_branch, insn_len, translatable, reg_mask) \
+    [rv_insn_##inst] = can_branch,
+    RV_INSN_LIST
+#undef _
+};
+
+static uint64_t pmu_event_count(riscv_t *rv, uint32_t event)
+{
+    switch (event) {
+    case PMU_EVENT_cycle:
+        return rv->csr_cycle;
+    case PMU_EVENT_instret:
+        return rv->csr_instret;
+    case PMU_EVENT_interp_insn:
+        return rv->csr_instret - rv->pmu_event[PMU_EVENT_jit_insn];
+    default:
+        /* unknown events never occur */
+        return event < N_PMU_EVENTS ? rv->pmu_event[event] : 0;
+    }
+}
+
+void rv_pmu_sync(riscv_t *rv)
+{
+    for (int i = PMU_HPM_FIRST; i < PMU_N_COUNTERS; i++) {
+        const uint64_t now = pmu_event_count(rv, rv->csr_mhpmevent[i]);
+        if (!(rv->csr_mcountinhibit & (1U << i)))
+            rv->csr_mhpmcounter[i] += now - rv->pmu_last[i];
+        rv->pmu_last[i] = now;
+    }
+}
+
+void rv_pmu_rebase(riscv_t *rv)
+{
+    rv->pmu_detailed = false;
+    for (int i = PMU_HPM_FIRST; i < PMU_N_COUNTERS; i++) {
+        const uint32_t event = rv->csr_mhpmevent[i];
+        rv->pmu_last[i] = pmu_event_count(rv, event);
+        if (!(rv->csr_mcountinhibit & (1U << i)) &&
+            event >= PMU_EVENT_branch && event <= PMU_EVENT_store)
+            rv->pmu_detailed = true;
+    }
+}
+
+typedef struct {
+    FILE *report; /**< per-window statistics and the final summary */
+    FILE *bbv;    /**< SimPoint basic block vectors, one line per window */
+    map_t bb_id;  /**< dynamic basic block start PC -> SimPoint id */
+    uint64_t *bb_count; /**< instructions per id in the current window */
+    uint32_t n_bb, bb_capacity;
+    uint64_t mix[N_RV_INSNS]; /**< instruction mix over all windows */
+    uint64_t insns, loads, stores, branches, taken;
+} sampler_t;
+
+static uint32_t sample_bb_lookup(sampler_t *s, uint32_t pc)
+{
+    map_iter_t it;
+    map_find(s->bb_id, &it, &pc);
+    if (!map_at_end(s->bb_id, &it))
+        return map_iter_value(&it, uint32_t);
+
+    if (s->n_bb == s->bb_capacity) {
+        uint32_t capacity = s->bb_capacity ? s->bb_capacity * 2 : 1024;
+        uint64_t *count = realloc(s->bb_count, capacity * sizeof(uint64_t));
+        if (!count)
+            return 0;
+        memset(count + s->bb_capacity, 0,
+               (capacity - s->bb_capacity) * sizeof(uint64_t));
+        s->bb_count = count;
+        s->bb_capacity = capacity;
+    }
+    /* SimPoint numbers basic blocks from 1 */
+    uint32_t id = ++s->n_bb;
+    map_insert(s->bb_id, &pc, &id);
+    return id;
+}
+
+/* Step the window one instruction at a time, so that every retired
+ * instruction is observed with its decoded form and its successor PC.
+ */
+static void sample_window(riscv_t *rv, sampler_t *s, uint64_t end)
+{
+    uint64_t start = rv->csr_instret;
+    uint64_t insns = 0, loads = 0, stores = 0, branches = 0, taken = 0;
+    bool bb_start = true;
+    uint32_t bb = 0;
+    rv_insn_t ir;
+
+    while (!rv_has_halted(rv) && rv->csr_instret < end) {
+        uint32_t pc = rv->PC;
+        if (!rv_step_insn(rv, &ir)) {
+            /* the fetch or decode trapped, resume at the handler */
+            bb_start = true;
+            continue;
+        }
+
+        if (bb_start) {
+            bb = sample_bb_lookup(s, pc);
+            bb_start = false;
+        }
+        if (bb)
+            s->bb_count[bb - 1]++;
+
+        insns++;
+        s->mix[ir.opcode]++;
+        int access = insn_mem_access(ir.opcode);
+        loads += !!(access & INSN_ACCESS_LOAD);
+        stores += !!(access & INSN_ACCESS_STORE);
+
+        bool sequential = rv->PC == pc + insn_len_table[ir.opcode];
+        if (insn_is_cond_branch(ir.opcode)) {
+            branches++;
+            taken += !sequential;
+        }
+        /* a control transfer or a trap ends the dynamic basic block */
+        if (insn_can_branch_table[ir.opcode] || !sequential)
+            bb_start = true;
+    }
+
+    fprintf(s->report, "%-12" PRIu64 " %-10" PRIu64 " %-10" PRIu64
+            " %-10" PRIu64 " %-10" PRIu64 " %-10" PRIu64 "\n",
+            start, insns, loads, stores, branches, taken);
+
+    fprintf(s->bbv, "T");
+    for (uint32_t i = 0; i < s->n_bb; i++) {
+        if (!s->bb_count[i])
+            continue;
+        fprintf(s->bbv, ":%" PRIu32 ":%" PRIu64 " ", i + 1, s->bb_count[i]);
+        s->bb_count[i] = 0;
+    }
+    fprintf(s->bbv, "\n");
+
+    s->insns += insns;
+    s->loads += loads;
+    s->stores += stores;
+    s->branches += branches;
+    s->taken += taken;
+}
+
+static void sample_summary(sampler_t *s)
+{
+    fprintf(s->report,
+            "\n# sampled %" PRIu64 " instructions in %" PRIu32
+            " distinct basic blocks\n",
+            s->insns, s->n_bb);
+    if (!s->insns)
+        return;
+    fprintf(s->report, "# loads %.2f%%, stores %.2f%%",
+            100.0 * s->loads / s->insns, 100.0 * s->stores / s->insns);
+    if (s->branches)
+        fprintf(s->report, ", branches %.2f%% (%.2f%% taken)",
+                100.0 * s->branches / s->insns,
+                100.0 * s->taken / s->branches);
+    fprintf(s->report, "\n\n%-12s| count      | ratio\n", "instruction");
+    for (int i = 0; i < N_RV_INSNS; i++) {
+        if (!s->mix[i])
+            continue;
+        fprintf(s->report, "%-12s| %-10" PRIu64 " | %.2f%%\n",
+                insn_name_table[i], s->mix[i], 100.0 * s->mix[i] / s->insns);
+    }
+}
+
+static void rv_run_sampled(riscv_t *rv)
+{
+    vm_attr_t *attr = PRIV(rv);
+    assert(attr->sample_output_file);
+    assert(attr->sample_window && attr->sample_window <= attr->sample_interval);
+
+    sampler_t *s = calloc(1, sizeof(sampler_t));
+    if (!s) {
+        rv_log_error("Failed to allocate the sampler");
+        return;
+    }
+
+    const char *path = attr->sample_output_file;
+    size_t len = strlen(path) + sizeof(".bb");
+    char *bbv_path = malloc(len);
+    if (bbv_path)
+        snprintf(bbv_path, len, "%s.bb", path);
+    s->report = fopen(path, "w");
+    s->bbv = bbv_path ? fopen(bbv_path, "w") : NULL;
+    s->bb_id = map_init(uint32_t, uint32_t, map_cmp_uint);
+    if (!s->report || !s->bbv || !s->bb_id) {
+        rv_log_error("Cannot open sampling output file %s", path);
+        goto end;
+    }
+
+    fprintf(s->report, "%-12s %-10s %-10s %-10s %-10s %-10s\n", "# start",
+            "insns", "loads", "stores", "branches", "taken");
+
+    const int cycle_per_step = attr->cycle_per_step;
+    uint64_t interval_start = rv->csr_instret;
+    while (!rv_has_halted(rv)) {
+        sample_window(rv, s, interval_start + attr->sample_window);
+
+        /* fast-forward through the tiered engines up to the next window */
+        interval_start += attr->sample_interval;
+        while (!rv_has_halted(rv) && rv->csr_instret < interval_start) {
+            uint64_t remain = interval_start - rv->csr_instret;
+            attr->cycle_per_step =
+                remain < (uint64_t) cycle_per_step ? (int) remain
+                                                   : cycle_per_step;
+            rv_step(rv);
+        }
+        attr->cycle_per_step = cycle_per_step;
+        /* a block may run past the boundary, so realign on the next one */
+        if (rv->csr_instret > interval_start)
+            interval_start = rv->csr_instret;
+    }
+
+    sample_summary(s);
+    rv_log_info("Sampling data saved to %s and %s", path, bbv_path);
+
+end:
+    if (s->bb_id)
+        map_delete(s->bb_id);
+    if (s->bbv)
+        fclose(s->bbv);
+    if (s->report)
+        fclose(s->report);
+    free(bbv_path);
+    free(s->bb_count);
+    free(s);
+}
+
+#if !RV32_HAS(SYSTEM)
+/* Dynamic histograms are collected at block granularity: each execution of a
+ * block only bumps its count, and the static mix recorded the first time the
+ * block runs is weighted by that count when the histograms are printed.
+ */
+#define HIST_RECENT_BITS 12
+#define HIST_BAR_COLS 40
+
+static const uint8_t insn_reg_mask_table[] = {
+#define _(inst, can_branch, insn_len, translatable, reg_mask) \
+    [rv_insn_##inst] = reg_mask,
+    RV_INSN_LIST
+#undef _
+};
+
+static const char *reg_name_table[] = {
+#define _(reg) #reg,
+    RV_REGS_LIST
+#undef _
+};
+
+typedef struct {
+    uint8_t opcode, rd, rs1, rs2, rs3;
+} hist_insn_t;
+
+typedef struct {
+    uint64_t count;        /**< executions of the block */
+    uint32_t insn, n_insn; /**< guest instructions, in histogram_t.insns */
+    uint32_t op, n_op;     /**< IR opcodes after fusion, in histogram_t.ops */
+} hist_block_t;
+
+typedef struct {
+    map_t block_id; /**< block start PC -> index into blocks plus one */
+    struct {
+        uint32_t pc, id;
+    } recent[1 << HIST_RECENT_BITS]; /**< direct-mapped front of block_id */
+    hist_block_t *blocks;
+    hist_insn_t *insns;
+    uint8_t *ops;
+    uint32_t n_block, n_insn, n_op;
+    uint32_t block_capacity, insn_capacity, op_capacity;
+} histogram_t;
+
+typedef struct {
+    const char *name;
+    uint64_t freq;
+} hist_entry_t;
+
+/* make room for @n elements of @size bytes in @buf */
+static bool hist_reserve(void *buf, uint32_t *capacity, uint32_t n, size_t size)
+{
+    if (n <= *capacity)
+        return true;
+    uint32_t new_capacity = *capacity ? *capacity * 2 : 1024;
+    while (new_capacity < n)
+        new_capacity *= 2;
+    void *p = realloc(*(void **) buf, new_capacity * size);
+    if (!p)
+        return false;
+    *(void **) buf = p;
+    *capacity = new_capacity;
+    return true;
+}
+
+/* Record the static mix of a block the first time it runs. The IR may have
+ * been fused, so the guest instructions are decoded again for the unfused
+ * mix and the register operands. Return the id of the block, or 0.
+ */
+static uint32_t hist_record(histogram_t *h, riscv_t *rv, const block_t *block)
+{
+    if (!hist_reserve(&h->blocks, &h->block_capacity, h->n_block + 1,
+                      sizeof(hist_block_t)))
+        return 0;
+    hist_block_t *b = &h->blocks[h->n_block];
+    b->count = 0;
+    b->insn = h->n_insn;
+    b->op = h->n_op;
+
+    /* a routine run on the host retires no guest instruction */
+    const bool libcall = block->ir_head->opcode == rv_insn_libcall;
+    for (uint32_t pc = block->pc_start; !libcall && pc < block->pc_end;) {
+        rv_insn_t ir;
+        memset(&ir, 0, sizeof(rv_insn_t));
+        uint32_t insn = rv->io.mem_ifetch(rv, pc);
+        if (!insn || !rv_decode(&ir, insn))
+            break;
+        if (!hist_reserve(&h->insns, &h->insn_capacity, h->n_insn + 1,
+                          sizeof(hist_insn_t)))
+            return 0;
+        h->insns[h->n_insn++] = (hist_insn_t) {
+            .opcode = ir.opcode,
+            .rd = ir.rd,
+            .rs1 = ir.rs1,
+            .rs2 = ir.rs2,
+            .rs3 = ir.rs3,
+        };
+        pc += insn_len_table[ir.opcode];
+    }
+    for (const rv_insn_t *ir = block->ir_head; ir; ir = ir->next) {
+        if (!hist_reserve(&h->ops, &h->op_capacity, h->n_op + 1,
+                          sizeof(uint8_t)))
+            return 0;
+        h->ops[h->n_op++] = ir->opcode;
+    }
+    b->n_insn = h->n_insn - b->insn;
+    b->n_op = h->n_op - b->op;
+
+    uint32_t id = ++h->n_block;
+    map_insert(h->block_id, &block->pc_start, &id);
+    return id;
+}
+
+static hist_block_t *hist_lookup(histogram_t *h,
+                                 riscv_t *rv,
+                                 const block_t *block)
+{
+    const uint32_t pc = block->pc_start;
+    const uint32_t slot = (pc >> 1) & ((1 << HIST_RECENT_BITS) - 1);
+    uint32_t id = h->recent[slot].id;
+    if (likely(id && h->recent[slot].pc == pc))
+        return &h->blocks[id - 1];
+
+    map_iter_t it;
+    map_find(h->block_id, &it, &pc);
+    id = !map_at_end(h->block_id, &it) ? map_iter_value(&it, uint32_t)
+                                       : hist_record(h, rv, block);
+    if (!id)
+        return NULL;
+    h->recent[slot].pc = pc;
+    h->recent[slot].id = id;
+    return &h->blocks[id - 1];
+}
+
+static int hist_cmp(const void *a, const void *b)
+{
+    const uint64_t a_freq = ((const hist_entry_t *) a)->freq;
+    const uint64_t b_freq = ((const hist_entry_t *) b)->freq;
+    return (a_freq < b_freq) - (a_freq > b_freq);
+}
+
+/* print in the format of tools/rv_histogram, in descending order */
+static void hist_print(FILE *f,
+                       const char *title,
+                       hist_entry_t *entries,
+                       size_t n)
+{
+    qsort(entries, n, sizeof(hist_entry_t), hist_cmp);
+    uint64_t total = 0;
+    for (size_t i = 0; i < n; i++)
+        total += entries[i].freq;
+
+    const int width = strlen(title) + 2;
+    fprintf(f, "+%.*s+\n", width,
+            "------------------------------------------------------------");
+    fprintf(f, "| %s |\n", title);
+    fprintf(f, "+%.*s+\n", width,
+            "------------------------------------------------------------");
+    if (!total)
+        return;
+
+    static const char *const glyphs[] = {"",  "▏", "▎", "▍", "▌",
+                                         "▋", "▊", "▉", "█"};
+    for (size_t i = 0; i < n; i++) {
+        const double percent = 100.0 * entries[i].freq / total;
+        if (percent < 1.00)
+            break;
+
+        char bar[HIST_BAR_COLS * 3 + 1] = {0};
+        size_t units = entries[i].freq * HIST_BAR_COLS * 8 / entries[0].freq;
+        for (; units >= 8; units -= 8)
+            strcat(bar, glyphs[8]);
+        strcat(bar, glyphs[units]);
+        fprintf(f, "%3zu. %-10s%5.2f%% [%-10" PRIu64 "] %s\n", i + 1,
+                entries[i].name, percent, entries[i].freq, bar);
+    }
+}
+
+static void hist_dump(histogram_t *h, FILE *f)
+{
+    hist_entry_t insns[N_RV_INSNS], ops[ARRAY_SIZE(insn_name_table)];
+    hist_entry_t reads[N_RV_REGS], writes[N_RV_REGS];
+    for (size_t i = 0; i < ARRAY_SIZE(insn_name_table); i++) {
+        ops[i] = (hist_entry_t) {insn_name_table[i], 0};
+        if (i < N_RV_INSNS)
+            insns[i] = (hist_entry_t) {insn_name_table[i], 0};
+    }
+    for (int i = 0; i < N_RV_REGS; i++) {
+        reads[i] = (hist_entry_t) {reg_name_table[i], 0};
+        writes[i] = (hist_entry_t) {reg_name_table[i], 0};
+    }
+
+    uint64_t n_insn = 0, n_op = 0;
+    for (uint32_t i = 0; i < h->n_block; i++) {
+        const hist_block_t *b = &h->blocks[i];
+        for (uint32_t j = 0; j < b->n_op; j++)
+            ops[h->ops[b->op + j]].freq += b->count;
+        for (uint32_t j = 0; j < b->n_insn; j++) {
+            const hist_insn_t *insn = &h->insns[b->insn + j];
+            const uint8_t reg_mask = insn_reg_mask_table[insn->opcode];
+            insns[insn->opcode].freq += b->count;
+            /* as in tools/rv_histogram, floating-point operands are counted
+             * under the integer register of the same number
+             */
+            if ((reg_mask & F_rs1) && insn->rs1 < N_RV_REGS)
+                reads[insn->rs1].freq += b->count;
+            if ((reg_mask & F_rs2) && insn->rs2 < N_RV_REGS)
+                reads[insn->rs2].freq += b->count;
+            if ((reg_mask & F_rs3) && insn->rs3 < N_RV_REGS)
+                reads[insn->rs3].freq += b->count;
+            if ((reg_mask & F_rd) && insn->rd < N_RV_REGS)
+                writes[insn->rd].freq += b->count;
+        }
+        n_insn += b->count * b->n_insn;
+        n_op += b->count * b->n_op;
+    }
+
+    fprintf(f,
+            "# %" PRIu64 " instructions in %" PRIu32
+            " distinct blocks, executed as %" PRIu64 " operations\n\n",
+            n_insn, h->n_block, n_op);
+    hist_print(f, "RV32 Target Instruction Frequency Histogram", insns,
+               ARRAY_SIZE(insns));
+    fprintf(f, "\n");
+    hist_print(f, "RV32 Fused Operation Frequency Histogram", ops,
+               ARRAY_SIZE(ops));
+    fprintf(f, "\n");
+    hist_print(f, "RV32 Target Register Read Histogram", reads,
+               ARRAY_SIZE(reads));
+    fprintf(f, "\n");
+    hist_print(f, "RV32 Target Register Write Histogram", writes,
+               ARRAY_SIZE(writes));
+}
+
+static void rv_run_histogram(riscv_t *rv)
+{
+    const char *path = PRIV(rv)->histogram_output_file;
+    assert(path);
+
+    histogram_t *h = calloc(1, sizeof(histogram_t));
+    if (!h || !(h->block_id = map_init(uint32_t, uint32_t, map_cmp_uint))) {
+        rv_log_error("Failed to allocate the histogram");
+        free(h);
+        return;
+    }
+
+    while (!rv_has_halted(rv)) {
+        const block_t *block = rv_step_block(rv);
+        if (!block)
+            continue;
+        hist_block_t *b = hist_lookup(h, rv, block);
+        if (b)
+            b->count++;
+    }
+
+    FILE *f = strcmp(path, "-") ? fopen(path, "w") : stdout;
+    if (f) {
+        hist_dump(h, f);
+        if (f != stdout)
+            fclose(f);
+    } else {
+        rv_log_error("Cannot open histogram output file %s", path);
+    }
+
+    map_delete(h->block_id);
+    free(h->blocks);
+    free(h->insns);
+    free(h->ops);
+    free(h);
+}
+#endif
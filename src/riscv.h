@@ -257,6 +257,9 @@ enum TRAP_CODE {
  */
 #define SBI_SUCCESS 0
 #define SBI_ERR_NOT_SUPPORTED -2
+#define SBI_ERR_INVALID_PARAM -3
+#define SBI_ERR_ALREADY_STARTED -7
+#define SBI_ERR_ALREADY_STOPPED -8
 
 /*
  * All of the functions in the base extension must be supported by
@@ -279,6 +282,15 @@ enum TRAP_CODE {
 #define SBI_EID_RST 0x53525354
 #define SBI_RST_SYSTEM_RESET 0
 
+/* Lets the supervisor, e.g. Linux perf, program the performance counters. */
+#define SBI_EID_PMU 0x504D55
+#define SBI_PMU_NUM_COUNTERS 0
+#define SBI_PMU_COUNTER_GET_INFO 1
+#define SBI_PMU_COUNTER_CFG_MATCH 2
+#define SBI_PMU_COUNTER_START 3
+#define SBI_PMU_COUNTER_STOP 4
+#define SBI_PMU_COUNTER_FW_READ 5
+
 #define BLOCK_MAP_CAPACITY_BITS 10
 
 /* forward declaration for internal structure */
@@ -346,6 +358,9 @@ typedef void (*riscv_on_ecall)(riscv_t *rv);
 typedef void (*riscv_on_ebreak)(riscv_t *rv);
 typedef void (*riscv_on_memset)(riscv_t *rv);
 typedef void (*riscv_on_memcpy)(riscv_t *rv);
+typedef void (*riscv_on_memmove)(riscv_t *rv);
+typedef void (*riscv_on_memcmp)(riscv_t *rv);
+typedef void (*riscv_on_strlen)(riscv_t *rv);
 typedef void (*riscv_on_trap)(riscv_t *rv);
 /* RISC-V emulator I/O interface */
 typedef struct {
@@ -377,6 +392,9 @@ typedef struct {
     riscv_on_ebreak on_ebreak;
     riscv_on_memset on_memset;
     riscv_on_memcpy on_memcpy;
+    riscv_on_memmove on_memmove;
+    riscv_on_memcmp on_memcmp;
+    riscv_on_strlen on_strlen;
     riscv_on_trap on_trap;
 } riscv_io_t;
 
@@ -392,6 +410,16 @@ void rv_delete(riscv_t *rv);
 /* reset the RISC-V processor */
 void rv_reset(riscv_t *rv, riscv_word_t pc);
 
+#if !RV32_HAS(SYSTEM)
+/* translate up to @max_blocks blocks statically reachable from @pc, without
+ * leaving [@pc, @end) or running any of them. Returns the blocks translated.
+ */
+uint32_t rv_translate_ahead(riscv_t *rv,
+                            riscv_word_t pc,
+                            riscv_word_t end,
+                            uint32_t max_blocks);
+#endif
+
 #if RV32_HAS(GDBSTUB)
 /* Run the RISC-V emulator as gdbstub */
 void rv_debug(riscv_t *rv);
@@ -438,6 +466,15 @@ void memset_handler(riscv_t *rv);
 /* memcpy handler */
 void memcpy_handler(riscv_t *rv);
 
+/* memmove handler */
+void memmove_handler(riscv_t *rv);
+
+/* memcmp handler */
+void memcmp_handler(riscv_t *rv);
+
+/* strlen handler */
+void strlen_handler(riscv_t *rv);
+
 /* dump registers as JSON to out_file_path */
 void dump_registers(riscv_t *rv, char *out_file_path);
 
@@ -461,6 +498,14 @@ void rv_halt(riscv_t *rv);
 /* return the halt state */
 bool rv_has_halted(riscv_t *rv);
 
+#if RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+/* save the hart, device and guest RAM state to a snapshot file */
+bool rv_snapshot_save(riscv_t *rv, const char *path);
+
+/* restore a snapshot into a freshly created emulator, before rv_run() */
+bool rv_snapshot_restore(riscv_t *rv, const char *path);
+#endif
+
 #if RV32_HAS(ARCH_TEST)
 /* Set tohost/fromhost addresses for architectural testing */
 void rv_set_tohost_addr(riscv_t *rv, uint32_t addr);
@@ -485,6 +530,14 @@ enum {
     /* run and profile relationship of blocks and save to prof_output_file
        during emulation */
     RV_RUN_PROFILE = 4,
+
+    /* alternate fast-forward execution with detailed sampling windows and
+       save the window statistics to sample_output_file */
+    RV_RUN_SAMPLE = 8,
+
+    /* run block by block in the interpreter and save the dynamic instruction
+       and register histograms to histogram_output_file */
+    RV_RUN_HISTOGRAM = 16,
 };
 
 typedef struct {
@@ -542,6 +595,14 @@ typedef struct {
      */
     uint64_t mem_size;
 
+    /* host backing of guest RAM, demand paging by default */
+    memory_backing_t mem_backing;
+
+    /* milliseconds between memory GC steps on a background thread, or 0 to
+     * run them from the emulation loop
+     */
+    uint32_t mem_gc_interval;
+
     /* vm main stack size */
     uint32_t stack_size;
 
@@ -575,14 +636,69 @@ typedef struct {
     /* allow misaligned memory access */
     bool allow_misalign;
 
+    /* run the guest's memcpy, memset, memmove, memcmp and strlen, found by
+     * their ELF symbols, as host routines (user mode only)
+     */
+    bool accel_libc;
+
+#if RV32_HAS(T2C)
+    /* LLVM optimization level (0-3) of tier-2 code. Above O1, a block is first
+     * compiled by a quick O1 tier and recompiled at this level once it stays
+     * hot.
+     */
+    int t2c_opt_level;
+
+    /* directory caching the optimized tier-2 code across runs, or NULL */
+    char *t2c_cache_dir;
+#endif
+
     /* run flag, it is the bitwise OR from
-     * RV_RUN_TRACE, RV_RUN_GDBSTUB, and RV_RUN_PROFILE
+     * RV_RUN_TRACE, RV_RUN_GDBSTUB, RV_RUN_PROFILE, RV_RUN_SAMPLE, and
+     * RV_RUN_HISTOGRAM
      */
     uint8_t run_flag;
 
     /* profiling output file if RV_RUN_PROFILE is set in run_flag */
     char *profile_output_file;
 
+    /* sampling report if RV_RUN_SAMPLE is set in run_flag. The basic block
+     * vectors of the windows go to the same path with a ".bb" suffix.
+     */
+    char *sample_output_file;
+
+    /* instructions per sampling interval, the first sample_window of which
+     * are stepped one at a time while the rest is fast-forwarded
+     */
+    uint64_t sample_interval;
+    uint64_t sample_window;
+
+    /* histogram output file, or "-" for stdout, if RV_RUN_HISTOGRAM is set
+     * in run_flag
+     */
+    char *histogram_output_file;
+
+    /* name of the timing model that sets the cycles of each instruction, or
+     * NULL for one instruction per cycle
+     */
+    const char *timing_model;
+
+    /* core clock in MHz, which sets the rate of the time CSR against cycle.
+     * 0 keeps the host time in user mode and one timer tick per cycle in
+     * system mode.
+     */
+    uint32_t clock_mhz;
+
+#if RV32_HAS(SYSTEM_MMIO)
+    /* snapshot file written whenever the emulator receives SIGUSR1 */
+    char *snapshot_output_file;
+#endif
+
+    /* log file the nondeterministic inputs of the run are recorded into, and
+     * log file they are replayed from, or NULL
+     */
+    char *record_output_file;
+    char *replay_input_file;
+
     /* set by rv_create during initialization.
      * use rv_remap_stdstream to overwrite them
      */
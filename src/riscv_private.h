@@ -12,6 +12,7 @@
 #include "mini-gdbstub/include/gdbstub.h"
 #endif
 #include "decode.h"
+#include "replay.h"
 #include "riscv.h"
 #include "utils.h"
 #if RV32_HAS(JIT)
@@ -23,6 +24,22 @@
 
 #define PRIV(x) ((vm_attr_t *) x->data)
 
+/* Guest libc routines that vm_attr_t::accel_libc runs on the host. Each one
+ * is found by its ELF symbol and handled by riscv_io_t::on_<name>.
+ */
+#define LIBCALL_LIST \
+    _(memcpy)        \
+    _(memset)        \
+    _(memmove)       \
+    _(memcmp)        \
+    _(strlen)
+
+enum {
+#define _(func) libcall_##func,
+    LIBCALL_LIST
+#undef _
+};
+
 /* Maximum entries per fuse slot - limits fusion to 16 consecutive instructions.
  * Larger sequences are rare and provide diminishing returns.
  */
@@ -83,8 +100,95 @@ enum {
     CSR_CYCLEH = 0xC80,
     CSR_TIMEH = 0xC81,
     CSR_INSTRETH = 0xC82,
+
+    /* Hardware performance monitor (Zihpm) */
+    CSR_MCOUNTINHIBIT = 0x320, /* Machine counter-inhibit register */
+    CSR_MHPMEVENT3 = 0x323,    /* Machine performance-monitoring event */
+    CSR_MHPMEVENT31 = 0x33F,
+    CSR_MHPMCOUNTER3 = 0xB03, /* Machine performance-monitoring counter */
+    CSR_MHPMCOUNTER31 = 0xB1F,
+    CSR_MHPMCOUNTER3H = 0xB83,
+    CSR_MHPMCOUNTER31H = 0xB9F,
+    CSR_HPMCOUNTER3 = 0xC03, /* Performance-monitoring counter */
+    CSR_HPMCOUNTER31 = 0xC1F,
+    CSR_HPMCOUNTER3H = 0xC83,
+    CSR_HPMCOUNTER31H = 0xC9F,
+};
+
+/* Emulator events that mhpmevent3..31 select, numbered from 1 in this order.
+ * Branches, loads and stores are counted per block from the decoded IR, and
+ * rv_step() charges them after each block it runs.
+ */
+#define PMU_EVENT_LIST                                              \
+    _(cycle)        /* same as the cycle CSR */                     \
+    _(instret)      /* same as the instret CSR */                   \
+    _(branch)       /* conditional branches */                      \
+    _(branch_taken) /* taken conditional branches */                \
+    _(load)         /* loads, including LR and AMOs */              \
+    _(store)        /* stores, including SC and AMOs */             \
+    _(itlb_miss)    /* iTLB refills after a page walk */            \
+    _(dtlb_miss)    /* dTLB refills after a page walk */            \
+    _(block_miss)   /* blocks translated on a block cache miss */   \
+    _(interp_insn)  /* instructions retired by the interpreter */   \
+    _(jit_insn)     /* instructions retired by JIT-compiled code */
+
+enum {
+    PMU_EVENT_none,
+#define _(event) PMU_EVENT_##event,
+    PMU_EVENT_LIST
+#undef _
+    N_PMU_EVENTS
 };
 
+/* mhpmcounter3..31 follow cycle, time and instret */
+#define PMU_HPM_FIRST 3
+#define PMU_N_COUNTERS 32
+
+/* Instruction classes whose cycles a timing model sets */
+#define TIMING_CLASS_LIST                                         \
+    _(alu)           /* integer and bit-manipulation arithmetic */ \
+    _(mul)           /* multiplications */                         \
+    _(div)           /* divisions and remainders */                \
+    _(load)          /* integer and floating-point loads */        \
+    _(store)         /* integer and floating-point stores */       \
+    _(branch)        /* conditional branches */                    \
+    _(jump)          /* direct jumps */                            \
+    _(jump_indirect) /* jumps through a register */                \
+    _(amo)           /* LR, SC and AMOs */                         \
+    _(csr)           /* CSR accesses */                            \
+    _(fence)         /* FENCE, FENCE.I and SFENCE.VMA */           \
+    _(system)        /* ECALL, EBREAK, WFI and trap returns */     \
+    _(fp)            /* other floating-point operations */         \
+    _(fp_mul)        /* floating-point multiplies and FMAs */      \
+    _(fp_div)        /* floating-point divisions and square roots */
+
+enum {
+#define _(cls) TIMING_##cls,
+    TIMING_CLASS_LIST
+#undef _
+    N_TIMING_CLASSES
+};
+
+/* A timing model sets the cycles that cycle and time advance by, while
+ * instret keeps counting instructions.
+ */
+typedef struct {
+    const char *name;
+    uint8_t latency[N_TIMING_CLASSES]; /**< cycles of each class */
+    uint8_t load_use; /**< stall of an instruction that reads the result of
+                           the load right before it */
+    uint8_t taken;    /**< fetch bubble after a jump or a branch assumed
+                           taken */
+} timing_model_t;
+
+/* timebase-frequency of the device tree, in MHz */
+#define TIMEBASE_MHZ 65
+
+/* the timing model of the given name, the ideal one for NULL, or NULL if
+ * there is no such model
+ */
+const timing_model_t *timing_model_find(const char *name);
+
 /* Lazy fusion candidate for memory operations in SYSTEM_MMIO mode.
  * At decode time, consecutive LW/SW sequences are marked as candidates.
  * During first execution, addresses are verified as RAM (not MMIO).
@@ -107,8 +211,11 @@ typedef struct block {
     uint32_t n_insn;           /**< number of instructions encompassed */
     uint32_t pc_start, pc_end; /**< address range of the basic block */
     uint32_t cycle_cost;       /**< cycle cost for block-level counting */
+    uint32_t n_retired;        /**< guest instructions the block retires */
+    uint16_t n_load, n_store;  /**< memory accesses for the PMU events */
+    bool cond_branch;          /**< ends with a conditional branch */
 
-    rv_insn_t *ir_head, *ir_tail; /**< the first and last ir for this block */
+    rv_insn_t *ir_head, *ir_tail; /**< bounds of the contiguous IR array */
 
 #if RV32_HAS(BLOCK_CHAINING)
     bool page_terminated; /**< Block ended at page boundary (not a branch) */
@@ -125,21 +232,27 @@ typedef struct block {
     bool hot2;         /**< Determine the block is strong hotspot or not */
     bool translatable; /**< Determine the block has RV32AF or not */
     bool has_loops;    /**< Determine the block has loop or not */
+    bool invalidated;  /**< Block invalidated by SFENCE.VMA, FENCE.I or
+                        * rv_invalidate_blocks(), needs recompilation
+                        */
 #if RV32_HAS(SYSTEM)
     uint32_t satp;
-    bool invalidated; /**< Block invalidated by SFENCE.VMA, needs recompilation
-                       */
 #endif
 #if RV32_HAS(T2C)
     bool compiled;     /**< The T2C request is enqueued or not */
     bool is_compiling; /**< T2C thread is currently processing this block */
     bool should_free;  /**< Block was evicted while compiling, freed by T2C */
+    bool requeued;     /**< The T2C recompilation request is enqueued or not */
+    bool recompiled;   /**< Recompiled code not yet seen by inline caches */
 #endif
     uint32_t offset;   /**< The machine code offset in T1 code cache */
     uint32_t n_invoke; /**< The invoking times of T1 machine code */
     void *func;        /**< The function pointer of T2 machine code */
 #if RV32_HAS(T2C)
     void *llvm_engine; /**< LLVM execution engine (keeps func memory alive) */
+    void *llvm_engine_quick; /**< Replaced quick-tier engine, still reachable
+                              * through inline caches */
+    void *t2c_profile; /**< Counters updated by the quick-tier T2C code */
 #endif
     struct list_head list;
 #endif
@@ -163,19 +276,28 @@ typedef struct {
  * - Each entry caches: VPN, PPN, permissions, and page level
  * - Separate dTLB (data) and iTLB (instruction) for better hit rates
  * - Superpages tracked via level field for selective SFENCE.VMA
+ * - dTLB entries whose frame lies in guest RAM are tagged at fill time, so a
+ *   hit becomes a plain host access without MMIO or bounds checks
  * - Invalidated on SFENCE.VMA or SATP changes
  */
 #define TLB_SIZE 64
 #define TLB_MASK (TLB_SIZE - 1)
 
+/* Software bit in tlb_entry_t.perm, in the position of PTE_V which is never
+ * cached: the frame and the 3 bytes after it are guest RAM, so any access of
+ * at most 4 bytes starting in the page can use the host mapping directly.
+ */
+#define TLB_PERM_RAM (1U << 0)
+
 /* Sv32 page levels: 1 = 4MB superpage, 2 = 4KB page */
 #define TLB_PAGE_LEVEL_SUPER 1
 #define TLB_PAGE_LEVEL_4K 2
 
 typedef struct {
-    uint32_t vpn, ppn; /* Virtual/Physical page number (upper 20 bits of VA) */
+    uint32_t vpn;      /* Virtual page number (upper 20 bits of VA) */
+    uint32_t ppn;      /* Physical address of the 4 KiB frame backing vpn */
     uint32_t pte_addr; /* Physical address of PTE for A/D bit updates */
-    uint8_t perm;      /* Permission bits: R(1), W(2), X(4), U(16) */
+    uint8_t perm;      /* Permission bits: R(2), W(4), X(8), U(16), RAM */
     uint8_t valid;     /* Entry validity flag */
     uint8_t dirty;     /* Cached dirty bit state (avoid repeated PTE writes) */
     uint8_t level;     /* Page level: 1=superpage (4MB), 2=4KB page */
@@ -229,9 +351,46 @@ typedef struct {
     block_t *ptrs[BLOCK_L1_SIZE]; /**< block pointers, loaded on tag hit */
 } block_l1_cache_t;
 
+/* release the IR array of a block */
+void block_free_ir(riscv_t *rv, block_t *block);
+
 /* clear all block in the block map */
 void block_map_clear(riscv_t *rv);
 
+/* Drop the translated blocks, their machine code and the chaining state once
+ * guest memory was replaced or written underneath them.
+ */
+void rv_invalidate_blocks(riscv_t *rv);
+
+/* fetch, decode and execute the instruction at the current PC, leaving the
+ * decoded form in ir. Return false if no instruction retired because the
+ * fetch or decode trapped.
+ */
+bool rv_step_insn(riscv_t *rv, rv_insn_t *ir);
+
+#if RV32_HAS(GDBSTUB)
+/* Point the translated IRs of the instruction at @addr to the breakpoint
+ * handler if @set, or back to their own handlers otherwise.
+ */
+void breakpoint_patch(riscv_t *rv, riscv_word_t addr, bool set);
+#endif
+
+/* bring mhpmcounter3..31 up to date with the events they count */
+void rv_pmu_sync(riscv_t *rv);
+
+/* restart mhpmcounter3..31 from the current event counts after mhpmevent or
+ * mcountinhibit changed
+ */
+void rv_pmu_rebase(riscv_t *rv);
+
+#if !RV32_HAS(SYSTEM)
+/* find or translate the block at the current PC and interpret it without
+ * chaining into its successors. Return the block, valid until the next call,
+ * or NULL if it did not run to its end.
+ */
+const block_t *rv_step_block(riscv_t *rv);
+#endif
+
 struct riscv_internal {
     bool halt; /**< indicate whether the core is halted */
 
@@ -281,6 +440,7 @@ struct riscv_internal {
 
     /* csr registers */
     uint64_t csr_cycle;     /* Machine cycle counter */
+    uint64_t csr_instret;   /* Instructions-retired counter */
     uint32_t csr_time[2];   /* Performance counter */
     uint32_t csr_mstatus;   /* Machine status register */
     uint32_t csr_mtvec;     /* Machine trap-handler base address */
@@ -309,9 +469,32 @@ struct riscv_internal {
     uint32_t csr_stval;      /* supervisor trap value register */
     uint32_t csr_satp;       /* supervisor address translation and protection */
 
+    /* mhpmcounter3..31 add the growth of the event chosen by their mhpmevent
+     * since pmu_last whenever a PMU CSR is accessed, so running counters
+     * cost nothing until they are read. Index 0 to 2 are unused.
+     */
+    uint32_t csr_mcountinhibit;
+    uint32_t csr_mhpmevent[PMU_N_COUNTERS];
+    uint64_t csr_mhpmcounter[PMU_N_COUNTERS];
+    uint64_t pmu_last[PMU_N_COUNTERS];
+    uint64_t pmu_event[N_PMU_EVENTS]; /**< occurrences of each PMU_EVENT_* */
+    bool pmu_detailed; /**< an enabled counter selects a per-block event */
+
+    const timing_model_t *timing; /**< cycles charged per instruction */
+
+    /* log of the nondeterministic inputs, NULL unless recording or replaying */
+    replay_t *replay;
+#if RV32_HAS(SYSTEM)
+    uint32_t sbi_pmu_used; /**< counters handed out by the SBI PMU extension */
+#endif
+
     uint32_t priv_mode; /* U-mode or S-mode or M-mode */
 
     bool compressed; /**< current instruction is compressed or not */
+#if !RV32_HAS(SYSTEM)
+    map_t libc_calls; /**< entry address to libcall_* of the guest libc
+                       * routines run on the host, NULL unless enabled */
+#endif
 #if !RV32_HAS(JIT)
     block_map_t block_map; /**< basic block map (fallback on L1 miss) */
 #else
@@ -322,6 +505,8 @@ struct riscv_internal {
     pthread_mutex_t wait_queue_lock, cache_lock;
     pthread_cond_t wait_queue_cond;
     bool quit; /**< termination flag, protected by wait_queue_lock */
+    map_t t2c_funcs; /**< entry address to size of the guest functions, from
+                      * the ELF symbols; read-only once initialized */
 #endif
     void *jit_state;
     void *jit_cache;
@@ -329,7 +514,7 @@ struct riscv_internal {
     void *inline_cache; /* Inline cache for fast indirect jump resolution */
 #endif
 #endif
-    struct mpool *block_mp, *block_ir_mp, *fuse_mp;
+    struct mpool *block_mp, *fuse_mp;
 
 #if RV32_HAS(GDBSTUB)
     /* gdbstub instance */
@@ -340,6 +525,15 @@ struct riscv_internal {
     /* GDB instruction breakpoint */
     breakpoint_map_t breakpoint_map;
 
+    /* GDB data watchpoints, the first n_watchpoints of them are in use */
+    watchpoint_t watchpoints[N_WATCHPOINTS];
+    uint32_t n_watchpoints;
+
+    /* Set when a breakpoint or watchpoint is hit, which ends the block and
+     * makes rv_step() return to the GDB stub.
+     */
+    bool debug_stop;
+
     /* The flag to notify interrupt from GDB client: it should be accessed by
      * atomic operation when starting the GDBSTUB.
      */
@@ -363,7 +557,8 @@ struct riscv_internal {
     tlb_entry_t itlb[TLB_SIZE];
 
     /* Timer offset for deriving timer from cycle counter.
-     * timer = csr_cycle + timer_offset
+     * timer = csr_cycle + timer_offset, with csr_cycle scaled from the core
+     * clock to TIMEBASE_MHZ when vm_attr_t.clock_mhz sets one
      * This avoids per-instruction timer increments in the main loop.
      *
      * Note: RISC-V spec defines TIME as a separate real-time counter from
@@ -374,6 +569,19 @@ struct riscv_internal {
     uint64_t timer_offset;
 #endif
 
+#if RV32_HAS(SYSTEM_MMIO)
+    /* Cycle deadline of the next timed event (timer compare or peripheral
+     * poll). rv_check_interrupt() only performs the full device poll and
+     * STIP recomputation once csr_cycle reaches this value, or when an
+     * enabled interrupt is already pending in SIP. Writing 0 forces a
+     * recomputation at the next block boundary.
+     */
+    uint64_t next_event;
+
+    /* Cycle deadline of the next UART/RTC poll */
+    uint64_t next_poll;
+#endif
+
 #if RV32_HAS(ARCH_TEST)
     /* RISC-V architectural test support: tohost/fromhost addresses */
     uint32_t tohost_addr;
@@ -399,6 +607,31 @@ FORCE_INLINE bool is_compressed(uint32_t insn)
     return (insn & FC_OPCODE) != 3;
 }
 
+/* Stop at the end of the current instruction if a data access of @size bytes
+ * at @addr hits a GDB watchpoint. Without watchpoints, an access only pays for
+ * testing their count.
+ */
+#if RV32_HAS(GDBSTUB)
+FORCE_INLINE void debug_watch(riscv_t *rv,
+                              uint32_t addr,
+                              uint32_t size,
+                              uint8_t access)
+{
+    if (likely(!rv->n_watchpoints))
+        return;
+    for (uint32_t i = 0; i < rv->n_watchpoints; i++) {
+        const watchpoint_t *wp = &rv->watchpoints[i];
+        if ((wp->access & access) && addr < wp->addr + 4 &&
+            wp->addr < addr + size)
+            rv->debug_stop = true;
+    }
+}
+#else
+#define debug_watch(rv, addr, size, access) \
+    do {                                    \
+    } while (0)
+#endif
+
 /* RAM Fast-Path Memory Access
  *
  * For userspace emulation (non-SYSTEM mode), memory accesses always go to
@@ -421,47 +654,145 @@ FORCE_INLINE bool is_compressed(uint32_t insn)
  * explicit bounds checks here. Out-of-bounds access leads to undefined
  * behavior (host memory corruption).
  *
- * Note: Only used when SYSTEM mode is disabled. SYSTEM mode requires MMU/TLB
- * translation which must go through the io callbacks.
+ * In SYSTEM mode, the same helpers serve dTLB hits on guest RAM inline and
+ * fall back to the io callbacks for everything else (TLB miss, pending
+ * dirty-bit update, MMIO), which perform the page walk and raise faults.
  */
 #if !RV32_HAS(SYSTEM)
-FORCE_INLINE uint32_t ram_read_w(const riscv_t *rv, uint32_t addr)
+FORCE_INLINE uint32_t ram_read_w(riscv_t *rv, uint32_t addr)
 {
+    debug_watch(rv, addr, 4, WATCH_READ);
     vm_attr_t *attr = PRIV(rv);
     uint32_t val;
     memcpy(&val, attr->mem->mem_base + addr, sizeof(val));
     return val;
 }
 
-FORCE_INLINE uint16_t ram_read_s(const riscv_t *rv, uint32_t addr)
+FORCE_INLINE uint16_t ram_read_s(riscv_t *rv, uint32_t addr)
 {
+    debug_watch(rv, addr, 2, WATCH_READ);
     vm_attr_t *attr = PRIV(rv);
     uint16_t val;
     memcpy(&val, attr->mem->mem_base + addr, sizeof(val));
     return val;
 }
 
-FORCE_INLINE uint8_t ram_read_b(const riscv_t *rv, uint32_t addr)
+FORCE_INLINE uint8_t ram_read_b(riscv_t *rv, uint32_t addr)
 {
+    debug_watch(rv, addr, 1, WATCH_READ);
     vm_attr_t *attr = PRIV(rv);
     return attr->mem->mem_base[addr];
 }
 
-FORCE_INLINE void ram_write_w(const riscv_t *rv, uint32_t addr, uint32_t val)
+FORCE_INLINE void ram_write_w(riscv_t *rv, uint32_t addr, uint32_t val)
 {
+    debug_watch(rv, addr, 4, WATCH_WRITE);
     vm_attr_t *attr = PRIV(rv);
     memcpy(attr->mem->mem_base + addr, &val, sizeof(val));
 }
 
-FORCE_INLINE void ram_write_s(const riscv_t *rv, uint32_t addr, uint16_t val)
+FORCE_INLINE void ram_write_s(riscv_t *rv, uint32_t addr, uint16_t val)
 {
+    debug_watch(rv, addr, 2, WATCH_WRITE);
     vm_attr_t *attr = PRIV(rv);
     memcpy(attr->mem->mem_base + addr, &val, sizeof(val));
 }
 
-FORCE_INLINE void ram_write_b(const riscv_t *rv, uint32_t addr, uint8_t val)
+FORCE_INLINE void ram_write_b(riscv_t *rv, uint32_t addr, uint8_t val)
 {
+    debug_watch(rv, addr, 1, WATCH_WRITE);
     vm_attr_t *attr = PRIV(rv);
     attr->mem->mem_base[addr] = val;
 }
+#else
+/* Host address of a guest data access of @size bytes at @vaddr, or NULL when
+ * it has to take the slow path. The dTLB checks mirror dtlb_lookup() in
+ * system.c, except that a write to a page whose PTE lacks the D bit misses
+ * so that the slow path sets it, and that only entries tagged TLB_PERM_RAM
+ * hit, which makes a bounds check unnecessary.
+ */
+FORCE_INLINE uint8_t *ram_host_addr(riscv_t *rv,
+                                    uint32_t vaddr,
+                                    uint32_t size,
+                                    bool write)
+{
+    memory_t *mem = PRIV(rv)->mem;
+    if (rv->csr_satp) {
+        const uint32_t vpn = vaddr >> RV_PG_SHIFT;
+        const tlb_entry_t *entry = &rv->dtlb[vpn & TLB_MASK];
+        const uint8_t need = (write ? PTE_W : PTE_R) | TLB_PERM_RAM;
+        if (!entry->valid || entry->vpn != vpn ||
+            (entry->perm & need) != need || (write && !entry->dirty))
+            return NULL;
+        return mem->mem_base + (entry->ppn | (vaddr & MASK(RV_PG_SHIFT)));
+    }
+
+    if (unlikely(!GUEST_RAM_CONTAINS(mem, vaddr, size)))
+        return NULL;
+    return mem->mem_base + vaddr;
+}
+
+FORCE_INLINE uint32_t ram_read_w(riscv_t *rv, uint32_t addr)
+{
+    debug_watch(rv, addr, 4, WATCH_READ);
+    const uint8_t *host = ram_host_addr(rv, addr, 4, false);
+    if (unlikely(!host))
+        return rv->io.mem_read_w(rv, addr);
+    uint32_t val;
+    memcpy(&val, host, sizeof(val));
+    return val;
+}
+
+FORCE_INLINE uint16_t ram_read_s(riscv_t *rv, uint32_t addr)
+{
+    debug_watch(rv, addr, 2, WATCH_READ);
+    const uint8_t *host = ram_host_addr(rv, addr, 2, false);
+    if (unlikely(!host))
+        return rv->io.mem_read_s(rv, addr);
+    uint16_t val;
+    memcpy(&val, host, sizeof(val));
+    return val;
+}
+
+FORCE_INLINE uint8_t ram_read_b(riscv_t *rv, uint32_t addr)
+{
+    debug_watch(rv, addr, 1, WATCH_READ);
+    const uint8_t *host = ram_host_addr(rv, addr, 1, false);
+    if (unlikely(!host))
+        return rv->io.mem_read_b(rv, addr);
+    return *host;
+}
+
+FORCE_INLINE void ram_write_w(riscv_t *rv, uint32_t addr, uint32_t val)
+{
+    debug_watch(rv, addr, 4, WATCH_WRITE);
+    uint8_t *host = ram_host_addr(rv, addr, 4, true);
+    if (unlikely(!host)) {
+        rv->io.mem_write_w(rv, addr, val);
+        return;
+    }
+    memcpy(host, &val, sizeof(val));
+}
+
+FORCE_INLINE void ram_write_s(riscv_t *rv, uint32_t addr, uint16_t val)
+{
+    debug_watch(rv, addr, 2, WATCH_WRITE);
+    uint8_t *host = ram_host_addr(rv, addr, 2, true);
+    if (unlikely(!host)) {
+        rv->io.mem_write_s(rv, addr, val);
+        return;
+    }
+    memcpy(host, &val, sizeof(val));
+}
+
+FORCE_INLINE void ram_write_b(riscv_t *rv, uint32_t addr, uint8_t val)
+{
+    debug_watch(rv, addr, 1, WATCH_WRITE);
+    uint8_t *host = ram_host_addr(rv, addr, 1, true);
+    if (unlikely(!host)) {
+        rv->io.mem_write_b(rv, addr, val);
+        return;
+    }
+    *host = val;
+}
 #endif /* !RV32_HAS(SYSTEM) */
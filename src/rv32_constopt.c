@@ -368,6 +368,11 @@ CONSTOPT(ecall, {})
 /* EBREAK: Environment Break */
 CONSTOPT(ebreak, {})
 
+#if !RV32_HAS(SYSTEM)
+/* LIBCALL: guest libc routine run on the host */
+CONSTOPT(libcall, {})
+#endif
+
 /* WFI: Wait for Interrupt */
 CONSTOPT(wfi, {})
 
@@ -217,6 +217,9 @@
     })
 
 /* Load instruction handler macro - handles MMIO path when SYSTEM_MMIO enabled.
+ * In system mode, the access first probes the dTLB inline (emit_dtlb_probe)
+ * and only calls jit_mmu_handler on a miss, a permission or dirty-bit
+ * mismatch, or an access outside guest RAM.
  * Parameters:
  *   inst: instruction name (lb, lh, lw, lbu, lhu)
  *   insn_type: rv_insn_* constant for MMIO handler
@@ -231,6 +234,23 @@
             {                                                                 \
                 emit_load_imm_sext(state, temp_reg, ir->imm);                 \
                 emit_alu32(state, ALU_OP_ADD, vm_reg[0], temp_reg);           \
+                store_back(state);                                            \
+                reset_reg();                                                  \
+                vm_reg[1] = map_vm_reg(state, ir->rd);                        \
+                                                                              \
+                /* dTLB hit: load straight from host memory */                \
+                uint32_t jump_tlb_miss;                                       \
+                vm_reg[2] =                                                   \
+                    emit_dtlb_probe(state, rv, false, &jump_tlb_miss);        \
+                load_fn(state, size, vm_reg[2], vm_reg[1], 0);                \
+                uint32_t jump_tlb_hit = state->offset;                        \
+                emit_jcc_offset(state, JCC_JMP);                              \
+                                                                              \
+                /* dTLB miss or MMIO: translate through jit_mmu_handler.      \
+                 * Nothing is live in host registers here, and vm_reg[1]      \
+                 * stays mapped to rd so both paths join in the same state.   \
+                 */                                                           \
+                emit_jump_target_offset(state, JUMP_TLB_MISS, state->offset); \
                 emit_store(state, S32, temp_reg, parameter_reg[0],            \
                            offsetof(riscv_t, jit_mmu.vaddr));                 \
                 emit_load_imm(state, temp_reg, insn_type);                    \
@@ -240,10 +260,7 @@
                 emit_load_imm(state, temp_reg, ir->pc);                       \
                 emit_store(state, S32, temp_reg, parameter_reg[0],            \
                            offsetof(riscv_t, jit_mmu.pc));                    \
-                                                                              \
-                store_back(state);                                            \
                 emit_jit_mmu_handler(state, ir->rd);                          \
-                reset_reg();                                                  \
                                                                               \
                 /* Check if trap occurred - skip load if trapped */           \
                 emit_load(state, S8, parameter_reg[0], temp_reg,              \
@@ -256,7 +273,6 @@
                 emit_load(state, S8, parameter_reg[0], temp_reg,              \
                           offsetof(riscv_t, jit_mmu.is_mmio));                \
                 emit_cmp_imm32(state, temp_reg, 0);                           \
-                vm_reg[1] = map_vm_reg(state, ir->rd);                        \
                 uint32_t jump_loc_0 = state->offset;                          \
                 emit_jcc_offset(state, JCC_JE);                               \
                                                                               \
@@ -280,6 +296,7 @@
                 emit_exit(state);                                             \
                 /* Normal continuation point */                               \
                 emit_jump_target_offset(state, JUMP_NORMAL, state->offset);   \
+                emit_jump_target_offset(state, JUMP_TLB_HIT, state->offset);  \
             },                                                                \
             {                                                                 \
                 emit_load_imm_sext(state, temp_reg,                           \
@@ -291,6 +308,7 @@
     })
 
 /* Store instruction handler macro - handles MMIO path when SYSTEM_MMIO enabled.
+ * In system mode, the access first probes the dTLB inline like GEN_LOAD.
  * Parameters:
  *   inst: instruction name (sb, sh, sw)
  *   insn_type: rv_insn_* constant for MMIO handler
@@ -304,6 +322,24 @@
             {                                                                 \
                 emit_load_imm_sext(state, temp_reg, ir->imm);                 \
                 emit_alu32(state, ALU_OP_ADD, vm_reg[0], temp_reg);           \
+                store_back(state);                                            \
+                reset_reg();                                                  \
+                vm_reg[1] = ra_load(state, ir->rs2);                          \
+                                                                              \
+                /* dTLB hit on a dirty page: store straight to host memory */ \
+                uint32_t jump_tlb_miss;                                       \
+                vm_reg[2] =                                                   \
+                    emit_dtlb_probe(state, rv, true, &jump_tlb_miss);         \
+                emit_store(state, size, vm_reg[1], vm_reg[2], 0);             \
+                uint32_t jump_tlb_hit = state->offset;                        \
+                emit_jcc_offset(state, JCC_JMP);                              \
+                                                                              \
+                /* dTLB miss or MMIO: translate through jit_mmu_handler.      \
+                 * rs2 is clean, so forget its mapping; the handler call      \
+                 * clobbers caller-saved host registers.                      \
+                 */                                                           \
+                emit_jump_target_offset(state, JUMP_TLB_MISS, state->offset); \
+                reset_reg();                                                  \
                 emit_store(state, S32, temp_reg, parameter_reg[0],            \
                            offsetof(riscv_t, jit_mmu.vaddr));                 \
                 emit_load_imm(state, temp_reg, insn_type);                    \
@@ -313,9 +349,7 @@
                 emit_load_imm(state, temp_reg, ir->pc);                       \
                 emit_store(state, S32, temp_reg, parameter_reg[0],            \
                            offsetof(riscv_t, jit_mmu.pc));                    \
-                store_back(state);                                            \
                 emit_jit_mmu_handler(state, ir->rs2);                         \
-                reset_reg();                                                  \
                                                                               \
                 /* Check if trap occurred - skip store if trapped */          \
                 emit_load(state, S8, parameter_reg[0], temp_reg,              \
@@ -352,6 +386,7 @@
                 emit_exit(state);                                             \
                 /* Normal continuation point */                               \
                 emit_jump_target_offset(state, JUMP_NORMAL, state->offset);   \
+                emit_jump_target_offset(state, JUMP_TLB_HIT, state->offset);  \
                 reset_reg();                                                  \
             },                                                                \
             {                                                                 \
@@ -453,6 +488,9 @@ GEN(ebreak, {
     emit_call(state, (intptr_t) rv->io.on_ebreak);
     emit_exit(state);
 })
+#if !RV32_HAS(SYSTEM)
+GEN(libcall, { assert(NULL); })
+#endif
 GEN(wfi, { assert(NULL); })
 GEN(uret, { assert(NULL); })
 #if RV32_HAS(SYSTEM)
@@ -13,8 +13,18 @@
  * Architecture:
  * - RVOP(name, { body }): Defines an interpreter handler function.
  * - Parameters: rv (emulator state), ir (decoded instruction),
- *   cycle (cycle counter), PC (program counter).
+ *   cycle (cycle counter), instret (retired instruction counter),
+ *   PC (program counter).
  * - Return: 'bool' indicating whether to continue execution.
+ * - Transfer to another IR only via RVOP_JUMP(target), never by calling
+ *   target->impl directly. RVOP_JUMP leaves the current block, so the target
+ *   must be the entry of a block, e.g. ir->branch_taken.
+ * - 'cycle' and 'instret' are the counts at entry of the current block.
+ *   Anything that observes or publishes them uses RVOP_SYNC_COUNTERS(), or
+ *   cycle + ir->cycle_ofs and instret + ir->insn_ofs.
+ * - Depending on the dispatch engine, a handler is either a function or a
+ *   label inside a single dispatch function, so bodies must not define helper
+ *   functions or static variables either.
  *
  * Example:
  *   RVOP(addi, { rv->X[ir->rd] = rv->X[ir->rs1] + ir->imm; })
@@ -89,7 +99,7 @@ RVOP(jal, {
              */
             last_pc = PC;
 
-            MUST_TAIL return taken->impl(rv, taken, cycle, PC);
+            RVOP_JUMP(taken);
         }
     }
     goto end_op;
@@ -111,31 +121,34 @@ RVOP(jal, {
      *                                                                         \
      * In addition, before relocate_enable_mmu, the block maybe retranslated,  \
      * thus the branch history lookup table should not be updated too.         \
+     *                                                                         \
+     * A lone IR stepped by rv_step_insn() owns no table and must not jump     \
+     * into a block either, and while the GDB stub is attached every block     \
+     * returns to rv_step(), which checks for a stop.                          \
      */                                                                        \
     IIF(RV32_HAS(GDBSTUB)(if (!rv->debug_mode), ))                             \
-    {                                                                          \
+    if (ir->branch_table) {                                                    \
         IIF(RV32_HAS(SYSTEM)(if (!rv->is_trapped && !reloc_enable_mmu), ))     \
         {                                                                      \
             /* Direct-mapped lookup: O(1) instead of O(n) linear search */     \
             const uint32_t bht_idx = (PC >> 2) & (HISTORY_SIZE - 1);           \
             if (ir->branch_table->PC[bht_idx] == PC &&                         \
                 ir->branch_table->target[bht_idx]) {                           \
-                MUST_TAIL return ir->branch_table->target[bht_idx]->impl(      \
-                    rv, ir->branch_table->target[bht_idx], cycle, PC);         \
+                RVOP_JUMP(ir->branch_table->target[bht_idx]);                  \
             }                                                                  \
             block_t *block = block_find(&rv->block_map, PC);                   \
             if (block) {                                                       \
                 /* Direct replacement at computed index */                     \
                 ir->branch_table->PC[bht_idx] = PC;                            \
                 ir->branch_table->target[bht_idx] = block->ir_head;            \
-                MUST_TAIL return block->ir_head->impl(rv, block->ir_head,      \
-                                                      cycle, PC);              \
+                RVOP_JUMP(block->ir_head);                                     \
             }                                                                  \
         }                                                                      \
     }
 #else
 #define LOOKUP_OR_UPDATE_BRANCH_HISTORY_TABLE()                              \
     IIF(RV32_HAS(SYSTEM))(if (!rv->is_trapped && !reloc_enable_mmu), )       \
+    if (ir->branch_table)                                                    \
     {                                                                        \
         block_t *block = cache_get(rv->block_cache, PC, true);               \
         if (block) {                                                         \
@@ -157,8 +170,7 @@ RVOP(jal, {
                 ir->branch_table->satp[bht_idx] = rv->csr_satp, );           \
             if (cache_hot(rv->block_cache, PC))                              \
                 goto end_op;                                                 \
-            MUST_TAIL return block->ir_head->impl(rv, block->ir_head, cycle, \
-                                                  PC);                       \
+            RVOP_JUMP(block->ir_head);                                       \
         }                                                                    \
     }
 #endif
@@ -242,7 +254,7 @@ RVOP(jalr, {
             {                                                                  \
                 if (!rv->is_trapped) {                                         \
                     last_pc = PC;                                              \
-                    MUST_TAIL return untaken->impl(rv, untaken, cycle, PC);    \
+                    RVOP_JUMP(untaken);                                        \
                 }                                                              \
             }, );                                                              \
         goto end_op;                                                           \
@@ -274,7 +286,7 @@ RVOP(jalr, {
             {                                                                  \
                 if (!rv->is_trapped) {                                         \
                     last_pc = PC;                                              \
-                    MUST_TAIL return taken->impl(rv, taken, cycle, PC);        \
+                    RVOP_JUMP(taken);                                          \
                 }                                                              \
             }, );                                                              \
     }                                                                          \
@@ -323,25 +335,16 @@ RVOP(bgeu, { BRANCH_FUNC(uint32_t, <); })
 
 /* RAM fast-path memory access macros
  *
- * In non-SYSTEM mode, bypass io callback indirection for direct RAM access.
- * This eliminates function pointer dispatch overhead per memory operation.
- * In SYSTEM mode, use io callbacks for MMU/TLB handling.
+ * Bypass the io callback indirection whenever the access can be served
+ * directly from guest RAM. In SYSTEM mode this covers dTLB hits, and the
+ * helpers fall back to the io callbacks for MMU and MMIO handling.
  */
-#if !RV32_HAS(SYSTEM)
 #define MEM_READ_W(rv, addr) ram_read_w(rv, addr)
 #define MEM_READ_S(rv, addr) ram_read_s(rv, addr)
 #define MEM_READ_B(rv, addr) ram_read_b(rv, addr)
 #define MEM_WRITE_W(rv, addr, val) ram_write_w(rv, addr, val)
 #define MEM_WRITE_S(rv, addr, val) ram_write_s(rv, addr, val)
 #define MEM_WRITE_B(rv, addr, val) ram_write_b(rv, addr, val)
-#else
-#define MEM_READ_W(rv, addr) (rv)->io.mem_read_w(rv, addr)
-#define MEM_READ_S(rv, addr) (rv)->io.mem_read_s(rv, addr)
-#define MEM_READ_B(rv, addr) (rv)->io.mem_read_b(rv, addr)
-#define MEM_WRITE_W(rv, addr, val) (rv)->io.mem_write_w(rv, addr, val)
-#define MEM_WRITE_S(rv, addr, val) (rv)->io.mem_write_s(rv, addr, val)
-#define MEM_WRITE_B(rv, addr, val) (rv)->io.mem_write_b(rv, addr, val)
-#endif
 
 /* LB: Load Byte */
 RVOP(lb, {
@@ -443,38 +446,22 @@ RVOP(ori, { rv->X[ir->rd] = rv->X[ir->rs1] | ir->imm; })
  */
 RVOP(andi, { rv->X[ir->rd] = rv->X[ir->rs1] & ir->imm; })
 
-FORCE_INLINE void shift_func(riscv_t *rv, const rv_insn_t *ir)
-{
-    switch (ir->opcode) {
-    case rv_insn_slli:
-        rv->X[ir->rd] = rv->X[ir->rs1] << (ir->imm & 0x1f);
-        break;
-    case rv_insn_srli:
-        rv->X[ir->rd] = rv->X[ir->rs1] >> (ir->imm & 0x1f);
-        break;
-    case rv_insn_srai:
-        rv->X[ir->rd] = ((int32_t) rv->X[ir->rs1]) >> (ir->imm & 0x1f);
-        break;
-    default:
-        __UNREACHABLE;
-        break;
-    }
-};
-
 /* SLLI performs logical left shift on the value in register rs1 by the shift
  * amount held in the lower 5 bits of the immediate.
  */
-RVOP(slli, { shift_func(rv, ir); })
+RVOP(slli, { rv->X[ir->rd] = rv->X[ir->rs1] << (ir->imm & 0x1f); })
 
 /* SRLI performs logical right shift on the value in register rs1 by the shift
  * amount held in the lower 5 bits of the immediate.
  */
-RVOP(srli, { shift_func(rv, ir); })
+RVOP(srli, { rv->X[ir->rd] = rv->X[ir->rs1] >> (ir->imm & 0x1f); })
 
 /* SRAI performs arithmetic right shift on the value in register rs1 by the
  * shift amount held in the lower 5 bits of the immediate.
  */
-RVOP(srai, { shift_func(rv, ir); })
+RVOP(srai, {
+    rv->X[ir->rd] = ((int32_t) rv->X[ir->rs1]) >> (ir->imm & 0x1f);
+})
 
 /* ADD */
 RVOP(add, { rv->X[ir->rd] = rv->X[ir->rs1] + rv->X[ir->rs2]; })
@@ -529,7 +516,7 @@ RVOP(fence, {
 /* ECALL: Environment Call */
 RVOP(ecall, {
     rv->compressed = false;
-    rv->csr_cycle = cycle;
+    RVOP_SYNC_COUNTERS(rv);
     rv->PC = PC;
     rv->io.on_ecall(rv);
     return true;
@@ -538,16 +525,35 @@ RVOP(ecall, {
 /* EBREAK: Environment Break */
 RVOP(ebreak, {
     rv->compressed = false;
-    rv->csr_cycle = cycle;
+    RVOP_SYNC_COUNTERS(rv);
     rv->PC = PC;
     rv->io.on_ebreak(rv);
     return true;
 })
 
+#if !RV32_HAS(SYSTEM)
+/* LIBCALL: the entry of a guest libc routine, which the host runs as a whole
+ * before returning to ra
+ */
+RVOP(libcall, {
+    rv->compressed = false;
+    RVOP_SYNC_COUNTERS(rv);
+    rv->PC = PC;
+    libcall_exec(rv, ir->imm);
+    return true;
+})
+#endif
+
 /* WFI: Wait for Interrupt */
 RVOP(wfi, {
     PC += 4;
-    /* FIXME: Implement */
+    /* Nothing can wake the hart before the next scheduled event unless an
+     * enabled interrupt is already pending, so skip the idle cycles.
+     */
+    IIF(RV32_HAS(SYSTEM_MMIO))(
+        if (!(rv->csr_sip & rv->csr_sie) &&
+            cycle + ir->cycle_ofs < rv->next_event)
+            cycle = rv->next_event - ir->cycle_ofs;, )
     goto end_op;
 })
 
@@ -688,7 +694,7 @@ RVOP(fencei, {
      * will be naturally evicted. Full cache invalidation is not implemented
      * for this case as it would require additional infrastructure.
      */
-    rv->csr_cycle = cycle;
+    RVOP_SYNC_COUNTERS(rv);
     rv->PC = PC;
     return true;
 })
@@ -697,7 +703,8 @@ RVOP(fencei, {
 #if RV32_HAS(Zicsr) /* RV32 Zicsr Standard Extension */
 /* CSRRW: Atomic Read/Write CSR */
 RVOP(csrrw, {
-    uint32_t tmp = csr_csrrw(rv, ir->imm, rv->X[ir->rs1], cycle);
+    RVOP_SYNC_COUNTERS(rv);
+    uint32_t tmp = csr_csrrw(rv, ir->imm, rv->X[ir->rs1]);
     rv->X[ir->rd] = ir->rd ? tmp : rv->X[ir->rd];
 })
 
@@ -711,33 +718,38 @@ RVOP(csrrw, {
  * See Page 56 of the RISC-V Unprivileged Specification.
  */
 RVOP(csrrs, {
-    uint32_t tmp = csr_csrrs(
-        rv, ir->imm, (ir->rs1 == rv_reg_zero) ? 0U : rv->X[ir->rs1], cycle);
+    RVOP_SYNC_COUNTERS(rv);
+    uint32_t tmp = csr_csrrs(rv, ir->imm,
+                             (ir->rs1 == rv_reg_zero) ? 0U : rv->X[ir->rs1]);
     rv->X[ir->rd] = ir->rd ? tmp : rv->X[ir->rd];
 })
 
 /* CSRRC: Atomic Read and Clear Bits in CSR */
 RVOP(csrrc, {
-    uint32_t tmp = csr_csrrc(
-        rv, ir->imm, (ir->rs1 == rv_reg_zero) ? 0U : rv->X[ir->rs1], cycle);
+    RVOP_SYNC_COUNTERS(rv);
+    uint32_t tmp = csr_csrrc(rv, ir->imm,
+                             (ir->rs1 == rv_reg_zero) ? 0U : rv->X[ir->rs1]);
     rv->X[ir->rd] = ir->rd ? tmp : rv->X[ir->rd];
 })
 
 /* CSRRWI */
 RVOP(csrrwi, {
-    uint32_t tmp = csr_csrrw(rv, ir->imm, ir->rs1, cycle);
+    RVOP_SYNC_COUNTERS(rv);
+    uint32_t tmp = csr_csrrw(rv, ir->imm, ir->rs1);
     rv->X[ir->rd] = ir->rd ? tmp : rv->X[ir->rd];
 })
 
 /* CSRRSI */
 RVOP(csrrsi, {
-    uint32_t tmp = csr_csrrs(rv, ir->imm, ir->rs1, cycle);
+    RVOP_SYNC_COUNTERS(rv);
+    uint32_t tmp = csr_csrrs(rv, ir->imm, ir->rs1);
     rv->X[ir->rd] = ir->rd ? tmp : rv->X[ir->rd];
 })
 
 /* CSRRCI */
 RVOP(csrrci, {
-    uint32_t tmp = csr_csrrc(rv, ir->imm, ir->rs1, cycle);
+    RVOP_SYNC_COUNTERS(rv);
+    uint32_t tmp = csr_csrrc(rv, ir->imm, ir->rs1);
     rv->X[ir->rd] = ir->rd ? tmp : rv->X[ir->rd];
 })
 #endif
@@ -1330,7 +1342,7 @@ RVOP(cjal, {
 #endif
         {
             last_pc = PC;
-            MUST_TAIL return taken->impl(rv, taken, cycle, PC);
+            RVOP_JUMP(taken);
         }
     }
     goto end_op;
@@ -1417,7 +1429,7 @@ RVOP(cj, {
 #endif
         {
             last_pc = PC;
-            MUST_TAIL return taken->impl(rv, taken, cycle, PC);
+            RVOP_JUMP(taken);
         }
     }
     goto end_op;
@@ -1452,7 +1464,7 @@ RVOP(cbeqz, {
 #endif
         {
             last_pc = PC;
-            MUST_TAIL return untaken->impl(rv, untaken, cycle, PC);
+            RVOP_JUMP(untaken);
         }
 
         goto end_op;
@@ -1478,7 +1490,7 @@ RVOP(cbeqz, {
 #endif
         {
             last_pc = PC;
-            MUST_TAIL return taken->impl(rv, taken, cycle, PC);
+            RVOP_JUMP(taken);
         }
     }
     goto end_op;
@@ -1509,7 +1521,7 @@ RVOP(cbnez, {
 #endif
         {
             last_pc = PC;
-            MUST_TAIL return untaken->impl(rv, untaken, cycle, PC);
+            RVOP_JUMP(untaken);
         }
 
         goto end_op;
@@ -1535,7 +1547,7 @@ RVOP(cbnez, {
 #endif
         {
             last_pc = PC;
-            MUST_TAIL return taken->impl(rv, taken, cycle, PC);
+            RVOP_JUMP(taken);
         }
     }
     goto end_op;
@@ -1567,7 +1579,7 @@ RVOP(cmv, { rv->X[ir->rd] = rv->X[ir->rs2]; })
 /* C.EBREAK */
 RVOP(cebreak, {
     rv->compressed = true;
-    rv->csr_cycle = cycle;
+    RVOP_SYNC_COUNTERS(rv);
     rv->PC = PC;
     rv->io.on_ebreak(rv);
     return true;
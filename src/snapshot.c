@@ -0,0 +1,296 @@
+/*
+ * rv32emu is freely redistributable under the MIT License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "riscv.h"
+#include "riscv_private.h"
+#include "utils.h"
+
+#if RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP
+/* VM snapshots
+ *
+ * A snapshot file holds a fixed header, the architectural state of the hart
+ * and the MMIO devices, and the guest RAM image written by memory_save():
+ *
+ *   [0, sizeof(header))          snapshot_header_t
+ *   [sizeof(header), ...)        hart and device state (state_size bytes)
+ *   [mem_offset, ...)            guest RAM image, 64 KiB aligned
+ *
+ * Restoring maps the RAM image copy-on-write, so the cost is proportional to
+ * the pages the resumed guest actually touches rather than to the RAM size.
+ * Prefaulted and hugetlb RAM is copied into instead, keeping its pages. The
+ * header records the chunk layout of the image, which has to match the build
+ * restoring it.
+ * Host-side resources (file descriptors, disk images, translated blocks) are
+ * not part of the snapshot: virtio-blk images must be unchanged between save
+ * and restore, and the state is only comparable across identical builds.
+ */
+
+#define SNAPSHOT_MAGIC "RV32SNAP"
+#define SNAPSHOT_VERSION 4
+
+/* RAM image alignment, matches MEM_IMAGE_ALIGN in io.c */
+#define SNAPSHOT_MEM_ALIGN 0x10000
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t state_size; /**< bytes of hart and device state */
+    uint64_t mem_size;   /**< guest RAM size */
+    uint64_t mem_offset; /**< file offset of the guest RAM image */
+    uint32_t chunk_size; /**< MEM_CHUNK_SIZE of the RAM image */
+    uint32_t bitmap_size; /**< MEM_BITMAP_SIZE of the RAM image */
+} snapshot_header_t;
+
+/* Hart state: every field that is architecturally visible or needed to
+ * resume execution. Caches derived from it (TLBs, block maps) are rebuilt.
+ */
+#define SNAPSHOT_HART_LIST \
+    _(X)                   \
+    _(PC)                  \
+    _(timer)               \
+    _(is_trapped)          \
+    _(csr_cycle)           \
+    _(csr_instret)         \
+    _(csr_time)            \
+    _(csr_mstatus)         \
+    _(csr_mtvec)           \
+    _(csr_misa)            \
+    _(csr_mtval)           \
+    _(csr_mcause)          \
+    _(csr_mscratch)        \
+    _(csr_mepc)            \
+    _(csr_mip)             \
+    _(csr_mie)             \
+    _(csr_mideleg)         \
+    _(csr_medeleg)         \
+    _(csr_mbadaddr)        \
+    _(csr_sstatus)         \
+    _(csr_stvec)           \
+    _(csr_sip)             \
+    _(csr_sie)             \
+    _(csr_scounteren)      \
+    _(csr_sscratch)        \
+    _(csr_sepc)            \
+    _(csr_scause)          \
+    _(csr_stval)           \
+    _(csr_satp)            \
+    _(csr_mcountinhibit)   \
+    _(csr_mhpmevent)       \
+    _(csr_mhpmcounter)     \
+    _(pmu_last)            \
+    _(pmu_event)           \
+    _(pmu_detailed)        \
+    _(sbi_pmu_used)        \
+    _(priv_mode)           \
+    _(compressed)          \
+    _(last_csr_sepc)       \
+    _(timer_offset)
+
+#define SNAPSHOT_UART_LIST \
+    _(dll)                 \
+    _(dlh)                 \
+    _(lcr)                 \
+    _(ier)                 \
+    _(current_intr)        \
+    _(pending_intrs)       \
+    _(mcr)                 \
+    _(in_ready)
+
+#define SNAPSHOT_PLIC_LIST \
+    _(masked)              \
+    _(ip)                  \
+    _(ie)                  \
+    _(active)
+
+#define SNAPSHOT_RTC_LIST \
+    _(time_low)           \
+    _(time_high)          \
+    _(alarm_low)          \
+    _(alarm_high)         \
+    _(irq_enabled)        \
+    _(alarm_status)       \
+    _(interrupt_status)   \
+    _(clock_offset)
+
+#define SNAPSHOT_VBLK_LIST \
+    _(device_features)     \
+    _(device_features_sel) \
+    _(driver_features)     \
+    _(driver_features_sel) \
+    _(queue_sel)           \
+    _(queues)              \
+    _(status)              \
+    _(interrupt_status)
+
+/* The same walk serializes and deserializes the state, which keeps the two
+ * directions in sync by construction. With a NULL buffer it only measures.
+ */
+typedef struct {
+    uint8_t *buf; /**< state buffer, NULL to compute the size only */
+    size_t pos;   /**< current offset in buf */
+    bool save;    /**< copy fields into buf, or out of buf on restore */
+} snapshot_stream_t;
+
+static void snapshot_xfer(snapshot_stream_t *s, void *field, size_t size)
+{
+    if (s->buf) {
+        if (s->save)
+            memcpy(s->buf + s->pos, field, size);
+        else
+            memcpy(field, s->buf + s->pos, size);
+    }
+    s->pos += size;
+}
+
+#define XFER(s, obj, field) \
+    snapshot_xfer(s, &(obj)->field, sizeof((obj)->field))
+
+static void snapshot_walk(riscv_t *rv, snapshot_stream_t *s)
+{
+    vm_attr_t *attr = PRIV(rv);
+
+#define _(field) XFER(s, rv, field);
+    SNAPSHOT_HART_LIST
+#undef _
+#if RV32_HAS(EXT_F)
+    XFER(s, rv, F);
+    XFER(s, rv, csr_fcsr);
+#endif
+
+    XFER(s, attr, timer);
+
+#define _(field) XFER(s, attr->uart, field);
+    SNAPSHOT_UART_LIST
+#undef _
+#define _(field) XFER(s, attr->plic, field);
+    SNAPSHOT_PLIC_LIST
+#undef _
+#if RV32_HAS(GOLDFISH_RTC)
+#define _(field) XFER(s, attr->rtc, field);
+    SNAPSHOT_RTC_LIST
+#undef _
+#endif
+    for (int i = 0; i < attr->vblk_cnt; i++) {
+#define _(field) XFER(s, attr->vblk[i], field);
+        SNAPSHOT_VBLK_LIST
+#undef _
+    }
+}
+
+bool rv_snapshot_save(riscv_t *rv, const char *path)
+{
+    vm_attr_t *attr = PRIV(rv);
+
+    snapshot_stream_t s = {.buf = NULL, .pos = 0, .save = true};
+    snapshot_walk(rv, &s);
+    const size_t state_size = s.pos;
+
+    snapshot_header_t hdr = {
+        .version = SNAPSHOT_VERSION,
+        .state_size = state_size,
+        .mem_size = attr->mem->mem_size,
+        .mem_offset = align_up(sizeof(hdr) + state_size, SNAPSHOT_MEM_ALIGN),
+        .chunk_size = MEM_CHUNK_SIZE,
+        .bitmap_size = MEM_BITMAP_SIZE,
+    };
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+
+    uint8_t *buf = malloc(sizeof(hdr) + state_size);
+    if (!buf)
+        return false;
+    memcpy(buf, &hdr, sizeof(hdr));
+    s = (snapshot_stream_t){.buf = buf + sizeof(hdr), .pos = 0, .save = true};
+    snapshot_walk(rv, &s);
+
+    bool ok = false;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        rv_log_error("Cannot create snapshot file %s", path);
+        goto out;
+    }
+
+    ssize_t len = sizeof(hdr) + state_size;
+    if (write(fd, buf, len) != len ||
+        !memory_save(attr->mem, fd, hdr.mem_offset)) {
+        rv_log_error("Failed to write snapshot file %s", path);
+        goto out_close;
+    }
+    ok = true;
+
+out_close:
+    close(fd);
+out:
+    free(buf);
+    return ok;
+}
+
+bool rv_snapshot_restore(riscv_t *rv, const char *path)
+{
+    vm_attr_t *attr = PRIV(rv);
+    uint8_t *buf = NULL;
+    bool ok = false;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        rv_log_error("Cannot open snapshot file %s", path);
+        return false;
+    }
+
+    snapshot_stream_t s = {.buf = NULL, .pos = 0, .save = false};
+    snapshot_walk(rv, &s);
+
+    snapshot_header_t hdr;
+    if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic)) ||
+        hdr.version != SNAPSHOT_VERSION) {
+        rv_log_error("%s is not a valid snapshot file", path);
+        goto out;
+    }
+    if (hdr.state_size != s.pos || hdr.mem_size != attr->mem->mem_size) {
+        rv_log_error("Snapshot %s does not match this VM configuration",
+                     path);
+        goto out;
+    }
+    if (hdr.chunk_size != MEM_CHUNK_SIZE ||
+        hdr.bitmap_size != MEM_BITMAP_SIZE) {
+        rv_log_error("Snapshot %s was saved with %u-byte memory chunks",
+                     path, hdr.chunk_size);
+        goto out;
+    }
+
+    buf = malloc(hdr.state_size);
+    if (!buf || read(fd, buf, hdr.state_size) != (ssize_t) hdr.state_size) {
+        rv_log_error("Failed to read snapshot file %s", path);
+        goto out;
+    }
+
+    if (!memory_restore(attr->mem, fd, hdr.mem_offset)) {
+        rv_log_error("Failed to map guest memory from snapshot %s", path);
+        goto out;
+    }
+
+    s = (snapshot_stream_t){.buf = buf, .pos = 0, .save = false};
+    snapshot_walk(rv, &s);
+
+    /* drop everything derived from the previous guest state */
+    mmu_tlb_flush_all(rv);
+    rv_invalidate_blocks(rv);
+    rv->next_event = 0;
+    rv->next_poll = 0;
+    rv->halt = false;
+    ok = true;
+
+out:
+    free(buf);
+    close(fd);
+    return ok;
+}
+#endif /* RV32_HAS(SYSTEM_MMIO) && HAVE_MMAP */
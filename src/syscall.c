@@ -38,6 +38,7 @@
         _(sbi_base,         0x10)          \
         _(sbi_timer,        0x54494D45)    \
         _(sbi_rst,          0x53525354)    \
+        _(sbi_pmu,          0x504D55)      \
     )                                      \
     IIF(RV32_HAS(SDL))(                    \
         _(draw_frame,       0xBEEF)        \
@@ -429,6 +430,10 @@ static void syscall_sbi_timer(riscv_t *rv)
     switch (fid) {
     case SBI_TIMER_SET_TIMER:
         attr->timer = (((uint64_t) a1) << 32) | (uint64_t) (a0);
+#if RV32_HAS(SYSTEM_MMIO)
+        /* re-evaluate STIP and the timer deadline at the next block */
+        rv->next_event = 0;
+#endif
         rv_set_reg(rv, rv_reg_a0, SBI_SUCCESS);
         rv_set_reg(rv, rv_reg_a1, 0);
         break;
@@ -474,7 +479,8 @@ static void syscall_sbi_base(riscv_t *rv)
     case SBI_BASE_PROBE_EXTENSION: {
         const riscv_word_t eid = rv_get_reg(rv, rv_reg_a0);
         bool available =
-            eid == SBI_EID_BASE || eid == SBI_EID_TIMER || eid == SBI_EID_RST;
+            eid == SBI_EID_BASE || eid == SBI_EID_TIMER ||
+            eid == SBI_EID_RST || eid == SBI_EID_PMU;
         rv_set_reg(rv, rv_reg_a0, SBI_SUCCESS);
         rv_set_reg(rv, rv_reg_a1, available);
         break;
@@ -505,16 +511,241 @@ static void syscall_sbi_rst(riscv_t *rv)
         break;
     }
 }
+
+/* SBI PMU event_idx types and flags */
+#define SBI_PMU_TYPE_HW 0
+#define SBI_PMU_TYPE_CACHE 1
+#define SBI_PMU_TYPE_RAW 2
+#define SBI_PMU_HW_CPU_CYCLES 1
+#define SBI_PMU_HW_INSTRUCTIONS 2
+#define SBI_PMU_HW_BRANCH_INSTRUCTIONS 5
+#define SBI_PMU_CACHE_L1D 0
+#define SBI_PMU_CACHE_DTLB 3
+#define SBI_PMU_CACHE_ITLB 4
+#define SBI_PMU_CACHE_OP_READ 0
+#define SBI_PMU_CACHE_OP_WRITE 1
+#define SBI_PMU_CACHE_RESULT_MISS 1
+#define SBI_PMU_CFG_FLAG_SKIP_MATCH (1U << 0)
+#define SBI_PMU_CFG_FLAG_CLEAR_VALUE (1U << 1)
+#define SBI_PMU_CFG_FLAG_AUTO_START (1U << 2)
+#define SBI_PMU_START_FLAG_SET_INIT_VALUE (1U << 0)
+#define SBI_PMU_STOP_FLAG_RESET (1U << 0)
+
+/* map an SBI event_idx, or the mhpmevent value of a raw event, to the
+ * emulator event counting it, PMU_EVENT_none if there is none
+ */
+static uint32_t sbi_pmu_event(uint32_t event_idx, uint32_t event_data)
+{
+    const uint32_t code = event_idx & 0xFFFF;
+
+    switch ((event_idx >> 16) & 0xF) {
+    case SBI_PMU_TYPE_HW:
+        switch (code) {
+        case SBI_PMU_HW_CPU_CYCLES:
+            return PMU_EVENT_cycle;
+        case SBI_PMU_HW_INSTRUCTIONS:
+            return PMU_EVENT_instret;
+        case SBI_PMU_HW_BRANCH_INSTRUCTIONS:
+            return PMU_EVENT_branch;
+        }
+        break;
+    case SBI_PMU_TYPE_CACHE: {
+        /* code is cache_id[15:3], op_id[2:1] and result_id[0] */
+        const uint32_t cache = code >> 3, op = (code >> 1) & 3;
+        const bool miss = code & SBI_PMU_CACHE_RESULT_MISS;
+        if (cache == SBI_PMU_CACHE_L1D && !miss &&
+            op == SBI_PMU_CACHE_OP_READ)
+            return PMU_EVENT_load;
+        if (cache == SBI_PMU_CACHE_L1D && !miss &&
+            op == SBI_PMU_CACHE_OP_WRITE)
+            return PMU_EVENT_store;
+        if (cache == SBI_PMU_CACHE_DTLB && miss)
+            return PMU_EVENT_dtlb_miss;
+        if (cache == SBI_PMU_CACHE_ITLB && miss)
+            return PMU_EVENT_itlb_miss;
+        break;
+    }
+    case SBI_PMU_TYPE_RAW:
+        if (event_data && event_data < N_PMU_EVENTS)
+            return event_data;
+        break;
+    }
+    return PMU_EVENT_none;
+}
+
+/* Counters 0 and 2 are cycle and instret, which cannot be preset, so events
+ * are matched to mhpmcounter3..31 unless the supervisor picks a counter.
+ */
+static void syscall_sbi_pmu(riscv_t *rv)
+{
+    const riscv_word_t fid = rv_get_reg(rv, rv_reg_a6);
+    const riscv_word_t a0 = rv_get_reg(rv, rv_reg_a0);
+    const riscv_word_t a1 = rv_get_reg(rv, rv_reg_a1);
+    const riscv_word_t a2 = rv_get_reg(rv, rv_reg_a2);
+    const riscv_word_t a3 = rv_get_reg(rv, rv_reg_a3);
+    const riscv_word_t a4 = rv_get_reg(rv, rv_reg_a4);
+    /* a0 is the first counter and a1 the mask of counters from it */
+    const uint64_t mask = (uint64_t) a1 << (a0 < PMU_N_COUNTERS ? a0 : 0);
+    riscv_word_t error = SBI_SUCCESS, value = 0;
+
+    switch (fid) {
+    case SBI_PMU_NUM_COUNTERS:
+        value = PMU_N_COUNTERS;
+        break;
+    case SBI_PMU_COUNTER_GET_INFO:
+        /* a hardware counter read through csr with width 64 */
+        if (a0 < PMU_N_COUNTERS)
+            value = (CSR_CYCLE + a0) | (63 << 12);
+        else
+            error = SBI_ERR_INVALID_PARAM;
+        break;
+    case SBI_PMU_COUNTER_CFG_MATCH: {
+        const uint32_t event = sbi_pmu_event(a3, a4);
+        uint32_t idx = a0;
+        if (!event) {
+            error = SBI_ERR_NOT_SUPPORTED;
+            break;
+        }
+        if (a2 & SBI_PMU_CFG_FLAG_SKIP_MATCH) {
+            /* cycle and instret only count themselves */
+            if ((idx == 0 && event == PMU_EVENT_cycle) ||
+                (idx == 2 && event == PMU_EVENT_instret)) {
+                value = idx;
+                break;
+            }
+            if (idx < PMU_HPM_FIRST || idx >= PMU_N_COUNTERS) {
+                error = SBI_ERR_INVALID_PARAM;
+                break;
+            }
+        } else {
+            for (idx = PMU_HPM_FIRST; idx < PMU_N_COUNTERS; idx++) {
+                if ((mask & (1ULL << idx)) &&
+                    !(rv->sbi_pmu_used & (1U << idx)))
+                    break;
+            }
+            if (idx == PMU_N_COUNTERS) {
+                error = SBI_ERR_NOT_SUPPORTED;
+                break;
+            }
+        }
+
+        rv_pmu_sync(rv);
+        rv->sbi_pmu_used |= 1U << idx;
+        rv->csr_mhpmevent[idx] = event;
+        if (a2 & SBI_PMU_CFG_FLAG_CLEAR_VALUE)
+            rv->csr_mhpmcounter[idx] = 0;
+        if (a2 & SBI_PMU_CFG_FLAG_AUTO_START)
+            rv->csr_mcountinhibit &= ~(1U << idx);
+        else
+            rv->csr_mcountinhibit |= 1U << idx;
+        rv_pmu_rebase(rv);
+        value = idx;
+        break;
+    }
+    case SBI_PMU_COUNTER_START:
+    case SBI_PMU_COUNTER_STOP:
+        if (a0 >= PMU_N_COUNTERS) {
+            error = SBI_ERR_INVALID_PARAM;
+            break;
+        }
+        rv_pmu_sync(rv);
+        for (uint32_t i = PMU_HPM_FIRST; i < PMU_N_COUNTERS; i++) {
+            const uint32_t bit = 1U << i;
+            if (!(mask & bit))
+                continue;
+            if (fid == SBI_PMU_COUNTER_START) {
+                if (!(rv->csr_mcountinhibit & bit))
+                    error = SBI_ERR_ALREADY_STARTED;
+                /* RV32 passes the 64-bit initial value in a3 and a4 */
+                if (a2 & SBI_PMU_START_FLAG_SET_INIT_VALUE)
+                    rv->csr_mhpmcounter[i] = ((uint64_t) a4 << 32) | a3;
+                rv->csr_mcountinhibit &= ~bit;
+            } else {
+                if (rv->csr_mcountinhibit & bit)
+                    error = SBI_ERR_ALREADY_STOPPED;
+                rv->csr_mcountinhibit |= bit;
+                if (a2 & SBI_PMU_STOP_FLAG_RESET) {
+                    rv->sbi_pmu_used &= ~bit;
+                    rv->csr_mhpmevent[i] = PMU_EVENT_none;
+                }
+            }
+        }
+        rv_pmu_rebase(rv);
+        break;
+    default:
+        /* there are no firmware counters to read */
+        error = SBI_ERR_NOT_SUPPORTED;
+        break;
+    }
+
+    rv_set_reg(rv, rv_reg_a0, error);
+    rv_set_reg(rv, rv_reg_a1, value);
+}
 #endif /* SYSTEM */
 
+/* whether the result of a syscall depends on the host, so that it passes
+ * through the replay log
+ */
+static bool syscall_from_host(riscv_word_t syscall)
+{
+    switch (syscall) {
+    case SYS_close:
+    case SYS_lseek:
+    case SYS_read:
+    case SYS_write:
+    case SYS_gettimeofday:
+    case SYS_clock_gettime:
+    case SYS_open:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* the guest memory a syscall served by the host filled in, given its
+ * arguments and result. Return its length.
+ */
+static uint32_t syscall_output(riscv_word_t syscall,
+                               riscv_word_t a0,
+                               riscv_word_t a1,
+                               riscv_word_t ret,
+                               riscv_word_t *addr)
+{
+    switch (syscall) {
+    case SYS_read:
+        *addr = a1;
+        return (int32_t) ret > 0 ? ret : 0;
+    case SYS_gettimeofday:
+        *addr = a0;
+        return a0 ? 16 : 0;
+    case SYS_clock_gettime:
+        *addr = a1;
+        return a1 && !ret ? 16 : 0;
+    default:
+        return 0;
+    }
+}
+
 void syscall_handler(riscv_t *rv)
 {
+    vm_attr_t *attr = PRIV(rv);
+
 /* get the syscall number */
 #if !RV32_HAS(RV32E)
     riscv_word_t syscall = rv_get_reg(rv, rv_reg_a7);
 #else
     riscv_word_t syscall = rv_get_reg(rv, rv_reg_t0);
 #endif
+    const riscv_word_t a0 = rv_get_reg(rv, rv_reg_a0);
+    const riscv_word_t a1 = rv_get_reg(rv, rv_reg_a1);
+
+    /* A replayed run takes the results of host syscalls from the log instead.
+     * Only the output to the console is repeated.
+     */
+    const bool logged = rv->replay && syscall_from_host(syscall);
+    if (logged && replay_playing(rv->replay) &&
+        !(syscall == SYS_write && a0 <= 2))
+        goto replay;
 
     switch (syscall) { /* dispatch system call */
 #define _(name, number)     \
@@ -528,9 +759,20 @@ void syscall_handler(riscv_t *rv)
         break;
     }
 
+replay:
+    if (logged) {
+        riscv_word_t ret = rv_get_reg(rv, rv_reg_a0), addr = 0;
+        replay_input(rv->replay, REPLAY_syscall, &ret, sizeof(ret));
+        rv_set_reg(rv, rv_reg_a0, ret);
+
+        const uint32_t len = syscall_output(syscall, a0, a1, ret, &addr);
+        if (len && GUEST_RAM_CONTAINS(attr->mem, addr, len))
+            replay_input(rv->replay, REPLAY_syscall,
+                         attr->mem->mem_base + addr, len);
+    }
+
     /* save return code.
      * the application decides the usage of the return code
      */
-    vm_attr_t *attr = PRIV(rv);
     attr->error = rv_get_reg(rv, rv_reg_a0);
 }
@@ -102,11 +102,8 @@ static inline uint32_t dtlb_lookup(riscv_t *rv,
         }
 
         *hit = true;
-        /* ppn stores the page-aligned physical address base */
-        uint32_t offset = (entry->level == TLB_PAGE_LEVEL_SUPER)
-                              ? (vaddr & MASK(RV_PG_SHIFT + 10))
-                              : (vaddr & MASK(RV_PG_SHIFT));
-        return entry->ppn | offset;
+        /* ppn stores the physical address of the 4 KiB frame */
+        return entry->ppn | (vaddr & MASK(RV_PG_SHIFT));
     }
 
     *hit = false;
@@ -130,11 +127,8 @@ static inline uint32_t itlb_lookup(riscv_t *rv, uint32_t vaddr, bool *hit)
         }
 
         *hit = true;
-        /* ppn stores the page-aligned physical address base */
-        uint32_t offset = (entry->level == TLB_PAGE_LEVEL_SUPER)
-                              ? (vaddr & MASK(RV_PG_SHIFT + 10))
-                              : (vaddr & MASK(RV_PG_SHIFT));
-        return entry->ppn | offset;
+        /* ppn stores the physical address of the 4 KiB frame */
+        return entry->ppn | (vaddr & MASK(RV_PG_SHIFT));
     }
 
     *hit = false;
@@ -152,12 +146,22 @@ static inline void dtlb_populate(riscv_t *rv,
     uint32_t idx = vpn & TLB_MASK;
     tlb_entry_t *entry = &rv->dtlb[idx];
 
+    rv->pmu_event[PMU_EVENT_dtlb_miss]++;
     entry->vpn = vpn;
-    /* Store page-aligned physical address base (PPN extracted from PTE bits
-     * [31:10], shifted left by 12) */
+    /* Store the physical address of the 4 KiB frame backing vaddr (PPN
+     * extracted from PTE bits [31:10], shifted left by 12). For a superpage
+     * the frame within the 4 MiB region is folded in, so lookups never need
+     * the page level to form the physical address.
+     */
     entry->ppn = *pte >> (RV_PG_SHIFT - 2) << RV_PG_SHIFT;
+    if (level == TLB_PAGE_LEVEL_SUPER)
+        entry->ppn |= vaddr & (MASK(RV_PG_SHIFT + 10) & ~MASK(RV_PG_SHIFT));
     entry->pte_addr = (uint8_t *) pte - attr->mem->mem_base;
     entry->perm = *pte & (PTE_R | PTE_W | PTE_X | PTE_U);
+    /* Resolve RAM versus MMIO once per fill instead of once per access */
+    if ((uint64_t) entry->ppn + RV_PG_SIZE + sizeof(uint32_t) - 1 <=
+        attr->mem->mem_size)
+        entry->perm |= TLB_PERM_RAM;
     entry->dirty = (*pte & PTE_D) ? 1 : 0;
     entry->level = level;
     entry->valid = 1;
@@ -174,10 +178,16 @@ static inline void itlb_populate(riscv_t *rv,
     uint32_t idx = vpn & TLB_MASK;
     tlb_entry_t *entry = &rv->itlb[idx];
 
+    rv->pmu_event[PMU_EVENT_itlb_miss]++;
     entry->vpn = vpn;
-    /* Store page-aligned physical address base (PPN extracted from PTE bits
-     * [31:10], shifted left by 12) */
+    /* Store the physical address of the 4 KiB frame backing vaddr (PPN
+     * extracted from PTE bits [31:10], shifted left by 12). For a superpage
+     * the frame within the 4 MiB region is folded in, so lookups never need
+     * the page level to form the physical address.
+     */
     entry->ppn = *pte >> (RV_PG_SHIFT - 2) << RV_PG_SHIFT;
+    if (level == TLB_PAGE_LEVEL_SUPER)
+        entry->ppn |= vaddr & (MASK(RV_PG_SHIFT + 10) & ~MASK(RV_PG_SHIFT));
     entry->pte_addr = (uint8_t *) pte - attr->mem->mem_base;
     entry->perm = *pte & (PTE_R | PTE_W | PTE_X | PTE_U);
     entry->dirty = (*pte & PTE_D) ? 1 : 0;
@@ -604,5 +614,8 @@ riscv_io_t mmu_io = {
     .on_ebreak = ebreak_handler,
     .on_memcpy = memcpy_handler,
     .on_memset = memset_handler,
+    .on_memmove = memmove_handler,
+    .on_memcmp = memcmp_handler,
+    .on_strlen = strlen_handler,
     .on_trap = trap_handler,
 };
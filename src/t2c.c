@@ -4,13 +4,18 @@
  */
 
 #include <llvm-c/Analysis.h>
+#include <llvm-c/BitReader.h>
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/Core.h>
 #include <llvm-c/ExecutionEngine.h>
 #include <llvm-c/Target.h>
 #include <llvm-c/Transforms/PassBuilder.h>
 #include <llvm/Config/llvm-config.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 /* LLVM version compatibility check.
  * T2C requires LLVM 18-21 for the following APIs:
@@ -37,6 +42,13 @@
 
 #define MAX_BLOCKS 8152
 
+/* A callee is inlined into the region when its ELF symbol is at most this
+ * many bytes long.
+ */
+#define T2C_INLINE_FUNC_SIZE 256
+/* Maximum number of inlined calls and of returns resolved in a region */
+#define T2C_REGION_RETURNS 64
+
 struct LLVM_block_map_entry {
     uint32_t pc;
     LLVMBasicBlockRef block;
@@ -72,14 +84,16 @@ FORCE_INLINE LLVMBasicBlockRef t2c_block_map_search(struct LLVM_block_map *map,
 
 /* T2C_OP generates code for each RISC-V instruction with batched cycle updates.
  *
- * Cycle optimization: Instead of updating rv->csr_cycle per instruction, we
- * increment a local counter (alloca) and store to csr_cycle only at block
- * exits. This reduces memory traffic significantly - LLVM's mem2reg pass
- * promotes the alloca to a register, making per-instruction increments free.
+ * Cycle optimization: Instead of updating rv->csr_cycle per instruction, a
+ * local counter (alloca) holds the cycles charged up to the entry of the
+ * current block, the same scheme as the interpreter. It is advanced by
+ * ir->cycle_ofs only on branches between the blocks of the trace, and the
+ * offset of the exiting IR is added when the count is stored at an exit.
+ * t2c_instret_counter follows ir->insn_ofs the same way for rv->csr_instret.
  *
  * The insn_counter parameter is an alloca created at function entry in
  * t2c_compile(). Before any LLVMBuildRetVoid(), T2C_STORE_TIMER must be called
- * to flush the accumulated count to rv->csr_cycle.
+ * to flush the accumulated counts to rv->csr_cycle and rv->csr_instret.
  */
 #define T2C_OP(inst, code)                                                     \
     static void t2c_##inst(                                                    \
@@ -87,16 +101,9 @@ FORCE_INLINE LLVMBasicBlockRef t2c_block_map_search(struct LLVM_block_map *map,
         LLVMValueRef start UNUSED, LLVMBasicBlockRef *entry UNUSED,            \
         LLVMBuilderRef *taken_builder UNUSED,                                  \
         LLVMBuilderRef *untaken_builder UNUSED, riscv_t *rv UNUSED,            \
-        uint64_t mem_base UNUSED, block_t *block UNUSED, rv_insn_t *ir UNUSED, \
-        LLVMValueRef insn_counter UNUSED)                                      \
+        LLVMValueRef mem_base UNUSED, block_t *block UNUSED,                   \
+        rv_insn_t *ir UNUSED, LLVMValueRef insn_counter UNUSED)                \
     {                                                                          \
-        /* Increment local instruction counter (promoted to register by LLVM)  \
-         */                                                                    \
-        LLVMValueRef cnt =                                                     \
-            LLVMBuildLoad2(*builder, LLVMInt64Type(), insn_counter, "");       \
-        cnt = LLVMBuildAdd(*builder, cnt,                                      \
-                           LLVMConstInt(LLVMInt64Type(), 1, false), "");       \
-        LLVMBuildStore(*builder, cnt, insn_counter);                           \
         code;                                                                  \
     }
 
@@ -111,15 +118,44 @@ FORCE_INLINE LLVMBasicBlockRef t2c_block_map_search(struct LLVM_block_map *map,
                                      LLVMGetParam(start, 0), &offset, 1, ""); \
     }
 
-T2C_LLVM_GEN_ADDR(rs1, X, ir->rs1);
-T2C_LLVM_GEN_ADDR(rs2, X, ir->rs2);
-T2C_LLVM_GEN_ADDR(rd, X, ir->rd);
-#if RV32_HAS(EXT_C)
-T2C_LLVM_GEN_ADDR(ra, X, rv_reg_ra);
-T2C_LLVM_GEN_ADDR(sp, X, rv_reg_sp);
-#endif
 T2C_LLVM_GEN_ADDR(PC, PC, 0);
 T2C_LLVM_GEN_ADDR(csr_cycle, csr_cycle, 0);
+T2C_LLVM_GEN_ADDR(csr_instret, csr_instret, 0);
+
+/* Retired instruction counter of the region being compiled, an alloca in the
+ * entry block next to the cycle counter that T2C_OP handlers receive.
+ */
+static LLVMValueRef t2c_instret_counter;
+
+/* Guest registers of the region being compiled. Each one is an alloca in the
+ * entry block, so that mem2reg keeps it in an SSA value across the whole
+ * region instead of going through rv->X at every instruction. Once the region
+ * is built, t2c_sync_regs() loads them at the entry and writes them back
+ * around calls and before exits. Only the T2C thread compiles.
+ */
+static LLVMValueRef t2c_regs[N_RV_REGS];
+
+FORCE_INLINE LLVMValueRef t2c_gen_reg_addr(LLVMValueRef start UNUSED,
+                                           LLVMBuilderRef *builder UNUSED,
+                                           uint32_t reg)
+{
+    return t2c_regs[reg];
+}
+
+#define T2C_LLVM_GEN_REG_ADDR(reg, ir_member)                              \
+    FORCE_INLINE LLVMValueRef t2c_gen_##reg##_addr(                        \
+        LLVMValueRef start, LLVMBuilderRef *builder, UNUSED rv_insn_t *ir) \
+    {                                                                      \
+        return t2c_gen_reg_addr(start, builder, ir_member);                \
+    }
+
+T2C_LLVM_GEN_REG_ADDR(rs1, ir->rs1);
+T2C_LLVM_GEN_REG_ADDR(rs2, ir->rs2);
+T2C_LLVM_GEN_REG_ADDR(rd, ir->rd);
+#if RV32_HAS(EXT_C)
+T2C_LLVM_GEN_REG_ADDR(ra, rv_reg_ra);
+T2C_LLVM_GEN_REG_ADDR(sp, rv_reg_sp);
+#endif
 
 #define T2C_LLVM_GEN_STORE_IMM32(builder, val, addr) \
     LLVMBuildStore(builder, LLVMConstInt(LLVMInt32Type(), val, true), addr)
@@ -142,8 +178,10 @@ T2C_LLVM_GEN_ADDR(csr_cycle, csr_cycle, 0);
         LLVMBuildICmp(*builder, LLVMInt##cond, rs1, \
                       LLVMConstInt(LLVMInt32Type(), imm, false), "")
 
-/* Store accumulated instruction count to rv->csr_cycle before block exit.
- * Called before every LLVMBuildRetVoid() to flush the counter.
+/* Store accumulated counts to rv->csr_cycle and rv->csr_instret before block
+ * exit. Called before every LLVMBuildRetVoid() to flush the counters, with the
+ * IR that leaves the trace so that its ir->cycle_ofs and ir->insn_ofs are
+ * included.
  * The insn_counter is an alloca that LLVM's mem2reg promotes to a register.
  *
  * Uses atomic add (LLVMBuildAtomicRMW) for thread safety:
@@ -155,31 +193,158 @@ T2C_LLVM_GEN_ADDR(csr_cycle, csr_cycle, 0);
  * - SYSTEM mode: timer interrupts work correctly (timer = csr_cycle + offset)
  * - Non-SYSTEM mode: RDCYCLE instruction returns accurate counts
  */
-#define T2C_STORE_TIMER(bldr, start_val, counter)                         \
-    do {                                                                  \
-        LLVMValueRef _cycle_ptr =                                         \
-            t2c_gen_csr_cycle_addr(start_val, &(bldr), NULL);             \
-        LLVMValueRef _cnt =                                               \
-            LLVMBuildLoad2(bldr, LLVMInt64Type(), counter, "");           \
-        LLVMBuildAtomicRMW(bldr, LLVMAtomicRMWBinOpAdd, _cycle_ptr, _cnt, \
-                           LLVMAtomicOrderingMonotonic, false);           \
+#define T2C_STORE_TIMER(bldr, start_val, counter, exit_ir)                   \
+    do {                                                                     \
+        LLVMValueRef _cycle_ptr =                                            \
+            t2c_gen_csr_cycle_addr(start_val, &(bldr), NULL);                \
+        LLVMValueRef _cnt =                                                  \
+            LLVMBuildLoad2(bldr, LLVMInt64Type(), counter, "");              \
+        _cnt = LLVMBuildAdd(                                                 \
+            bldr, _cnt,                                                      \
+            LLVMConstInt(LLVMInt64Type(), (exit_ir)->cycle_ofs, false),      \
+            "");                                                             \
+        LLVMBuildAtomicRMW(bldr, LLVMAtomicRMWBinOpAdd, _cycle_ptr, _cnt,    \
+                           LLVMAtomicOrderingMonotonic, false);              \
+        LLVMValueRef _instret_ptr =                                          \
+            t2c_gen_csr_instret_addr(start_val, &(bldr), NULL);              \
+        LLVMValueRef _insns = LLVMBuildLoad2(bldr, LLVMInt64Type(),          \
+                                             t2c_instret_counter, "");       \
+        _insns = LLVMBuildAdd(                                               \
+            bldr, _insns,                                                    \
+            LLVMConstInt(LLVMInt64Type(), (exit_ir)->insn_ofs, false), "");  \
+        LLVMBuildAtomicRMW(bldr, LLVMAtomicRMWBinOpAdd, _instret_ptr, _insns, \
+                           LLVMAtomicOrderingMonotonic, false);              \
+    } while (0)
+
+/* Account the instructions of the block ending at @exit_ir when the trace
+ * branches to the entry of another block.
+ */
+#define T2C_ADVANCE_COUNTER(bldr, counter, exit_ir)                        \
+    do {                                                                   \
+        LLVMValueRef _cnt =                                                \
+            LLVMBuildLoad2(bldr, LLVMInt64Type(), counter, "");            \
+        _cnt = LLVMBuildAdd(                                               \
+            bldr, _cnt,                                                    \
+            LLVMConstInt(LLVMInt64Type(), (exit_ir)->cycle_ofs, false),    \
+            "");                                                           \
+        LLVMBuildStore(bldr, _cnt, counter);                               \
+        LLVMValueRef _insns = LLVMBuildLoad2(bldr, LLVMInt64Type(),        \
+                                             t2c_instret_counter, "");     \
+        _insns = LLVMBuildAdd(                                             \
+            bldr, _insns,                                                  \
+            LLVMConstInt(LLVMInt64Type(), (exit_ir)->insn_ofs, false), ""); \
+        LLVMBuildStore(bldr, _insns, t2c_instret_counter);                 \
     } while (0)
 
+/* Guest accesses carry a TBAA type of their own, apart from the emulator state
+ * in riscv_t, so that LLVM knows a guest store never clobbers that state.
+ * Only the T2C thread compiles, and the tags belong to the global context.
+ */
+static void t2c_set_tbaa(LLVMValueRef access, bool guest)
+{
+    static LLVMValueRef tags[2];
+    LLVMContextRef ctx = LLVMGetGlobalContext();
+    if (!tags[0]) {
+        static const char *const names[] = {"vm state", "guest memory"};
+        LLVMMetadataRef root_name =
+            LLVMMDStringInContext2(ctx, "rv32emu T2C", 11);
+        LLVMMetadataRef root = LLVMMDNodeInContext2(ctx, &root_name, 1);
+        LLVMMetadataRef offset =
+            LLVMValueAsMetadata(LLVMConstInt(LLVMInt64Type(), 0, false));
+        for (int i = 0; i < 2; i++) {
+            LLVMMetadataRef type_ops[] = {
+                LLVMMDStringInContext2(ctx, names[i], strlen(names[i])),
+                root,
+                offset,
+            };
+            LLVMMetadataRef type = LLVMMDNodeInContext2(ctx, type_ops, 3);
+            LLVMMetadataRef tag_ops[] = {type, type, offset};
+            tags[i] = LLVMMetadataAsValue(
+                ctx, LLVMMDNodeInContext2(ctx, tag_ops, 3));
+        }
+    }
+    LLVMSetMetadata(access, LLVMGetMDKindIDInContext(ctx, "tbaa", 4),
+                    tags[guest]);
+}
+
+/* Host addresses that differ between runs, such as the guest memory and the
+ * profile counters, are referenced through external globals of these names
+ * and bound when the code is loaded. The IR of a trace thus only depends on
+ * the guest code, which lets the object cache below key on it.
+ */
+#define T2C_SYM_MEM "t2c_mem"
+#define T2C_SYM_PROFILE "t2c_profile"
+
+static LLVMValueRef t2c_get_extern(LLVMModuleRef module, const char *name)
+{
+    LLVMValueRef sym = LLVMGetNamedGlobal(module, name);
+    if (!sym)
+        sym = LLVMAddGlobal(module, LLVMArrayType(LLVMInt8Type(), 0), name);
+    return sym;
+}
+
+FORCE_INLINE LLVMModuleRef t2c_builder_module(LLVMBuilderRef builder)
+{
+    return LLVMGetGlobalParent(
+        LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder)));
+}
+
+/* Set when the guest memory spans the whole 32-bit address space. As every
+ * guest address is the 32-bit sum the interpreter computes, it then always
+ * lands in the mapping, which proves the accesses in bounds once per
+ * compilation instead of per access.
+ */
+static bool t2c_mem_inbounds;
+
+/* Host pointer to the guest address vaddr in user mode */
+UNUSED static LLVMValueRef t2c_gen_guest_addr(LLVMBuilderRef builder,
+                                              LLVMValueRef vaddr,
+                                              LLVMValueRef mem_base)
+{
+    LLVMValueRef base = LLVMBuildPointerCast(
+        builder, mem_base, LLVMPointerType(LLVMInt8Type(), 0), "");
+    LLVMValueRef offset = LLVMBuildZExt(builder, vaddr, LLVMInt64Type(), "");
+    if (t2c_mem_inbounds)
+        return LLVMBuildInBoundsGEP2(builder, LLVMInt8Type(), base, &offset, 1,
+                                     "");
+    return LLVMBuildGEP2(builder, LLVMInt8Type(), base, &offset, 1, "");
+}
+
+/* Guest accesses may be misaligned, so they assume no alignment. This also
+ * keeps vectorized guest loops on unaligned host vector accesses.
+ */
+UNUSED static LLVMValueRef t2c_gen_guest_load(LLVMBuilderRef builder,
+                                              LLVMTypeRef type,
+                                              LLVMValueRef ptr)
+{
+    ptr = LLVMBuildPointerCast(builder, ptr, LLVMPointerType(type, 0), "");
+    LLVMValueRef val = LLVMBuildLoad2(builder, type, ptr, "");
+    LLVMSetAlignment(val, 1);
+    t2c_set_tbaa(val, true);
+    return val;
+}
+
+UNUSED static void t2c_gen_guest_store(LLVMBuilderRef builder,
+                                       LLVMValueRef val,
+                                       LLVMValueRef ptr)
+{
+    ptr = LLVMBuildPointerCast(builder, ptr,
+                               LLVMPointerType(LLVMTypeOf(val), 0), "");
+    LLVMValueRef store = LLVMBuildStore(builder, val, ptr);
+    LLVMSetAlignment(store, 1);
+    t2c_set_tbaa(store, true);
+}
+
 UNUSED FORCE_INLINE LLVMValueRef t2c_gen_mem_loc(LLVMValueRef start,
                                                  LLVMBuilderRef *builder,
                                                  UNUSED rv_insn_t *ir,
-                                                 uint64_t mem_base)
+                                                 LLVMValueRef mem_base)
 {
-    LLVMValueRef val_rs1 =
-        LLVMBuildZExt(*builder,
-                      LLVMBuildLoad2(*builder, LLVMInt32Type(),
-                                     t2c_gen_rs1_addr(start, builder, ir), ""),
-                      LLVMInt64Type(), "");
-    LLVMValueRef addr =
-        T2C_LLVM_GEN_ALU64_IMM(Add, val_rs1, ir->imm + mem_base);
-    addr = LLVMBuildIntToPtr(*builder, addr,
-                             LLVMPointerType(LLVMInt32Type(), 0), "");
-    return addr;
+    LLVMValueRef val_rs1 = LLVMBuildLoad2(
+        *builder, LLVMInt32Type(), t2c_gen_rs1_addr(start, builder, ir), "");
+    /* wrap around within 32 bits like the interpreter */
+    LLVMValueRef vaddr = T2C_LLVM_GEN_ALU32_IMM(Add, val_rs1, ir->imm);
+    return t2c_gen_guest_addr(*builder, vaddr, mem_base);
 }
 
 /* Load and call a function pointer from rv->io struct.
@@ -223,6 +388,225 @@ static LLVMTypeRef t2c_jit_cache_func_type;
 static LLVMTypeRef t2c_jit_cache_struct_type;
 static LLVMTypeRef t2c_inline_cache_struct_type;
 
+/* Profile of the trace being compiled. Only the T2C thread compiles, so it is
+ * kept next to the LLVM types above. A quick-tier compilation fills in
+ * t2c_profile_out, a recompilation reads the counts from t2c_profile_in.
+ */
+static t2c_profile_t *t2c_profile_out;
+static const t2c_profile_t *t2c_profile_in;
+
+/* Increment a counter of t2c_profile_out from the generated code and return
+ * its new value. Only the thread running the code writes the counters, so the
+ * load and the store are atomic just for whole values to be read elsewhere,
+ * and the increment needs no locked instruction.
+ */
+static LLVMValueRef t2c_gen_count(LLVMBuilderRef builder,
+                                  uint32_t *counter,
+                                  LLVMValueRef idx)
+{
+    LLVMValueRef ofs = LLVMConstInt(
+        LLVMInt64Type(), (uintptr_t) counter - (uintptr_t) t2c_profile_out,
+        false);
+    LLVMValueRef ptr = LLVMBuildGEP2(
+        builder, LLVMInt8Type(),
+        LLVMBuildPointerCast(
+            builder,
+            t2c_get_extern(t2c_builder_module(builder), T2C_SYM_PROFILE),
+            LLVMPointerType(LLVMInt8Type(), 0), ""),
+        &ofs, 1, "");
+    ptr = LLVMBuildPointerCast(builder, ptr,
+                               LLVMPointerType(LLVMInt32Type(), 0), "");
+    if (idx)
+        ptr = LLVMBuildInBoundsGEP2(builder, LLVMInt32Type(), ptr, &idx, 1, "");
+    LLVMValueRef val = LLVMBuildLoad2(builder, LLVMInt32Type(), ptr, "");
+    LLVMSetOrdering(val, LLVMAtomicOrderingMonotonic);
+    LLVMSetAlignment(val, 4);
+    val = LLVMBuildAdd(builder, val, LLVMConstInt(LLVMInt32Type(), 1, false),
+                       "");
+    LLVMValueRef store = LLVMBuildStore(builder, val, ptr);
+    LLVMSetOrdering(store, LLVMAtomicOrderingMonotonic);
+    LLVMSetAlignment(store, 4);
+    return val;
+}
+
+/* Count an entry into the trace */
+FORCE_INLINE void t2c_gen_heat(LLVMBuilderRef builder)
+{
+    if (t2c_profile_out)
+        t2c_gen_count(builder, &t2c_profile_out->heat, NULL);
+}
+
+/* Count a jump back to the block at pc, which ends the block of exit_ir.
+ * Once the heat passes T2C_RECOMPILE_THRESHOLD, the quick-tier code leaves
+ * for pc every T2C_HEAT_EXIT_INTERVAL jumps, so that rv_step() queues the
+ * recompilation and enters the recompiled code once it is installed, rather
+ * than the trace looping in itself for as long as the guest does.
+ */
+static void t2c_gen_back_edge(LLVMBuilderRef builder,
+                              LLVMValueRef start,
+                              LLVMValueRef insn_counter,
+                              const rv_insn_t *exit_ir,
+                              uint32_t pc)
+{
+    if (!t2c_profile_out)
+        return;
+    LLVMValueRef heat = t2c_gen_count(builder, &t2c_profile_out->heat, NULL);
+    LLVMValueRef past = LLVMBuildICmp(
+        builder, LLVMIntUGE, heat,
+        LLVMConstInt(LLVMInt32Type(), T2C_RECOMPILE_THRESHOLD, false), "");
+    LLVMValueRef due = LLVMBuildICmp(
+        builder, LLVMIntEQ,
+        LLVMBuildAnd(
+            builder, heat,
+            LLVMConstInt(LLVMInt32Type(), T2C_HEAT_EXIT_INTERVAL - 1, false),
+            ""),
+        LLVMConstInt(LLVMInt32Type(), 0, false), "");
+    LLVMBasicBlockRef leave = LLVMAppendBasicBlock(start, "heat_exit");
+    LLVMBasicBlockRef stay = LLVMAppendBasicBlock(start, "heat_stay");
+    LLVMBuildCondBr(builder, LLVMBuildAnd(builder, past, due, ""), leave, stay);
+
+    LLVMBuilderRef leave_builder = LLVMCreateBuilder();
+    LLVMPositionBuilderAtEnd(leave_builder, leave);
+    T2C_LLVM_GEN_STORE_IMM32(leave_builder, pc,
+                             t2c_gen_PC_addr(start, &leave_builder, NULL));
+    T2C_STORE_TIMER(leave_builder, start, insn_counter, exit_ir);
+    LLVMBuildRetVoid(leave_builder);
+    LLVMDisposeBuilder(leave_builder);
+
+    LLVMPositionBuilderAtEnd(builder, stay);
+}
+
+static const t2c_branch_count_t *t2c_profile_find(const t2c_profile_t *profile,
+                                                  const rv_insn_t *ir)
+{
+    for (uint32_t i = 0; i < profile->n_branch; i++) {
+        if (profile->branch[i].ir == ir)
+            return &profile->branch[i];
+    }
+    return NULL;
+}
+
+/* LLVM only uses the ratio of the branch weights, so they keep their four
+ * leading bits. Recompilations of a trace in different runs then mostly agree
+ * on the weights and share their object cache entry.
+ */
+static uint32_t t2c_round_weight(uint32_t count)
+{
+    if (count < 16)
+        return count;
+    const int shift = ilog2(count) - 3;
+    return (count >> shift) << shift;
+}
+
+/* Emit the conditional branch of ir, counting its outcome in the quick tier
+ * and annotating it with the counted outcomes when recompiling.
+ */
+static void t2c_gen_cond_br(LLVMBuilderRef builder,
+                            const rv_insn_t *ir,
+                            LLVMValueRef cmp,
+                            LLVMBasicBlockRef taken,
+                            LLVMBasicBlockRef untaken)
+{
+    if (t2c_profile_out && t2c_profile_out->n_branch < T2C_PROFILE_BRANCHES) {
+        t2c_branch_count_t *cnt =
+            &t2c_profile_out->branch[t2c_profile_out->n_branch++];
+        cnt->ir = ir;
+        /* count[0] when taken, count[1] otherwise */
+        LLVMValueRef idx = LLVMBuildZExt(
+            builder, LLVMBuildNot(builder, cmp, ""), LLVMInt64Type(), "");
+        t2c_gen_count(builder, cnt->count, idx);
+    }
+
+    LLVMValueRef br = LLVMBuildCondBr(builder, cmp, taken, untaken);
+
+    const t2c_branch_count_t *cnt =
+        t2c_profile_in ? t2c_profile_find(t2c_profile_in, ir) : NULL;
+    if (!cnt)
+        return;
+    LLVMContextRef ctx = LLVMGetGlobalContext();
+    LLVMMetadataRef weights[] = {
+        LLVMMDStringInContext2(ctx, "branch_weights", 14),
+        LLVMValueAsMetadata(LLVMConstInt(
+            LLVMInt32Type(),
+            t2c_round_weight(ATOMIC_LOAD(&cnt->count[0], ATOMIC_RELAXED)),
+            false)),
+        LLVMValueAsMetadata(LLVMConstInt(
+            LLVMInt32Type(),
+            t2c_round_weight(ATOMIC_LOAD(&cnt->count[1], ATOMIC_RELAXED)),
+            false)),
+    };
+    LLVMSetMetadata(br, LLVMGetMDKindIDInContext(ctx, "prof", 4),
+                    LLVMMetadataAsValue(ctx, LLVMMDNodeInContext2(
+                                                 ctx, weights, 3)));
+}
+
+/* jal ra, or c.jal */
+FORCE_INLINE bool t2c_insn_is_call(const rv_insn_t *ir)
+{
+    return (ir->opcode == rv_insn_jal && ir->rd == rv_reg_ra)
+#if RV32_HAS(EXT_C)
+           || ir->opcode == rv_insn_cjal
+#endif
+        ;
+}
+
+/* jalr ra, such as the auipc/jalr pair of a far call, or c.jalr */
+FORCE_INLINE bool t2c_insn_is_indirect_call(const rv_insn_t *ir)
+{
+    return (ir->opcode == rv_insn_jalr && ir->rd == rv_reg_ra)
+#if RV32_HAS(EXT_C)
+           || ir->opcode == rv_insn_cjalr
+#endif
+        ;
+}
+
+FORCE_INLINE bool t2c_insn_is_return(const rv_insn_t *ir)
+{
+    return (ir->opcode == rv_insn_jalr && !ir->rd && ir->rs1 == rv_reg_ra &&
+            !ir->imm)
+#if RV32_HAS(EXT_C)
+           || (ir->opcode == rv_insn_cjr && ir->rs1 == rv_reg_ra)
+#endif
+        ;
+}
+
+/* Calls inlined into the region being compiled. Before an indirect call or a
+ * return falls back to the cache lookup, its target is matched against the
+ * callees and the return points in the region, so that an inlined callee is
+ * entered and returns to its caller without leaving the region.
+ */
+static struct {
+    uint32_t n_ret;
+    uint32_t ret_pc[T2C_REGION_RETURNS];
+    uint32_t n_site;
+    struct {
+        LLVMValueRef sw;
+        const rv_insn_t *ir;
+    } site[T2C_REGION_RETURNS];
+} t2c_region;
+
+/* Emit the dispatch of an indirect call or a return into the region. The
+ * cases are added by t2c_link_region() once the region is complete; the
+ * builder is left on the path for targets outside of it.
+ */
+static void t2c_gen_region_jump(LLVMBuilderRef *builder,
+                                LLVMValueRef start,
+                                LLVMValueRef addr,
+                                const rv_insn_t *ir)
+{
+    if (t2c_region.n_site == T2C_REGION_RETURNS)
+        return;
+    if (!t2c_insn_is_return(ir) &&
+        !(t2c_insn_is_indirect_call(ir) && ir->branch_table))
+        return;
+
+    LLVMBasicBlockRef miss = LLVMAppendBasicBlock(start, "region_miss");
+    t2c_region.site[t2c_region.n_site].sw =
+        LLVMBuildSwitch(*builder, addr, miss, 0);
+    t2c_region.site[t2c_region.n_site++].ir = ir;
+    LLVMPositionBuilderAtEnd(*builder, miss);
+}
+
 #include "t2c_template.c"
 #undef T2C_OP
 
@@ -265,11 +649,90 @@ typedef void (*t2c_codegen_block_func_t)(LLVMBuilderRef *builder UNUSED,
                                          LLVMBuilderRef *taken_builder UNUSED,
                                          LLVMBuilderRef *untaken_builder UNUSED,
                                          riscv_t *rv UNUSED,
-                                         uint64_t mem_base UNUSED,
+                                         LLVMValueRef mem_base UNUSED,
                                          block_t *block UNUSED,
                                          rv_insn_t *ir UNUSED,
                                          LLVMValueRef insn_counter UNUSED);
 
+/* Whether the callee entered at pc is small enough to be inlined into the
+ * region. The size comes from the ELF symbols; without one, only a callee
+ * whose entry block already returns, i.e. a single-block leaf, qualifies.
+ */
+static bool t2c_can_inline(riscv_t *rv, uint32_t pc)
+{
+    if (rv->t2c_funcs) {
+        map_iter_t it;
+        map_find(rv->t2c_funcs, &it, &pc);
+        if (!map_at_end(rv->t2c_funcs, &it))
+            return map_iter_value(&it, uint32_t) <= T2C_INLINE_FUNC_SIZE;
+    }
+    const block_t *blk = cache_get(rv->block_cache, pc, false);
+    return blk && t2c_insn_is_return(blk->ir_tail);
+}
+
+static void t2c_trace_ebb(LLVMBuilderRef *builder,
+                          LLVMTypeRef *param_types UNUSED,
+                          LLVMValueRef start,
+                          LLVMBasicBlockRef *entry,
+                          riscv_t *rv,
+                          block_t *block,
+                          set_t *set,
+                          struct LLVM_block_map *map,
+                          LLVMValueRef insn_counter);
+
+/* Trace the block at pc into the region, where it is only entered through
+ * t2c_link_region(). Return whether the block is part of the region.
+ */
+static bool t2c_trace_entry(LLVMTypeRef *param_types,
+                            LLVMValueRef start,
+                            riscv_t *rv,
+                            block_t *block,
+                            set_t *set,
+                            struct LLVM_block_map *map,
+                            LLVMValueRef insn_counter,
+                            uint32_t pc)
+{
+    if (set_has(set, pc))
+        return true;
+    if (!t2c_check_valid_blk(rv, block, pc))
+        return false;
+
+    block_t *blk = cache_get(rv->block_cache, pc, false);
+    LLVMBasicBlockRef region_entry =
+        LLVMAppendBasicBlock(start, "region_entry");
+    LLVMBuilderRef region_builder = LLVMCreateBuilder();
+    LLVMPositionBuilderAtEnd(region_builder, region_entry);
+    t2c_trace_ebb(&region_builder, param_types, start, &region_entry, rv, blk,
+                  set, map, insn_counter);
+    LLVMDisposeBuilder(region_builder);
+    return true;
+}
+
+/* Continue the region at the return point of a call whose callee is part of
+ * it, so that the callee returns to its caller within the region.
+ */
+static void t2c_trace_return(LLVMTypeRef *param_types,
+                             LLVMValueRef start,
+                             riscv_t *rv,
+                             block_t *block,
+                             set_t *set,
+                             struct LLVM_block_map *map,
+                             LLVMValueRef insn_counter,
+                             const rv_insn_t *ir)
+{
+    const bool is_rvc = ir->opcode != rv_insn_jal && ir->opcode != rv_insn_jalr;
+    uint32_t return_pc = ir->pc + (is_rvc ? 2 : 4);
+    for (uint32_t i = 0; i < t2c_region.n_ret; i++) {
+        if (t2c_region.ret_pc[i] == return_pc)
+            return;
+    }
+    if (t2c_region.n_ret == T2C_REGION_RETURNS)
+        return;
+    t2c_region.ret_pc[t2c_region.n_ret++] = return_pc;
+    t2c_trace_entry(param_types, start, rv, block, set, map, insn_counter,
+                    return_pc);
+}
+
 static void t2c_trace_ebb(LLVMBuilderRef *builder,
                           LLVMTypeRef *param_types UNUSED,
                           LLVMValueRef start,
@@ -288,9 +751,8 @@ static void t2c_trace_ebb(LLVMBuilderRef *builder,
     t2c_block_map_insert(map, entry, ir->pc);
     LLVMBuilderRef tk = NULL, utk = NULL;
 
-    /* Get mem_base once at the start, not on every instruction */
-    vm_attr_t *priv = PRIV(rv);
-    uint64_t mem_base = (uint64_t) ((memory_t *) priv->mem)->mem_base;
+    LLVMValueRef mem_base =
+        t2c_get_extern(LLVMGetGlobalParent(start), T2C_SYM_MEM);
 
     while (1) {
         ((t2c_codegen_block_func_t) dispatch_table[ir->opcode])(
@@ -317,6 +779,8 @@ static void t2c_trace_ebb(LLVMBuilderRef *builder,
             /* Cache untaken_pc to avoid race condition with main thread */
             uint32_t untaken_pc = ir->branch_untaken->pc;
             if (set_has(set, untaken_pc)) {
+                t2c_gen_back_edge(utk, start, insn_counter, ir, untaken_pc);
+                T2C_ADVANCE_COUNTER(utk, insn_counter, ir);
                 LLVMBuildBr(utk, t2c_block_map_search(map, untaken_pc));
             } else {
                 block_t *blk = cache_get(rv->block_cache, untaken_pc, false);
@@ -329,6 +793,7 @@ static void t2c_trace_ebb(LLVMBuilderRef *builder,
                         LLVMAppendBasicBlock(start, "untaken_entry");
                     LLVMBuilderRef untaken_builder = LLVMCreateBuilder();
                     LLVMPositionBuilderAtEnd(untaken_builder, untaken_entry);
+                    T2C_ADVANCE_COUNTER(utk, insn_counter, ir);
                     LLVMBuildBr(utk, untaken_entry);
                     t2c_trace_ebb(&untaken_builder, param_types, start,
                                   &untaken_entry, rv, blk, set, map,
@@ -339,7 +804,10 @@ static void t2c_trace_ebb(LLVMBuilderRef *builder,
         }
         if (ir->branch_taken) {
             uint32_t taken_pc = ir->branch_taken->pc;
-            if (set_has(set, taken_pc)) {
+            const bool in_region = set_has(set, taken_pc);
+            if (in_region) {
+                t2c_gen_back_edge(tk, start, insn_counter, ir, taken_pc);
+                T2C_ADVANCE_COUNTER(tk, insn_counter, ir);
                 LLVMBuildBr(tk, t2c_block_map_search(map, taken_pc));
             } else {
                 /* Use stored taken_pc instead of re-reading
@@ -355,6 +823,7 @@ static void t2c_trace_ebb(LLVMBuilderRef *builder,
                         LLVMAppendBasicBlock(start, "taken_entry");
                     LLVMBuilderRef taken_builder = LLVMCreateBuilder();
                     LLVMPositionBuilderAtEnd(taken_builder, taken_entry);
+                    T2C_ADVANCE_COUNTER(tk, insn_counter, ir);
                     LLVMBuildBr(tk, taken_entry);
                     t2c_trace_ebb(&taken_builder, param_types, start,
                                   &taken_entry, rv, blk, set, map,
@@ -362,18 +831,410 @@ static void t2c_trace_ebb(LLVMBuilderRef *builder,
                     LLVMDisposeBuilder(taken_builder);
                 }
             }
+            /* A callee already in the region, e.g. a recursive one, costs
+             * nothing more; otherwise only a small one is worth keeping the
+             * caller around.
+             */
+            if (t2c_insn_is_call(ir) && set_has(set, taken_pc) &&
+                (in_region || t2c_can_inline(rv, taken_pc)))
+                t2c_trace_return(param_types, start, rv, block, set, map,
+                                 insn_counter, ir);
         }
+    } else if (t2c_insn_is_indirect_call(ir) && ir->branch_table) {
+        /* Inline the targets recorded by the branch history table, which
+         * t2c_link_region() dispatches to from the call.
+         */
+        const branch_history_table_t *bt = ir->branch_table;
+        bool inlined = false;
+        for (int i = 0; i < HISTORY_SIZE; i++) {
+            uint32_t target_pc = bt->PC[i];
+            if (!bt->times[i])
+                continue;
+            if (set_has(set, target_pc) ||
+                (t2c_can_inline(rv, target_pc) &&
+                 t2c_trace_entry(param_types, start, rv, block, set, map,
+                                 insn_counter, target_pc)))
+                inlined = true;
+        }
+        if (inlined)
+            t2c_trace_return(param_types, start, rv, block, set, map,
+                             insn_counter, ir);
     }
 }
 
+/* Jump from the dispatch of an indirect call or a return to a block of the
+ * region, accounting for the block that ends at ir.
+ */
+static void t2c_add_region_case(LLVMValueRef start,
+                                LLVMValueRef sw,
+                                const rv_insn_t *ir,
+                                LLVMValueRef insn_counter,
+                                uint32_t pc,
+                                LLVMBasicBlockRef target)
+{
+    LLVMBasicBlockRef bb = LLVMAppendBasicBlock(start, "region_hit");
+    LLVMBuilderRef builder = LLVMCreateBuilder();
+    LLVMPositionBuilderAtEnd(builder, bb);
+    t2c_gen_back_edge(builder, start, insn_counter, ir, pc);
+    T2C_ADVANCE_COUNTER(builder, insn_counter, ir);
+    LLVMBuildBr(builder, target);
+    LLVMDisposeBuilder(builder);
+    LLVMAddCase(sw, LLVMConstInt(LLVMInt32Type(), pc, false), bb);
+}
+
+/* Add the callees and the return points traced into the region to the
+ * dispatch of each indirect call and return of it.
+ */
+static void t2c_link_region(LLVMValueRef start,
+                            struct LLVM_block_map *map,
+                            LLVMValueRef insn_counter)
+{
+    for (uint32_t i = 0; i < t2c_region.n_site; i++) {
+        LLVMValueRef sw = t2c_region.site[i].sw;
+        const rv_insn_t *ir = t2c_region.site[i].ir;
+        if (t2c_insn_is_return(ir)) {
+            for (uint32_t j = 0; j < t2c_region.n_ret; j++) {
+                uint32_t pc = t2c_region.ret_pc[j];
+                LLVMBasicBlockRef target = t2c_block_map_search(map, pc);
+                if (target)
+                    t2c_add_region_case(start, sw, ir, insn_counter, pc,
+                                        target);
+            }
+            continue;
+        }
+
+        /* The table is updated by the main thread, so collect each distinct
+         * target once.
+         */
+        const branch_history_table_t *bt = ir->branch_table;
+        uint32_t targets[HISTORY_SIZE], n_target = 0;
+        for (int j = 0; j < HISTORY_SIZE; j++) {
+            uint32_t pc = bt->PC[j];
+            uint32_t k = 0;
+            while (k < n_target && targets[k] != pc)
+                k++;
+            if (k < n_target)
+                continue;
+            LLVMBasicBlockRef target = t2c_block_map_search(map, pc);
+            if (!target)
+                continue;
+            targets[n_target++] = pc;
+            t2c_add_region_case(start, sw, ir, insn_counter, pc, target);
+        }
+    }
+}
+
+/* Address of X[reg] in riscv_t */
+FORCE_INLINE LLVMValueRef t2c_gen_X_addr(LLVMValueRef start,
+                                         LLVMBuilderRef builder,
+                                         uint32_t reg)
+{
+    LLVMValueRef offset = LLVMConstInt(
+        LLVMInt32Type(), offsetof(riscv_t, X) / sizeof(int) + reg, true);
+    return LLVMBuildInBoundsGEP2(builder, LLVMInt32Type(),
+                                 LLVMGetParam(start, 0), &offset, 1, "");
+}
+
+static void t2c_gen_load_regs(LLVMBuilderRef builder,
+                              LLVMValueRef start,
+                              const bool *mask)
+{
+    for (uint32_t i = 0; i < N_RV_REGS; i++) {
+        if (!mask[i])
+            continue;
+        LLVMValueRef val = LLVMBuildLoad2(
+            builder, LLVMInt32Type(), t2c_gen_X_addr(start, builder, i), "");
+        t2c_set_tbaa(val, false);
+        LLVMBuildStore(builder, val, t2c_regs[i]);
+    }
+}
+
+static void t2c_gen_store_regs(LLVMBuilderRef builder,
+                               LLVMValueRef start,
+                               const bool *mask)
+{
+    for (uint32_t i = 0; i < N_RV_REGS; i++) {
+        if (!mask[i])
+            continue;
+        LLVMValueRef store = LLVMBuildStore(
+            builder, LLVMBuildLoad2(builder, LLVMInt32Type(), t2c_regs[i], ""),
+            t2c_gen_X_addr(start, builder, i));
+        t2c_set_tbaa(store, false);
+    }
+}
+
+FORCE_INLINE bool t2c_is_reg_access(LLVMValueRef insn)
+{
+    LLVMValueRef ptr;
+    if (LLVMIsALoadInst(insn))
+        ptr = LLVMGetOperand(insn, 0);
+    else if (LLVMIsAStoreInst(insn))
+        ptr = LLVMGetOperand(insn, 1);
+    else
+        return false;
+    for (uint32_t i = 0; i < N_RV_REGS; i++) {
+        if (ptr == t2c_regs[i])
+            return true;
+    }
+    return false;
+}
+
+/* Connect the register allocas of the region to rv->X. The registers the
+ * region uses are loaded at its entry. Before a call, which may read any
+ * register (handlers, other T2C code), and before each exit, the registers
+ * the region writes are stored back; after a call, they are all reloaded
+ * unless the region is left right away.
+ */
+static void t2c_sync_regs(LLVMValueRef start, LLVMBasicBlockRef first_block)
+{
+    bool used[N_RV_REGS], written[N_RV_REGS];
+    for (uint32_t i = 0; i < N_RV_REGS; i++) {
+        used[i] = written[i] = false;
+        for (LLVMUseRef use = LLVMGetFirstUse(t2c_regs[i]); use;
+             use = LLVMGetNextUse(use)) {
+            LLVMValueRef user = LLVMGetUser(use);
+            used[i] = true;
+            if (LLVMIsAStoreInst(user) &&
+                LLVMGetOperand(user, 1) == t2c_regs[i])
+                written[i] = true;
+        }
+    }
+
+    LLVMBuilderRef builder = LLVMCreateBuilder();
+    LLVMPositionBuilderBefore(builder,
+                              LLVMGetBasicBlockTerminator(first_block));
+    t2c_gen_load_regs(builder, start, used);
+
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(start); bb;
+         bb = LLVMGetNextBasicBlock(bb)) {
+        LLVMValueRef insn = LLVMGetFirstInstruction(bb);
+        while (insn) {
+            LLVMValueRef next = LLVMGetNextInstruction(insn);
+            if (LLVMIsAReturnInst(insn)) {
+                LLVMPositionBuilderBefore(builder, insn);
+                t2c_gen_store_regs(builder, start, written);
+            } else if (LLVMIsACallInst(insn) &&
+                       !LLVMIsAInlineAsm(LLVMGetCalledValue(insn))) {
+                LLVMPositionBuilderBefore(builder, insn);
+                t2c_gen_store_regs(builder, start, written);
+                LLVMValueRef tail = next;
+                while (tail && !LLVMIsAReturnInst(tail) &&
+                       !LLVMIsACallInst(tail) && !t2c_is_reg_access(tail))
+                    tail = LLVMGetNextInstruction(tail);
+                if (tail && LLVMIsAReturnInst(tail)) {
+                    /* nothing to reload or store back */
+                    next = LLVMGetNextInstruction(tail);
+                } else {
+                    LLVMPositionBuilderBefore(builder, next);
+                    t2c_gen_load_regs(builder, start, used);
+                }
+            }
+            insn = next;
+        }
+    }
+    LLVMDisposeBuilder(builder);
+}
+
+/* State shared by all compilations. It is set up once on the T2C thread, so
+ * that each block only pays for its own optimization and code generation.
+ */
+static struct {
+    char *triple;
+    LLVMCodeModel code_model;
+    LLVMTargetMachineRef tm;
+    LLVMPassBuilderOptionsRef pb_option;
+    uint64_t cache_seed;
+} t2c_target;
+
+/* Persistent cache of optimized traces in vm_attr_t::t2c_cache_dir.
+ *
+ * A trace is stored as bitcode after the optimization pipeline, named after
+ * the hash of its unoptimized bitcode and the optimization level. A hit skips
+ * the pipeline and only leaves the code generation to MCJIT, whose C API
+ * cannot load object files. As host addresses are bound at load time (see
+ * T2C_SYM_MEM), the unoptimized IR only depends on the guest code and on the
+ * riscv_t layout, whose offsets it contains, so runs of the same workload
+ * share their entries.
+ */
+#define T2C_CACHE_VERSION "1"
+
+/* 64-bit FNV-1a */
+static uint64_t t2c_hash(uint64_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ p[i]) * UINT64_C(0x100000001b3);
+    return hash;
+}
+
+static void t2c_target_init(void)
+{
+    if (t2c_target.tm)
+        return;
+
+    char *error = NULL;
+    LLVMTargetRef target;
+    LLVMLinkInMCJIT();
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+#if defined(__aarch64__)
+    /* Initialize asm parser for inline assembly support in JIT.
+     * Required for ARM64 ISB instruction emission in t2c_jit_cache_helper.
+     */
+    LLVMInitializeNativeAsmParser();
+#endif
+    t2c_target.triple = LLVMGetDefaultTargetTriple();
+    if (LLVMGetTargetFromTriple(t2c_target.triple, &target, &error) != 0) {
+        rv_log_fatal("Failed to create target");
+        abort();
+    }
+    /* Use PIC relocation mode for JIT code - helps with indirect calls.
+     * Code model selection:
+     * - Apple Silicon (ARM64 macOS): Use Small model to avoid MCJIT bugs with
+     *   movz/movk sequences that Large model generates for 64-bit constants.
+     *   ARM64's limited addressing modes make Large model problematic.
+     * - Other platforms: Use Large model per LLVM MCJIT recommendations.
+     */
+#if defined(__aarch64__) && defined(__APPLE__)
+    t2c_target.code_model = LLVMCodeModelSmall;
+#else
+    t2c_target.code_model = LLVMCodeModelLarge;
+#endif
+    char *cpu = LLVMGetHostCPUName();
+    char *features = LLVMGetHostCPUFeatures();
+    t2c_target.tm = LLVMCreateTargetMachine(
+        target, t2c_target.triple, cpu, features, LLVMCodeGenLevelNone,
+        LLVMRelocPIC, t2c_target.code_model);
+    t2c_target.pb_option = LLVMCreatePassBuilderOptions();
+
+    /* Cached code is only valid for the same cache format, LLVM and host */
+    const char *const cache_id[] = {
+        T2C_CACHE_VERSION, LLVM_VERSION_STRING, t2c_target.triple, cpu,
+        features,
+    };
+    uint64_t seed = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < ARRAY_SIZE(cache_id); i++)
+        seed = t2c_hash(seed, cache_id[i], strlen(cache_id[i]) + 1);
+    t2c_target.cache_seed = seed;
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(features);
+}
+
+static bool t2c_cache_path(char *path,
+                           size_t size,
+                           const char *dir,
+                           LLVMModuleRef module,
+                           int opt_level)
+{
+    LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(module);
+    const size_t len = LLVMGetBufferSize(bitcode);
+    const uint64_t hash =
+        t2c_hash(t2c_target.cache_seed, LLVMGetBufferStart(bitcode), len);
+    LLVMDisposeMemoryBuffer(bitcode);
+    const int n = snprintf(path, size, "%s/%016" PRIx64 "-%zu-O%d.bc", dir,
+                           hash, len, opt_level);
+    return n > 0 && (size_t) n < size;
+}
+
+static void t2c_cache_diag(LLVMDiagnosticInfoRef info UNUSED, void *failed)
+{
+    *(bool *) failed = true;
+}
+
+static LLVMModuleRef t2c_cache_load(const char *path)
+{
+    LLVMMemoryBufferRef buf;
+    char *error = NULL;
+    if (LLVMCreateMemoryBufferWithContentsOfFile(path, &buf, &error)) {
+        LLVMDisposeMessage(error);
+        return NULL;
+    }
+
+    /* The default handler exits on errors, a bad entry is only a miss */
+    LLVMContextRef ctx = LLVMGetGlobalContext();
+    LLVMDiagnosticHandler handler = LLVMContextGetDiagnosticHandler(ctx);
+    void *handler_ctx = LLVMContextGetDiagnosticContext(ctx);
+    bool failed = false;
+    LLVMContextSetDiagnosticHandler(ctx, t2c_cache_diag, &failed);
+    LLVMModuleRef module = NULL;
+    if (LLVMParseBitcode2(buf, &module) || failed ||
+        !LLVMGetNamedFunction(module, "t2c_block")) {
+        rv_log_warn("Ignoring T2C cache entry %s", path);
+        if (module)
+            LLVMDisposeModule(module);
+        module = NULL;
+    }
+    LLVMContextSetDiagnosticHandler(ctx, handler, handler_ctx);
+    LLVMDisposeMemoryBuffer(buf);
+    return module;
+}
+
+/* Entries are renamed into place, so concurrent runs sharing the directory
+ * never read a partial one.
+ */
+static void t2c_cache_store(LLVMModuleRef module, const char *path)
+{
+    char tmp[PATH_MAX + 16];
+    snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long) getpid());
+    if (LLVMWriteBitcodeToFile(module, tmp) || rename(tmp, path)) {
+        rv_log_warn("Failed to write T2C cache entry %s", path);
+        remove(tmp);
+    }
+}
+
+/* Bind an external global referenced by the module to a host address */
+static void t2c_bind_extern(LLVMExecutionEngineRef engine,
+                            LLVMModuleRef module,
+                            const char *name,
+                            void *addr)
+{
+    LLVMValueRef sym = LLVMGetNamedGlobal(module, name);
+    if (sym)
+        LLVMAddGlobalMapping(engine, sym, addr);
+}
+
 void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
 {
-    /* Skip if already compiled (defensive check) */
-    if (ATOMIC_LOAD(&block->hot2, ATOMIC_ACQUIRE)) {
+    /* A block is compiled at most twice: by the quick tier when it is first
+     * promoted, and by the full pipeline once the quick-tier code stays hot.
+     */
+    const bool recompile = ATOMIC_LOAD(&block->hot2, ATOMIC_ACQUIRE);
+    if (recompile ? !block->t2c_profile || block->llvm_engine_quick
+                  : !!block->llvm_engine) {
         pthread_mutex_unlock(cache_lock);
         return;
     }
 
+    /* Optimization level is selected at runtime (see vm_attr_t):
+     *   O0: No optimization (fastest compile, for debugging only)
+     *   O1: Basic optimizations (~50% faster compile than O3)
+     *   O2: Balanced compilation/runtime trade-off
+     *   O3: Aggressive optimizations, best runtime (default for production)
+     *
+     * Above O1, a block is first compiled at O1 with profiling counters, and
+     * only the blocks that stay hot pay for the full pipeline.
+     */
+    static const char *const t2c_opt_passes[] = {
+        "default<O0>",
+        "default<O1>",
+        "default<O2>",
+        "default<O3>",
+    };
+    int opt_level = PRIV(rv)->t2c_opt_level;
+    assert(opt_level >= 0 && opt_level <= 3);
+    t2c_profile_t *profile = NULL;
+    if (recompile) {
+        t2c_profile_in = block->t2c_profile;
+    } else if (opt_level > T2C_QUICK_OPT_LEVEL) {
+        /* without counters, go straight to the full pipeline */
+        profile = calloc(1, sizeof(t2c_profile_t));
+        if (profile)
+            opt_level = T2C_QUICK_OPT_LEVEL;
+    }
+    t2c_profile_out = profile;
+    t2c_mem_inbounds =
+        ((memory_t *) PRIV(rv)->mem)->mem_size >= (UINT64_C(1) << 32);
+
     LLVMModuleRef module = LLVMModuleCreateWithName("my_module");
     /* Build LLVM struct type that matches riscv_internal layout.
      *
@@ -443,16 +1304,25 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
     /* Create instruction counter alloca in entry block for mem2reg promotion.
      * LLVM's mem2reg pass promotes allocas in the entry block to SSA registers,
      * eliminating per-instruction memory traffic. The counter is initialized to
-     * 0 and incremented by each T2C_OP. Timer is updated only at block exits.
+     * 0 and advanced once per block of the trace. Timer is updated only at
+     * block exits.
      */
     LLVMValueRef insn_counter =
         LLVMBuildAlloca(first_builder, LLVMInt64Type(), "insn_counter");
     LLVMBuildStore(first_builder, LLVMConstInt(LLVMInt64Type(), 0, false),
                    insn_counter);
+    t2c_instret_counter =
+        LLVMBuildAlloca(first_builder, LLVMInt64Type(), "instret_counter");
+    LLVMBuildStore(first_builder, LLVMConstInt(LLVMInt64Type(), 0, false),
+                   t2c_instret_counter);
+    for (uint32_t i = 0; i < N_RV_REGS; i++)
+        t2c_regs[i] = LLVMBuildAlloca(first_builder, LLVMInt32Type(), "");
+    t2c_region.n_ret = t2c_region.n_site = 0;
 
     LLVMBasicBlockRef entry = LLVMAppendBasicBlock(start, "entry");
     LLVMBuilderRef builder = LLVMCreateBuilder();
     LLVMPositionBuilderAtEnd(builder, entry);
+    t2c_gen_heat(first_builder);
     LLVMBuildBr(first_builder, entry);
     /* Allocate set on HEAP to avoid stack overflow.
      * set_t is 256KB (1024 * 32 * 8 bytes) in system mode - too large for
@@ -464,6 +1334,9 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
         LLVMDisposeBuilder(first_builder);
         LLVMDisposeBuilder(builder);
         LLVMDisposeModule(module);
+        t2c_profile_out = NULL;
+        t2c_profile_in = NULL;
+        free(profile);
         pthread_mutex_unlock(cache_lock);
         return;
     }
@@ -473,6 +1346,10 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
     /* Translate custom IR into LLVM IR */
     t2c_trace_ebb(&builder, param_types, start, &entry, rv, block, set, &map,
                   insn_counter);
+    t2c_link_region(start, &map, insn_counter);
+    t2c_sync_regs(start, first_block);
+    t2c_profile_out = NULL;
+    t2c_profile_in = NULL;
 
     block->is_compiling = true; /* Mark block as busy to prevent eviction */
 
@@ -483,61 +1360,27 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
     pthread_mutex_unlock(cache_lock);
 
     /* Offload LLVM IR to LLVM backend */
-    char *error = NULL, *triple = LLVMGetDefaultTargetTriple();
+    char *error = NULL;
     LLVMExecutionEngineRef engine;
-    LLVMTargetRef target;
-    LLVMLinkInMCJIT();
-    LLVMInitializeNativeTarget();
-    LLVMInitializeNativeAsmPrinter();
-#if defined(__aarch64__)
-    /* Initialize asm parser for inline assembly support in JIT.
-     * Required for ARM64 ISB instruction emission in t2c_jit_cache_helper.
-     */
-    LLVMInitializeNativeAsmParser();
-#endif
-    if (LLVMGetTargetFromTriple(triple, &target, &error) != 0) {
-        rv_log_fatal("Failed to create target");
-        abort();
+    t2c_target_init();
+    const char *cache_dir = PRIV(rv)->t2c_cache_dir;
+    char cache_path[PATH_MAX];
+    LLVMModuleRef cached = NULL;
+    if (cache_dir && !t2c_cache_path(cache_path, sizeof(cache_path),
+                                     cache_dir, module, opt_level))
+        cache_dir = NULL;
+    if (cache_dir)
+        cached = t2c_cache_load(cache_path);
+    if (cached) {
+        LLVMDisposeModule(module);
+        module = cached;
+        start = LLVMGetNamedFunction(module, "t2c_block");
+    } else {
+        LLVMRunPasses(module, t2c_opt_passes[opt_level], t2c_target.tm,
+                      t2c_target.pb_option);
+        if (cache_dir)
+            t2c_cache_store(module, cache_path);
     }
-    /* Use PIC relocation mode for JIT code - helps with indirect calls.
-     * Code model selection:
-     * - Apple Silicon (ARM64 macOS): Use Small model to avoid MCJIT bugs with
-     *   movz/movk sequences that Large model generates for 64-bit constants.
-     *   ARM64's limited addressing modes make Large model problematic.
-     * - Other platforms: Use Large model per LLVM MCJIT recommendations.
-     */
-#if defined(__aarch64__) && defined(__APPLE__)
-    LLVMCodeModel code_model = LLVMCodeModelSmall;
-#else
-    LLVMCodeModel code_model = LLVMCodeModelLarge;
-#endif
-    LLVMTargetMachineRef tm = LLVMCreateTargetMachine(
-        target, triple, LLVMGetHostCPUName(), LLVMGetHostCPUFeatures(),
-        LLVMCodeGenLevelNone, LLVMRelocPIC, code_model);
-    LLVMPassBuilderOptionsRef pb_option = LLVMCreatePassBuilderOptions();
-    /* Run LLVM optimization passes on the generated IR.
-     *
-     * Optimization level is configurable via CONFIG_T2C_OPT_LEVEL (Kconfig):
-     *   O0: No optimization (fastest compile, for debugging only)
-     *   O1: Basic optimizations (~50% faster compile than O3)
-     *   O2: Balanced compilation/runtime trade-off
-     *   O3: Aggressive optimizations, best runtime (default for production)
-     *
-     * system_jit_defconfig uses O1 for faster CI boot tests.
-     * jit_defconfig uses O3 (default) for production performance.
-     */
-#ifndef CONFIG_T2C_OPT_LEVEL
-#define CONFIG_T2C_OPT_LEVEL 3
-#endif
-    static_assert(CONFIG_T2C_OPT_LEVEL >= 0 && CONFIG_T2C_OPT_LEVEL <= 3,
-                  "T2C optimization level must be 0-3");
-    static const char *const t2c_opt_passes[] = {
-        "default<O0>",
-        "default<O1>",
-        "default<O2>",
-        "default<O3>",
-    };
-    LLVMRunPasses(module, t2c_opt_passes[CONFIG_T2C_OPT_LEVEL], tm, pb_option);
 
     /* Use LLVMCreateMCJITCompilerForModule with explicit options.
      * Unlike LLVMCreateExecutionEngineForModule, this respects our code model
@@ -545,8 +1388,8 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
      */
     struct LLVMMCJITCompilerOptions options;
     LLVMInitializeMCJITCompilerOptions(&options, sizeof(options));
-    options.OptLevel = CONFIG_T2C_OPT_LEVEL;
-    options.CodeModel = code_model;
+    options.OptLevel = opt_level;
+    options.CodeModel = t2c_target.code_model;
 
     if (LLVMCreateMCJITCompilerForModule(&engine, module, &options,
                                          sizeof(options), &error) != 0) {
@@ -555,6 +1398,10 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
         abort();
     }
 
+    t2c_bind_extern(engine, module, T2C_SYM_MEM,
+                    ((memory_t *) PRIV(rv)->mem)->mem_base);
+    t2c_bind_extern(engine, module, T2C_SYM_PROFILE, profile);
+
     /* Get function pointer - store in local variable first.
      * We'll write to block->func only under cache_lock to avoid data race
      * with eviction path that reads block->func.
@@ -565,9 +1412,6 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
     /* Cleanup LLVM resources - execution engine owns the module */
     LLVMDisposeBuilder(first_builder);
     LLVMDisposeBuilder(builder);
-    LLVMDisposePassBuilderOptions(pb_option);
-    LLVMDisposeTargetMachine(tm);
-    LLVMDisposeMessage(triple);
 
     /* Reacquire lock to update shared state.
      * All block field writes must happen under lock to avoid data races.
@@ -582,17 +1426,14 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
     if (!func) {
         /* Check if block was evicted - if so, free it and its IRs */
         if (block->should_free) {
-            /* Free IRs that main thread skipped during deferred eviction */
-            for (rv_insn_t *ir = block->ir_head, *next_ir; ir; ir = next_ir) {
-                next_ir = ir->next;
-                if (ir->fuse)
-                    mpool_free(rv->fuse_mp, ir->fuse);
-                mpool_free(rv->block_ir_mp, ir);
-            }
+            /* Free what the main thread skipped during deferred eviction */
+            t2c_dispose_block_engine(block);
+            block_free_ir(rv, block);
             mpool_free(rv->block_mp, block);
         }
         LLVMDisposeExecutionEngine(engine);
         pthread_mutex_unlock(cache_lock);
+        free(profile);
         free(set);
         return;
     }
@@ -603,15 +1444,12 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
     if (block->should_free) {
         /* Dispose engine (we own it) */
         LLVMDisposeExecutionEngine(engine);
-        /* Free IRs that main thread skipped during deferred eviction */
-        for (rv_insn_t *ir = block->ir_head, *next_ir; ir; ir = next_ir) {
-            next_ir = ir->next;
-            if (ir->fuse)
-                mpool_free(rv->fuse_mp, ir->fuse);
-            mpool_free(rv->block_ir_mp, ir);
-        }
+        /* Free what the main thread skipped during deferred eviction */
+        t2c_dispose_block_engine(block);
+        block_free_ir(rv, block);
         mpool_free(rv->block_mp, block);
         pthread_mutex_unlock(cache_lock);
+        free(profile);
         free(set);
         return;
     }
@@ -626,6 +1464,7 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
     if (block->invalidated) {
         LLVMDisposeExecutionEngine(engine);
         pthread_mutex_unlock(cache_lock);
+        free(profile);
         free(set);
         return;
     }
@@ -633,9 +1472,15 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
     uint64_t key = (uint64_t) block->pc_start;
 #endif
 
-    /* Write to block fields under lock to avoid data race with eviction */
-    block->func = func;
+    /* Write to block fields under lock to avoid data race with eviction.
+     * The quick-tier code may still be entered through the inline caches of
+     * other traces, so its engine and counters stay until the block is freed.
+     */
+    block->llvm_engine_quick = block->llvm_engine;
     block->llvm_engine = engine;
+    if (profile)
+        block->t2c_profile = profile;
+    ATOMIC_STORE(&block->func, (void *) func, ATOMIC_RELEASE);
 
     jit_cache_update(rv->jit_cache, key, block->func);
 
@@ -644,6 +1489,8 @@ void t2c_compile(riscv_t *rv, block_t *block, pthread_mutex_t *cache_lock)
      * Pairs with atomic load-acquire in rv_step().
      */
     ATOMIC_STORE(&block->hot2, true, ATOMIC_RELEASE);
+    if (recompile)
+        ATOMIC_STORE(&block->recompiled, true, ATOMIC_RELEASE);
 
     pthread_mutex_unlock(cache_lock);
     free(set);
@@ -722,19 +1569,11 @@ void inline_cache_clear_key(struct inline_cache *cache, uint64_t key)
     }
 }
 
-/* Dispose LLVM execution engine when a T2C-compiled block is freed.
- * The engine owns the memory where block->func points, so it must be
- * disposed before the block is freed to prevent dangling pointers.
- */
-void t2c_dispose_engine(void *engine)
-{
-    if (engine)
-        LLVMDisposeExecutionEngine((LLVMExecutionEngineRef) engine);
-}
-
-/* Wrapper for clear_cache_hot callback - disposes block's LLVM engine.
- * Called during shutdown via clear_cache_hot to clean up all remaining blocks.
- * Sets both llvm_engine and func to NULL to prevent use-after-free.
+/* Dispose the LLVM engines of a block, which own the memory where its T2C
+ * code lives, and the counters that the quick-tier code updates. Called when
+ * a block is freed, and during shutdown via clear_cache_hot to clean up all
+ * remaining blocks. Sets both llvm_engine and func to NULL to prevent
+ * use-after-free.
  *
  * DISABLE_UBSAN_FUNC: Disable UBSAN function pointer type check.
  * LLVM's cflags can cause function type metadata mismatch between t2c.c
@@ -744,11 +1583,20 @@ DISABLE_UBSAN_FUNC
 void t2c_dispose_block_engine(void *block)
 {
     block_t *blk = (block_t *) block;
-    if (blk && blk->llvm_engine) {
+    if (!blk)
+        return;
+    if (blk->llvm_engine) {
         LLVMDisposeExecutionEngine((LLVMExecutionEngineRef) blk->llvm_engine);
         blk->llvm_engine = NULL;
         blk->func = NULL; /* func pointed into engine's memory */
     }
+    if (blk->llvm_engine_quick) {
+        LLVMDisposeExecutionEngine(
+            (LLVMExecutionEngineRef) blk->llvm_engine_quick);
+        blk->llvm_engine_quick = NULL;
+    }
+    free(blk->t2c_profile);
+    blk->t2c_profile = NULL;
 }
 
 void jit_cache_update(struct jit_cache *cache, uint64_t key, void *entry)
@@ -44,7 +44,7 @@ T2C_OP(jal, {
     } else {
         T2C_LLVM_GEN_STORE_IMM32(*builder, ir->pc + ir->imm,
                                  t2c_gen_PC_addr(start, builder, ir));
-        T2C_STORE_TIMER(*builder, start, insn_counter);
+        T2C_STORE_TIMER(*builder, start, insn_counter, ir);
         LLVMBuildRetVoid(*builder);
     }
 })
@@ -57,6 +57,11 @@ FORCE_INLINE void t2c_jit_cache_helper(LLVMBuilderRef *builder,
                                        rv_insn_t *ir,
                                        LLVMValueRef insn_counter)
 {
+    /* Targets within the region are resolved first, see
+     * t2c_gen_region_jump()
+     */
+    t2c_gen_region_jump(builder, start, addr, ir);
+
     /* Inline caching + seqlock pattern for indirect jump resolution.
      *
      * Fast path (inline cache hit):
@@ -164,7 +169,7 @@ FORCE_INLINE void t2c_jit_cache_helper(LLVMBuilderRef *builder,
      * No ISB needed - we already executed this target successfully before.
      * The instruction cache was coherent at that time.
      */
-    T2C_STORE_TIMER(ic_hit_builder, start, insn_counter);
+    T2C_STORE_TIMER(ic_hit_builder, start, insn_counter, ir);
     LLVMValueRef ic_call_args[1] = {rv_param};
     LLVMBuildCall2(ic_hit_builder, t2c_jit_cache_func_type, ic_entry,
                    ic_call_args, 1, "");
@@ -286,7 +291,7 @@ FORCE_INLINE void t2c_jit_cache_helper(LLVMBuilderRef *builder,
     LLVMBuildCall2(call_builder, isb_func_type, isb_asm, NULL, 0, "");
 #endif
 
-    T2C_STORE_TIMER(call_builder, start, insn_counter);
+    T2C_STORE_TIMER(call_builder, start, insn_counter, ir);
     LLVMValueRef t2c_args[1] = {rv_param};
     LLVMBuildCall2(call_builder, t2c_jit_cache_func_type, entry, t2c_args, 1,
                    "");
@@ -295,7 +300,7 @@ FORCE_INLINE void t2c_jit_cache_helper(LLVMBuilderRef *builder,
     /* Fallback: seq odd, key mismatch, or seq changed - return to interp */
     LLVMBuildStore(fallback_builder, addr,
                    t2c_gen_PC_addr(start, &fallback_builder, ir));
-    T2C_STORE_TIMER(fallback_builder, start, insn_counter);
+    T2C_STORE_TIMER(fallback_builder, start, insn_counter, ir);
     LLVMBuildRetVoid(fallback_builder);
 
     /* Dispose temporary builders */
@@ -338,7 +343,7 @@ T2C_OP(jalr, {
             *taken_builder = builder2;                                      \
         } else {                                                            \
             T2C_LLVM_GEN_STORE_IMM32(builder2, ir->pc + ir->imm, addr_PC);  \
-            T2C_STORE_TIMER(builder2, start, insn_counter);                 \
+            T2C_STORE_TIMER(builder2, start, insn_counter, ir);             \
             LLVMBuildRetVoid(builder2);                                     \
             LLVMDisposeBuilder(builder2);                                   \
         }                                                                   \
@@ -350,11 +355,11 @@ T2C_OP(jalr, {
             *untaken_builder = builder3;                                    \
         } else {                                                            \
             T2C_LLVM_GEN_STORE_IMM32(builder3, ir->pc + 4, addr_PC);        \
-            T2C_STORE_TIMER(builder3, start, insn_counter);                 \
+            T2C_STORE_TIMER(builder3, start, insn_counter, ir);             \
             LLVMBuildRetVoid(builder3);                                     \
             LLVMDisposeBuilder(builder3);                                   \
         }                                                                   \
-        LLVMBuildCondBr(*builder, cmp, taken, untaken);                     \
+        t2c_gen_cond_br(*builder, ir, cmp, taken, untaken);                 \
     })
 
 BRANCH_FUNC(beq, EQ)
@@ -621,7 +626,7 @@ T2C_OP(lb, {
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             LLVMValueRef res = LLVMBuildSExt(
                 *builder,
-                LLVMBuildLoad2(*builder, LLVMInt8Type(), mem_loc, "res"),
+                t2c_gen_guest_load(*builder, LLVMInt8Type(), mem_loc),
                 LLVMInt32Type(), "sext8to32");
             LLVMBuildStore(*builder, res, t2c_gen_rd_addr(start, builder, ir));
         });
@@ -635,7 +640,7 @@ T2C_OP(lh, {
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             LLVMValueRef res = LLVMBuildSExt(
                 *builder,
-                LLVMBuildLoad2(*builder, LLVMInt16Type(), mem_loc, "res"),
+                t2c_gen_guest_load(*builder, LLVMInt16Type(), mem_loc),
                 LLVMInt32Type(), "sext16to32");
             LLVMBuildStore(*builder, res, t2c_gen_rd_addr(start, builder, ir));
         });
@@ -649,7 +654,7 @@ T2C_OP(lw, {
             LLVMValueRef mem_loc =
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             LLVMValueRef res =
-                LLVMBuildLoad2(*builder, LLVMInt32Type(), mem_loc, "res");
+                t2c_gen_guest_load(*builder, LLVMInt32Type(), mem_loc);
             LLVMBuildStore(*builder, res, t2c_gen_rd_addr(start, builder, ir));
         });
 })
@@ -662,7 +667,7 @@ T2C_OP(lbu, {
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             LLVMValueRef res = LLVMBuildZExt(
                 *builder,
-                LLVMBuildLoad2(*builder, LLVMInt8Type(), mem_loc, "res"),
+                t2c_gen_guest_load(*builder, LLVMInt8Type(), mem_loc),
                 LLVMInt32Type(), "zext8to32");
             LLVMBuildStore(*builder, res, t2c_gen_rd_addr(start, builder, ir));
         });
@@ -676,7 +681,7 @@ T2C_OP(lhu, {
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             LLVMValueRef res = LLVMBuildZExt(
                 *builder,
-                LLVMBuildLoad2(*builder, LLVMInt16Type(), mem_loc, "res"),
+                t2c_gen_guest_load(*builder, LLVMInt16Type(), mem_loc),
                 LLVMInt32Type(), "zext16to32");
             LLVMBuildStore(*builder, res, t2c_gen_rd_addr(start, builder, ir));
         });
@@ -690,7 +695,7 @@ T2C_OP(sb, {
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             T2C_LLVM_GEN_LOAD_VMREG(rs2, 8,
                                     t2c_gen_rs2_addr(start, builder, ir));
-            LLVMBuildStore(*builder, val_rs2, mem_loc);
+            t2c_gen_guest_store(*builder, val_rs2, mem_loc);
         });
 })
 
@@ -702,7 +707,7 @@ T2C_OP(sh, {
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             T2C_LLVM_GEN_LOAD_VMREG(rs2, 16,
                                     t2c_gen_rs2_addr(start, builder, ir));
-            LLVMBuildStore(*builder, val_rs2, mem_loc);
+            t2c_gen_guest_store(*builder, val_rs2, mem_loc);
         });
 })
 
@@ -714,7 +719,7 @@ T2C_OP(sw, {
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             T2C_LLVM_GEN_LOAD_VMREG(rs2, 32,
                                     t2c_gen_rs2_addr(start, builder, ir));
-            LLVMBuildStore(*builder, val_rs2, mem_loc);
+            t2c_gen_guest_store(*builder, val_rs2, mem_loc);
         });
 })
 
@@ -872,7 +877,7 @@ T2C_OP(ecall, {
     t2c_gen_call_io_func(
         start, builder, param_types,
         offsetof(riscv_t, io) + offsetof(riscv_io_t, on_ecall));
-    T2C_STORE_TIMER(*builder, start, insn_counter);
+    T2C_STORE_TIMER(*builder, start, insn_counter, ir);
     LLVMBuildRetVoid(*builder);
 })
 
@@ -885,10 +890,14 @@ T2C_OP(ebreak, {
     t2c_gen_call_io_func(
         start, builder, param_types,
         offsetof(riscv_t, io) + offsetof(riscv_io_t, on_ebreak));
-    T2C_STORE_TIMER(*builder, start, insn_counter);
+    T2C_STORE_TIMER(*builder, start, insn_counter, ir);
     LLVMBuildRetVoid(*builder);
 })
 
+#if !RV32_HAS(SYSTEM)
+T2C_OP(libcall, { __UNREACHABLE; })
+#endif
+
 T2C_OP(wfi, { __UNREACHABLE; })
 
 T2C_OP(uret, { __UNREACHABLE; })
@@ -1086,7 +1095,7 @@ T2C_OP(clw, {
             LLVMValueRef mem_loc =
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             LLVMValueRef res =
-                LLVMBuildLoad2(*builder, LLVMInt32Type(), mem_loc, "res");
+                t2c_gen_guest_load(*builder, LLVMInt32Type(), mem_loc);
             LLVMBuildStore(*builder, res, t2c_gen_rd_addr(start, builder, ir));
         });
 })
@@ -1099,7 +1108,7 @@ T2C_OP(csw, {
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             T2C_LLVM_GEN_LOAD_VMREG(rs2, 32,
                                     t2c_gen_rs2_addr(start, builder, ir));
-            LLVMBuildStore(*builder, val_rs2, mem_loc);
+            t2c_gen_guest_store(*builder, val_rs2, mem_loc);
         });
 })
 
@@ -1120,7 +1129,7 @@ T2C_OP(cjal, {
     else {
         T2C_LLVM_GEN_STORE_IMM32(*builder, ir->pc + ir->imm,
                                  t2c_gen_PC_addr(start, builder, ir));
-        T2C_STORE_TIMER(*builder, start, insn_counter);
+        T2C_STORE_TIMER(*builder, start, insn_counter, ir);
         LLVMBuildRetVoid(*builder);
     }
 })
@@ -1197,7 +1206,7 @@ T2C_OP(cj, {
     else {
         T2C_LLVM_GEN_STORE_IMM32(*builder, ir->pc + ir->imm,
                                  t2c_gen_PC_addr(start, builder, ir));
-        T2C_STORE_TIMER(*builder, start, insn_counter);
+        T2C_STORE_TIMER(*builder, start, insn_counter, ir);
         LLVMBuildRetVoid(*builder);
     }
 })
@@ -1213,7 +1222,7 @@ T2C_OP(cbeqz, {
         *taken_builder = builder2;
     else {
         T2C_LLVM_GEN_STORE_IMM32(builder2, ir->pc + ir->imm, addr_PC);
-        T2C_STORE_TIMER(builder2, start, insn_counter);
+        T2C_STORE_TIMER(builder2, start, insn_counter, ir);
         LLVMBuildRetVoid(builder2);
     }
 
@@ -1224,10 +1233,10 @@ T2C_OP(cbeqz, {
         *untaken_builder = builder3;
     else {
         T2C_LLVM_GEN_STORE_IMM32(builder3, ir->pc + 2, addr_PC);
-        T2C_STORE_TIMER(builder3, start, insn_counter);
+        T2C_STORE_TIMER(builder3, start, insn_counter, ir);
         LLVMBuildRetVoid(builder3);
     }
-    LLVMBuildCondBr(*builder, cmp, taken, untaken);
+    t2c_gen_cond_br(*builder, ir, cmp, taken, untaken);
 })
 
 T2C_OP(cbnez, {
@@ -1241,7 +1250,7 @@ T2C_OP(cbnez, {
         *taken_builder = builder2;
     else {
         T2C_LLVM_GEN_STORE_IMM32(builder2, ir->pc + ir->imm, addr_PC);
-        T2C_STORE_TIMER(builder2, start, insn_counter);
+        T2C_STORE_TIMER(builder2, start, insn_counter, ir);
         LLVMBuildRetVoid(builder2);
     }
 
@@ -1252,10 +1261,10 @@ T2C_OP(cbnez, {
         *untaken_builder = builder3;
     else {
         T2C_LLVM_GEN_STORE_IMM32(builder3, ir->pc + 2, addr_PC);
-        T2C_STORE_TIMER(builder3, start, insn_counter);
+        T2C_STORE_TIMER(builder3, start, insn_counter, ir);
         LLVMBuildRetVoid(builder3);
     }
-    LLVMBuildCondBr(*builder, cmp, taken, untaken);
+    t2c_gen_cond_br(*builder, ir, cmp, taken, untaken);
 })
 
 T2C_OP(cslli, {
@@ -1269,19 +1278,13 @@ T2C_OP(clwsp, {
     IIF(RV32_HAS(SYSTEM))(
         { t2c_mmu_wrapper_clwsp(builder, start, ir); },
         {
-            LLVMValueRef val_sp = LLVMBuildZExt(
-                *builder,
-                LLVMBuildLoad2(*builder, LLVMInt32Type(),
-                               t2c_gen_sp_addr(start, builder, ir), "val_sp"),
-                LLVMInt64Type(), "zext32to64");
-            LLVMValueRef addr = LLVMBuildAdd(
-                *builder, val_sp,
-                LLVMConstInt(LLVMInt64Type(), ir->imm + mem_base, true),
-                "addr");
-            LLVMValueRef cast_addr = LLVMBuildIntToPtr(
-                *builder, addr, LLVMPointerType(LLVMInt32Type(), 0), "cast");
+            T2C_LLVM_GEN_LOAD_VMREG(sp, 32,
+                                    t2c_gen_sp_addr(start, builder, ir));
+            LLVMValueRef cast_addr = t2c_gen_guest_addr(
+                *builder, T2C_LLVM_GEN_ALU32_IMM(Add, val_sp, ir->imm),
+                mem_base);
             LLVMValueRef res =
-                LLVMBuildLoad2(*builder, LLVMInt32Type(), cast_addr, "res");
+                t2c_gen_guest_load(*builder, LLVMInt32Type(), cast_addr);
             LLVMBuildStore(*builder, res, t2c_gen_rd_addr(start, builder, ir));
         });
 })
@@ -1305,7 +1308,7 @@ T2C_OP(cebreak, {
     t2c_gen_call_io_func(
         start, builder, param_types,
         offsetof(riscv_t, io) + offsetof(riscv_io_t, on_ebreak));
-    T2C_STORE_TIMER(*builder, start, insn_counter);
+    T2C_STORE_TIMER(*builder, start, insn_counter, ir);
     LLVMBuildRetVoid(*builder);
 })
 
@@ -1331,19 +1334,13 @@ T2C_OP(cswsp, {
         { t2c_mmu_wrapper_cswsp(builder, start, ir); },
         {
             LLVMValueRef addr_rs2 = t2c_gen_rs2_addr(start, builder, ir);
-            LLVMValueRef val_sp = LLVMBuildZExt(
-                *builder,
-                LLVMBuildLoad2(*builder, LLVMInt32Type(),
-                               t2c_gen_sp_addr(start, builder, ir), "val_sp"),
-                LLVMInt64Type(), "zext32to64");
+            T2C_LLVM_GEN_LOAD_VMREG(sp, 32,
+                                    t2c_gen_sp_addr(start, builder, ir));
             T2C_LLVM_GEN_LOAD_VMREG(rs2, 32, addr_rs2);
-            LLVMValueRef addr = LLVMBuildAdd(
-                *builder, val_sp,
-                LLVMConstInt(LLVMInt64Type(), ir->imm + mem_base, true),
-                "addr");
-            LLVMValueRef cast_addr = LLVMBuildIntToPtr(
-                *builder, addr, LLVMPointerType(LLVMInt32Type(), 0), "cast");
-            LLVMBuildStore(*builder, val_rs2, cast_addr);
+            LLVMValueRef cast_addr = t2c_gen_guest_addr(
+                *builder, T2C_LLVM_GEN_ALU32_IMM(Add, val_sp, ir->imm),
+                mem_base);
+            t2c_gen_guest_store(*builder, val_rs2, cast_addr);
         });
 })
 #endif
@@ -1433,12 +1430,7 @@ T2C_OP(bseti, { __UNREACHABLE; })
 T2C_OP(fuse1, {
     opcode_fuse_t *fuse = ir->fuse;
     for (int i = 0; i < ir->imm2; i++) {
-        LLVMValueRef rd_offset =
-            LLVMConstInt(LLVMInt32Type(),
-                         offsetof(riscv_t, X) / sizeof(int) + fuse[i].rd, true);
-        LLVMValueRef addr_rd = LLVMBuildInBoundsGEP2(*builder, LLVMInt32Type(),
-                                                     LLVMGetParam(start, 0),
-                                                     &rd_offset, 1, "addr_rd");
+        LLVMValueRef addr_rd = t2c_gen_reg_addr(start, builder, fuse[i].rd);
         LLVMBuildStore(*builder,
                        LLVMConstInt(LLVMInt32Type(), fuse[i].imm, true),
                        addr_rd);
@@ -1465,7 +1457,7 @@ T2C_OP(fuse3, {
                 T2C_LLVM_GEN_LOAD_VMREG(
                     rs2, 32,
                     t2c_gen_rs2_addr(start, builder, (rv_insn_t *) (&fuse[i])));
-                LLVMBuildStore(*builder, val_rs2, mem_loc);
+                t2c_gen_guest_store(*builder, val_rs2, mem_loc);
             });
     }
 })
@@ -1479,7 +1471,7 @@ T2C_OP(fuse4, {
                 LLVMValueRef mem_loc = t2c_gen_mem_loc(
                     start, builder, (rv_insn_t *) (&fuse[i]), mem_base);
                 LLVMValueRef res =
-                    LLVMBuildLoad2(*builder, LLVMInt32Type(), mem_loc, "res");
+                    t2c_gen_guest_load(*builder, LLVMInt32Type(), mem_loc);
                 LLVMBuildStore(
                     *builder, res,
                     t2c_gen_rd_addr(start, builder, (rv_insn_t *) (&fuse[i])));
@@ -1520,11 +1512,7 @@ T2C_OP(fuse5, {
 #if !RV32_HAS(RV32E)
 T2C_OP(fuse6, {
     /* Store syscall number (imm) to a7 register */
-    LLVMValueRef a7_offset = LLVMConstInt(
-        LLVMInt32Type(), offsetof(riscv_t, X) / sizeof(int) + rv_reg_a7, true);
-    LLVMValueRef addr_a7 =
-        LLVMBuildInBoundsGEP2(*builder, LLVMInt32Type(), LLVMGetParam(start, 0),
-                              &a7_offset, 1, "addr_a7");
+    LLVMValueRef addr_a7 = t2c_gen_reg_addr(start, builder, rv_reg_a7);
     LLVMBuildStore(*builder, LLVMConstInt(LLVMInt32Type(), ir->imm, true),
                    addr_a7);
     /* Store PC and call ecall handler.
@@ -1536,7 +1524,7 @@ T2C_OP(fuse6, {
     t2c_gen_call_io_func(
         start, builder, param_types,
         offsetof(riscv_t, io) + offsetof(riscv_io_t, on_ecall));
-    T2C_STORE_TIMER(*builder, start, insn_counter);
+    T2C_STORE_TIMER(*builder, start, insn_counter, ir);
     LLVMBuildRetVoid(*builder);
 })
 #else
@@ -1545,7 +1533,7 @@ T2C_OP(fuse6, {
  */
 T2C_OP(fuse6, {
     assert(!"fuse6 should not be called in RV32E mode");
-    T2C_STORE_TIMER(*builder, start, insn_counter);
+    T2C_STORE_TIMER(*builder, start, insn_counter, ir);
     LLVMBuildRetVoid(*builder);
 })
 #endif
@@ -1554,23 +1542,13 @@ T2C_OP(fuse6, {
 T2C_OP(fuse7, {
     opcode_fuse_t *fuse = ir->fuse;
     for (int i = 0; i < ir->imm2; i++) {
-        LLVMValueRef rs1_offset = LLVMConstInt(
-            LLVMInt32Type(), offsetof(riscv_t, X) / sizeof(int) + fuse[i].rs1,
-            true);
-        LLVMValueRef addr_rs1 = LLVMBuildInBoundsGEP2(
-            *builder, LLVMInt32Type(), LLVMGetParam(start, 0), &rs1_offset, 1,
-            "addr_rs1");
+        LLVMValueRef addr_rs1 = t2c_gen_reg_addr(start, builder, fuse[i].rs1);
         LLVMValueRef val_rs1 =
             LLVMBuildLoad2(*builder, LLVMInt32Type(), addr_rs1, "val_rs1");
         LLVMValueRef res = LLVMBuildAdd(
             *builder, val_rs1, LLVMConstInt(LLVMInt32Type(), fuse[i].imm, true),
             "add");
-        LLVMValueRef rd_offset =
-            LLVMConstInt(LLVMInt32Type(),
-                         offsetof(riscv_t, X) / sizeof(int) + fuse[i].rd, true);
-        LLVMValueRef addr_rd = LLVMBuildInBoundsGEP2(*builder, LLVMInt32Type(),
-                                                     LLVMGetParam(start, 0),
-                                                     &rd_offset, 1, "addr_rd");
+        LLVMValueRef addr_rd = t2c_gen_reg_addr(start, builder, fuse[i].rd);
         LLVMBuildStore(*builder, res, addr_rd);
     }
 })
@@ -1583,11 +1561,7 @@ T2C_OP(fuse8, {
      * Cast to uint32_t to avoid signed overflow UB.
      */
     uint32_t combined_imm = (uint32_t) ir->imm + (uint32_t) ir->imm2;
-    LLVMValueRef rd_offset = LLVMConstInt(
-        LLVMInt32Type(), offsetof(riscv_t, X) / sizeof(int) + ir->rd, true);
-    LLVMValueRef addr_rd =
-        LLVMBuildInBoundsGEP2(*builder, LLVMInt32Type(), LLVMGetParam(start, 0),
-                              &rd_offset, 1, "addr_rd");
+    LLVMValueRef addr_rd = t2c_gen_reg_addr(start, builder, ir->rd);
     LLVMBuildStore(*builder, LLVMConstInt(LLVMInt32Type(), combined_imm, true),
                    addr_rd);
 })
@@ -1601,12 +1575,11 @@ T2C_OP(fuse9, {
         { t2c_mmu_wrapper_fuse9(builder, start, ir); },
         {
             uint32_t addr_imm = (uint32_t) ir->imm + (uint32_t) ir->imm2;
-            LLVMValueRef addr = LLVMConstInt(
-                LLVMInt64Type(), (uint64_t) addr_imm + mem_base, false);
-            LLVMValueRef cast_addr = LLVMBuildIntToPtr(
-                *builder, addr, LLVMPointerType(LLVMInt32Type(), 0), "cast");
+            LLVMValueRef cast_addr = t2c_gen_guest_addr(
+                *builder, LLVMConstInt(LLVMInt32Type(), addr_imm, false),
+                mem_base);
             LLVMValueRef res =
-                LLVMBuildLoad2(*builder, LLVMInt32Type(), cast_addr, "res");
+                t2c_gen_guest_load(*builder, LLVMInt32Type(), cast_addr);
             LLVMBuildStore(*builder, res, t2c_gen_rs2_addr(start, builder, ir));
         });
 })
@@ -1620,13 +1593,12 @@ T2C_OP(fuse10, {
         { t2c_mmu_wrapper_fuse10(builder, start, ir); },
         {
             uint32_t addr_imm = (uint32_t) ir->imm + (uint32_t) ir->imm2;
-            LLVMValueRef addr = LLVMConstInt(
-                LLVMInt64Type(), (uint64_t) addr_imm + mem_base, false);
-            LLVMValueRef cast_addr = LLVMBuildIntToPtr(
-                *builder, addr, LLVMPointerType(LLVMInt32Type(), 0), "cast");
+            LLVMValueRef cast_addr = t2c_gen_guest_addr(
+                *builder, LLVMConstInt(LLVMInt32Type(), addr_imm, false),
+                mem_base);
             T2C_LLVM_GEN_LOAD_VMREG(rs1, 32,
                                     t2c_gen_rs1_addr(start, builder, ir));
-            LLVMBuildStore(*builder, val_rs1, cast_addr);
+            t2c_gen_guest_store(*builder, val_rs1, cast_addr);
         });
 })
 
@@ -1649,7 +1621,7 @@ T2C_OP(fuse11, {
             LLVMValueRef mem_loc =
                 t2c_gen_mem_loc(start, builder, ir, mem_base);
             LLVMValueRef res =
-                LLVMBuildLoad2(*builder, LLVMInt32Type(), mem_loc, "res");
+                t2c_gen_guest_load(*builder, LLVMInt32Type(), mem_loc);
             LLVMBuildStore(*builder, res, t2c_gen_rd_addr(start, builder, ir));
             /* Increment rs1 by imm2 (rd != rs1 guaranteed by fusion constraint)
              */
@@ -1681,7 +1653,7 @@ T2C_OP(fuse12, {
     } else {
         /* PC = ir->pc + 4 + ir->imm2 (ADDI is 4 bytes, then branch offset) */
         T2C_LLVM_GEN_STORE_IMM32(builder2, ir->pc + 4 + ir->imm2, addr_PC);
-        T2C_STORE_TIMER(builder2, start, insn_counter);
+        T2C_STORE_TIMER(builder2, start, insn_counter, ir);
         LLVMBuildRetVoid(builder2);
     }
     LLVMBasicBlockRef untaken = LLVMAppendBasicBlock(start, "untaken");
@@ -1693,8 +1665,19 @@ T2C_OP(fuse12, {
     } else {
         /* PC = ir->pc + 8 (skip both ADDI and BNE, each 4 bytes) */
         T2C_LLVM_GEN_STORE_IMM32(builder3, ir->pc + 8, addr_PC);
-        T2C_STORE_TIMER(builder3, start, insn_counter);
+        T2C_STORE_TIMER(builder3, start, insn_counter, ir);
         LLVMBuildRetVoid(builder3);
     }
-    LLVMBuildCondBr(*builder, cmp, taken, untaken);
+    t2c_gen_cond_br(*builder, ir, cmp, taken, untaken);
+})
+
+/* fused SLLI + ADD (scaled index)
+ * rd = rs2 + (rs1 << imm)
+ */
+T2C_OP(fuse13, {
+    T2C_LLVM_GEN_LOAD_VMREG(rs1, 32, t2c_gen_rs1_addr(start, builder, ir));
+    T2C_LLVM_GEN_LOAD_VMREG(rs2, 32, t2c_gen_rs2_addr(start, builder, ir));
+    LLVMValueRef index = T2C_LLVM_GEN_ALU32_IMM(Shl, val_rs1, ir->imm & 0x1f);
+    LLVMValueRef res = LLVMBuildAdd(*builder, val_rs2, index, "add");
+    LLVMBuildStore(*builder, res, t2c_gen_rd_addr(start, builder, ir));
 })
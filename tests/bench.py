@@ -149,10 +149,14 @@ class Benchmark(ABC):
     BIN_PATH: ClassVar[str]
 
     def __init__(
-        self, n_runs: int, progress: Optional[ProgressIndicator] = None
+        self,
+        n_runs: int,
+        progress: Optional[ProgressIndicator] = None,
+        emu: str = EMU_PATH,
     ):
         self.n_runs = n_runs
         self.progress = progress
+        self.emu = emu
         self.logs: List[str] = []
 
     def log(self, msg: str) -> None:
@@ -278,7 +282,7 @@ class DhrystoneBenchmark(Benchmark):
 
     def run_single(self) -> float:
         proc = subprocess.Popen(
-            [EMU_PATH, "-q", self.BIN_PATH],
+            [self.emu, "-q", self.BIN_PATH],
             stdout=subprocess.PIPE,
             stderr=subprocess.PIPE,
             text=True,
@@ -323,7 +327,7 @@ class CoreMarkBenchmark(Benchmark):
 
     def run_single(self) -> float:
         cmd = [
-            EMU_PATH,
+            self.emu,
             "-q",
             self.BIN_PATH,
             "0x0",
@@ -364,14 +368,65 @@ class CoreMarkBenchmark(Benchmark):
         return float(match.group(1))
 
 
+@register_benchmark("rv8-bench")
+class RV8Benchmark(Benchmark):
+    """rv8-bench suite measuring complete suite runs per minute."""
+
+    name = "rv8-bench"
+    unit = "runs/min"
+    BIN_DIR = "build/riscv32"
+    PROGRAMS = ["aes", "miniz", "norx", "primes", "qsort", "sha512"]
+    BIN_PATH = os.path.join(BIN_DIR, PROGRAMS[0])
+
+    @classmethod
+    def prepare(cls) -> None:
+        super().prepare()
+        for prog in cls.PROGRAMS:
+            path = os.path.join(cls.BIN_DIR, prog)
+            if not os.path.exists(path):
+                raise RuntimeError(f"{cls.name}: {prog} not found at {path}")
+
+    def run_single(self) -> float:
+        elapsed = 0.0
+        for prog in self.PROGRAMS:
+            start = time.monotonic()
+            proc = subprocess.Popen(
+                [self.emu, "-q", os.path.join(self.BIN_DIR, prog)],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                text=True,
+            )
+            try:
+                stdout, stderr = proc.communicate(timeout=TIMEOUT_SECONDS)
+            except TimeoutExpired:
+                proc.kill()
+                proc.communicate()  # Clean up buffers
+                raise RuntimeError(
+                    f"rv8-bench {prog} timed out after {TIMEOUT_SECONDS} seconds"
+                )
+            elapsed += time.monotonic() - start
+
+            if proc.returncode != 0:
+                raise RuntimeError(
+                    f"rv8-bench {prog} failed (exit {proc.returncode})\n"
+                    f"stdout: {stdout[:500]}\nstderr: {stderr[:500]}"
+                )
+
+        # Report a rate so that bigger is better, like the other benchmarks
+        return 60.0 / elapsed
+
+
 def run_benchmark_task(
-    bench_name: str, n_runs: int, progress: Optional[ProgressIndicator] = None
+    bench_name: str,
+    n_runs: int,
+    progress: Optional[ProgressIndicator] = None,
+    emu: str = EMU_PATH,
 ) -> Tuple[str, dict, List[str], Optional[Exception]]:
     """Run a single benchmark. Returns (name, result, logs, error)."""
     bench = None
     try:
         bench_cls = _BENCHMARK_REGISTRY[bench_name]
-        bench = bench_cls(n_runs, progress)
+        bench = bench_cls(n_runs, progress, emu)
         avg, stdev, _, actual_runs = bench.run()
         result = {
             "name": bench.name,
@@ -389,44 +444,14 @@ def run_benchmark_task(
         return bench_name, {}, logs, e
 
 
-def run_benchmarks(
+def run_suite(
     selected: List[str],
-    output_json: bool,
     n_runs: int,
-    parallel: int = 0,
-    quiet: bool = False,
-) -> None:
-    """Run selected benchmarks, optionally in parallel."""
-    if not os.path.exists(EMU_PATH):
-        print(
-            f"Error: {EMU_PATH} not found. Please compile first",
-            file=sys.stderr,
-        )
-        sys.exit(1)
-
-    # Validate selections
-    registry = get_registered_benchmarks()
-    for name in selected:
-        if name not in registry:
-            print(f"Error: Unknown benchmark '{name}'", file=sys.stderr)
-            print(
-                f"Available: {', '.join(sorted(registry.keys()))}",
-                file=sys.stderr,
-            )
-            sys.exit(1)
-
-    # Prepare phase: build all binaries sequentially before running benchmarks
-    if not quiet:
-        print("Preparing benchmarks...")
-    try:
-        for name in selected:
-            registry[name].prepare()
-    except RuntimeError as e:
-        print(f"Error: {e}", file=sys.stderr)
-        sys.exit(1)
-    if not quiet:
-        print("Preparation complete.\n")
-
+    parallel: int,
+    quiet: bool,
+    emu: str,
+) -> Dict[str, dict]:
+    """Run selected benchmarks against one emulator. Exits on failure."""
     # Create and start progress indicator
     progress = ProgressIndicator(selected, n_runs, quiet=quiet)
     progress.start()
@@ -435,8 +460,6 @@ def run_benchmarks(
     all_logs: Dict[str, List[str]] = {}
     errors: Dict[str, Exception] = {}
 
-    start_time = time.monotonic()
-
     if parallel and parallel > 0 and len(selected) > 1:
         workers = min(parallel, len(selected))
         if not quiet:
@@ -446,7 +469,7 @@ def run_benchmarks(
         with ThreadPoolExecutor(max_workers=workers) as executor:
             futures = {
                 executor.submit(
-                    run_benchmark_task, name, n_runs, progress
+                    run_benchmark_task, name, n_runs, progress, emu
                 ): name
                 for name in selected
             }
@@ -470,7 +493,7 @@ def run_benchmarks(
     else:
         for name in selected:
             name, result, logs, error = run_benchmark_task(
-                name, n_runs, progress
+                name, n_runs, progress, emu
             )
             all_logs[name] = logs
             if error:
@@ -488,15 +511,119 @@ def run_benchmarks(
                     for line in all_logs[name]:
                         print(f"  {line}")
 
-    elapsed = time.monotonic() - start_time
-
     # Report errors
     for name, error in errors.items():
-        print(f"\nError in {name}: {error}", file=sys.stderr)
+        print(f"\nError in {name} ({emu}): {error}", file=sys.stderr)
 
     if errors:
         sys.exit(1)
 
+    return results
+
+
+def report_comparison(
+    selected: List[str],
+    emulators: List[str],
+    results: Dict[str, Dict[str, dict]],
+    output_json: bool,
+) -> None:
+    """Print each benchmark across emulators, relative to the first one."""
+    base = emulators[0]
+    print("\n" + "=" * 50)
+    print("Benchmark comparison (relative to the first emulator)")
+    print("=" * 50)
+    compared = []
+    for name in selected:
+        ref = results[base][name]
+        print(f"  {ref['name']} ({ref['unit']}):")
+        for emu in emulators:
+            r = results[emu][name]
+            ratio = r["value"] / ref["value"] if ref["value"] else 0.0
+            print(
+                f"    {emu}: {r['value']} ± {r['stdev']} "
+                f"({r['runs']} runs, {ratio:.3f}x)"
+            )
+            compared.append(
+                {
+                    "name": r["name"],
+                    "emulator": emu,
+                    "unit": r["unit"],
+                    "value": r["value"],
+                    "ratio": round(ratio, 3),
+                }
+            )
+    print("=" * 50)
+
+    if output_json:
+        combined_file = "benchmark_compare.json"
+        with open(combined_file, "w") as f:
+            json.dump(compared, f, indent=4)
+        print(f"Saved: {combined_file}")
+
+
+def run_benchmarks(
+    selected: List[str],
+    output_json: bool,
+    n_runs: int,
+    parallel: int = 0,
+    quiet: bool = False,
+    emulators: Optional[List[str]] = None,
+) -> None:
+    """Run selected benchmarks, optionally in parallel.
+
+    With several emulators, e.g. builds using different interpreter dispatch
+    engines, every benchmark runs against each of them in turn and the
+    results are reported side by side.
+    """
+    emulators = emulators or [EMU_PATH]
+    for emu in emulators:
+        if not os.path.exists(emu):
+            print(
+                f"Error: {emu} not found. Please compile first",
+                file=sys.stderr,
+            )
+            sys.exit(1)
+
+    # Validate selections
+    registry = get_registered_benchmarks()
+    for name in selected:
+        if name not in registry:
+            print(f"Error: Unknown benchmark '{name}'", file=sys.stderr)
+            print(
+                f"Available: {', '.join(sorted(registry.keys()))}",
+                file=sys.stderr,
+            )
+            sys.exit(1)
+
+    # Prepare phase: build all binaries sequentially before running benchmarks
+    if not quiet:
+        print("Preparing benchmarks...")
+    try:
+        for name in selected:
+            registry[name].prepare()
+    except RuntimeError as e:
+        print(f"Error: {e}", file=sys.stderr)
+        sys.exit(1)
+    if not quiet:
+        print("Preparation complete.\n")
+
+    start_time = time.monotonic()
+
+    # Emulators run one after another so they do not compete for the host
+    all_results: Dict[str, Dict[str, dict]] = {}
+    for emu in emulators:
+        if not quiet and len(emulators) > 1:
+            print(f">>> Emulator: {emu} <<<")
+        all_results[emu] = run_suite(selected, n_runs, parallel, quiet, emu)
+
+    elapsed = time.monotonic() - start_time
+
+    if len(emulators) > 1:
+        report_comparison(selected, emulators, all_results, output_json)
+        print(f"  Total time: {elapsed:.1f}s")
+        return
+    results = all_results[emulators[0]]
+
     # Output results in user-specified order
     print("\n" + "=" * 50)
     print("Benchmark results")
@@ -570,6 +697,13 @@ def main():
         default=DEFAULT_RUNS,
         help=f"Number of runs per benchmark (default: {DEFAULT_RUNS})",
     )
+    parser.add_argument(
+        "--compare",
+        nargs="+",
+        metavar="EMU",
+        help="Run every benchmark against each emulator binary and compare "
+        f"(default: {EMU_PATH} only)",
+    )
     parser.add_argument(
         "benchmarks",
         nargs="*",
@@ -594,6 +728,7 @@ def main():
         args.runs,
         parallel=args.parallel or 0,
         quiet=args.quiet,
+        emulators=args.compare,
     )
 
 
@@ -0,0 +1,86 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "io.h"
+#include "log.h"
+
+#define RAM_SIZE (8UL << 20)
+#define IMAGE_OFFSET 0x10000
+
+/* chunks the guest touches before the snapshot is taken */
+static const uint32_t touched[] = {0, MEM_CHUNK_SIZE + 12, 3UL << 20,
+                                   RAM_SIZE - 4};
+
+static uint32_t pattern(uint32_t addr)
+{
+    return addr * 2654435761U;
+}
+
+static void check(bool cond, const char *backing, const char *what)
+{
+    if (cond)
+        return;
+    printf("\n\n%s backing: %s\n", backing, what);
+    exit(1);
+}
+
+static void round_trip(memory_backing_t backing, const char *name)
+{
+    memory_t *mem = memory_new_backed(RAM_SIZE, backing);
+    if (!mem && backing != MEM_BACKING_DEMAND)
+        return; /* no huge pages or prefaulting on this host */
+    check(mem, name, "cannot create guest RAM");
+
+    for (size_t i = 0; i < sizeof(touched) / sizeof(touched[0]); i++) {
+        uint32_t val = pattern(touched[i]);
+        memcpy(mem->mem_base + touched[i], &val, sizeof(val));
+    }
+
+    char path[] = "/tmp/test-memory-XXXXXX";
+    int fd = mkstemp(path);
+    check(fd >= 0, name, "cannot create the image file");
+    unlink(path);
+    check(memory_save(mem, fd, IMAGE_OFFSET), name, "memory_save failed");
+
+    /* diverge from the saved image, including in chunks it does not hold */
+    memset(mem->mem_base, 0xa5, 2 * MEM_CHUNK_SIZE);
+    memset(mem->mem_base + (5UL << 20), 0x5a, 4096);
+    for (size_t i = 0; i < sizeof(touched) / sizeof(touched[0]); i++)
+        memset(mem->mem_base + touched[i], 0xff, 4);
+
+    check(!memory_restore(mem, fd, IMAGE_OFFSET + 1), name,
+          "misaligned image offset accepted");
+    check(memory_restore(mem, fd, IMAGE_OFFSET), name,
+          "memory_restore failed");
+    close(fd);
+
+    for (size_t i = 0; i < sizeof(touched) / sizeof(touched[0]); i++) {
+        uint32_t val;
+        memcpy(&val, mem->mem_base + touched[i], sizeof(val));
+        check(val == pattern(touched[i]), name, "saved word not restored");
+    }
+    check(mem->mem_base[MEM_CHUNK_SIZE + 100] == 0, name,
+          "scribbled byte survived in a saved chunk");
+    check(mem->mem_base[(5UL << 20) + 100] == 0, name,
+          "scribbled byte survived in an unsaved chunk");
+
+    /* restored RAM stays writable */
+    mem->mem_base[(6UL << 20) + 1] = 0x42;
+    check(mem->mem_base[(6UL << 20) + 1] == 0x42, name, "write lost");
+
+    memory_delete(mem);
+}
+
+int main(void)
+{
+    /* hosts without reserved huge pages fail the hugetlb case, expectedly */
+    rv_log_set_quiet(true);
+    round_trip(MEM_BACKING_DEMAND, "demand");
+    round_trip(MEM_BACKING_PREFAULT, "prefault");
+    round_trip(MEM_BACKING_HUGETLB, "hugetlb");
+    return 0;
+}
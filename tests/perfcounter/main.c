@@ -4,6 +4,8 @@
 
 extern uint64_t get_cycles();
 extern uint64_t get_instret();
+extern void set_hpmevent3(unsigned int event);
+extern uint64_t get_hpmcounter3();
 
 /*
  * Taken from the Sparkle-suite which is a collection of lightweight symmetric
@@ -16,6 +18,9 @@ extern void sparkle_asm(unsigned int *state, unsigned int ns);
 #define WORDS 12
 #define ROUNDS 7
 
+/* mhpmevent code of the emulator that counts loads */
+#define EVENT_LOAD 5
+
 int main(void)
 {
     unsigned int state[WORDS] = {0};
@@ -29,6 +34,16 @@ int main(void)
     printf("cycle count: %u\n", (unsigned int) cyclecount);
     printf("instret: %x\n", (unsigned) (instret & 0xffffffff));
 
+    /* count the loads of one permutation on hpmcounter3 */
+    memset(state, 0, WORDS * sizeof(uint32_t));
+    set_hpmevent3(EVENT_LOAD);
+    uint64_t oldloads = get_hpmcounter3();
+    sparkle_asm(state, ROUNDS);
+    uint64_t loadcount = get_hpmcounter3() - oldloads;
+    set_hpmevent3(0);
+
+    printf("load count: %u\n", (unsigned int) loadcount);
+
     memset(state, 0, WORDS * sizeof(uint32_t));
 
     sparkle_asm(state, ROUNDS);
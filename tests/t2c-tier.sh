@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+
+# The default T2C optimization level compiles traces twice, first with the
+# quick pipeline and then with the full one. Check that this tiering does not
+# run slower than compiling every trace once with -O 1.
+
+source tests/common.sh
+
+ELF=$O/fibonacci.elf
+RUNS=3
+# tolerated slowdown in percent, for timing noise
+SLACK=10
+
+if ! $RUN -h 2>&1 | grep -q -- "-O <"; then
+    echo "T2C is not enabled, skipped."
+    exit 0
+fi
+
+# Set BEST to the shortest of $RUNS wall-clock times, with the given options
+function best_time()
+{
+    local TIMEFORMAT=%R i t
+    BEST=
+    for ((i = 0; i < RUNS; i++)); do
+        t=$({ time $RUN "$@" $ELF > /dev/null 2>&1; } 2>&1) || fail
+        if [ -z "$BEST" ] ||
+            awk -v a=$t -v b=$BEST 'BEGIN { exit !(a < b) }'; then
+            BEST=$t
+        fi
+    done
+}
+
+best_time -O 1
+quick=$BEST
+best_time
+tiered=$BEST
+echo "-O 1: ${quick}s, default: ${tiered}s"
+if awk -v a=$tiered -v b=$quick -v s=$SLACK \
+    'BEGIN { exit !(a > b * (100 + s) / 100) }'; then
+    fail
+fi
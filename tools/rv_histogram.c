@@ -21,6 +21,7 @@ typedef void (*hist_record_handler)(const rv_insn_t *);
 
 static bool ascending_order = false;
 static bool show_reg = false;
+static bool show_pair = false;
 static const char *elf_prog = NULL;
 
 static size_t max_freq = 0;
@@ -29,7 +30,7 @@ static unsigned short max_col;
 static unsigned short used_col;
 
 typedef struct {
-    char insn_reg[16]; /* insn or reg   */
+    char insn_reg[24]; /* insn, reg or insn pair */
     size_t freq;       /* frequency     */
     uint8_t reg_mask;  /* 0x1=rs1, 0x2=rs2, 0x4=rs3, 0x8=rd */
 } rv_hist_t;
@@ -49,6 +50,19 @@ static rv_hist_t rv_reg_stats[] = {
 #undef _
 };
 
+/* Adjacent instruction pairs within a basic block, the raw material for new
+ * macro-op fusion patterns. A pair never spans a branch, since fusion does
+ * not cross block boundaries.
+ */
+static const bool rv_insn_can_branch[] = {
+#define _(inst, can_branch, insn_len, translatable, reg_mask) can_branch,
+    RV_INSN_LIST
+#undef _
+};
+
+static size_t rv_pair_freq[N_RV_INSNS][N_RV_INSNS];
+static int prev_opcode = -1;
+
 static int cmp_dec(const void *a, const void *b)
 {
     const size_t a_freq = ((rv_hist_t *) a)->freq;
@@ -181,7 +195,9 @@ static void print_usage(const char *filename)
             "Usage: %s [option] [elf_file_path]\n"
             "available options: -a, print the histogram in "
             "ascending order(default is on descending order)\n"
-            "                 : -r, analysis on registers\n",
+            "                 : -r, analysis on registers\n"
+            "                 : -p, analysis on adjacent instruction pairs "
+            "(fusion candidates)\n",
             filename);
 }
 
@@ -208,6 +224,11 @@ static bool parse_args(int argc, const char *args[])
                 continue;
             }
 
+            if (!strcmp(arg, "-p")) {
+                show_pair = true;
+                continue;
+            }
+
             ret = false;
         }
         /* set the executable */
@@ -273,6 +294,42 @@ static void insn_hist_incr(const rv_insn_t *ir)
     total_freq++;
 }
 
+static void pair_hist_incr(const rv_insn_t *ir)
+{
+    if (ir && prev_opcode >= 0) {
+        rv_pair_freq[prev_opcode][ir->opcode]++;
+        total_freq++;
+    }
+    prev_opcode = (ir && !rv_insn_can_branch[ir->opcode]) ? ir->opcode : -1;
+}
+
+/* collect the recorded pairs into histogram entries, returns the count */
+static size_t pair_hist_collect(rv_hist_t **stats)
+{
+    size_t n = 0;
+    for (int i = 0; i < N_RV_INSNS; i++) {
+        for (int j = 0; j < N_RV_INSNS; j++)
+            n += rv_pair_freq[i][j] != 0;
+    }
+
+    *stats = calloc(n ? n : 1, sizeof(rv_hist_t));
+    if (!*stats)
+        return 0;
+
+    n = 0;
+    for (int i = 0; i < N_RV_INSNS; i++) {
+        for (int j = 0; j < N_RV_INSNS; j++) {
+            if (!rv_pair_freq[i][j])
+                continue;
+            rv_hist_t *h = &(*stats)[n++];
+            snprintf(h->insn_reg, sizeof(h->insn_reg), "%.11s+%.11s",
+                     rv_insn_stats[i].insn_reg, rv_insn_stats[j].insn_reg);
+            h->freq = rv_pair_freq[i][j];
+        }
+    }
+    return n;
+}
+
 int main(int argc, const char *args[])
 {
     if (!parse_args(argc, args) || !elf_prog) {
@@ -281,7 +338,9 @@ int main(int argc, const char *args[])
     }
 
     /* resolver of histogram accounting */
-    hist_record_handler hist_record = show_reg ? reg_hist_incr : insn_hist_incr;
+    hist_record_handler hist_record = show_reg    ? reg_hist_incr
+                                      : show_pair ? pair_hist_incr
+                                                  : insn_hist_incr;
 
     elf_t *e = elf_new();
     if (!elf_open(e, elf_prog)) {
@@ -315,6 +374,7 @@ int main(int argc, const char *args[])
         const uint8_t *exec_end_addr = &exec_start_addr[shdr->sh_size];
         uint8_t *ptr = exec_start_addr;
         uint32_t insn;
+        prev_opcode = -1;
 
         while (ptr < exec_end_addr) {
 #if RV32_HAS(EXT_C)
@@ -354,6 +414,18 @@ int main(int argc, const char *args[])
         printf("+--------------------------------------+\n");
         find_max_freq(rv_reg_stats, N_RV_REGS);
         print_hist_stats(rv_reg_stats, N_RV_REGS);
+    } else if (show_pair) {
+        rv_hist_t *pair_stats;
+        size_t n_pairs = pair_hist_collect(&pair_stats);
+        qsort(pair_stats, n_pairs, sizeof(rv_hist_t),
+              ascending_order ? cmp_asc : cmp_dec);
+
+        printf("+----------------------------------------+\n");
+        printf("| RV32 Target Instruction Pair Histogram |\n");
+        printf("+----------------------------------------+\n");
+        find_max_freq(pair_stats, n_pairs);
+        print_hist_stats(pair_stats, n_pairs);
+        free(pair_stats);
     } else {
         qsort(rv_insn_stats, ARRAY_SIZE(rv_insn_stats), sizeof(rv_hist_t),
               ascending_order ? cmp_asc : cmp_dec);